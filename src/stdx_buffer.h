@@ -0,0 +1,210 @@
+/*
+ * STDX - Shared Buffers
+ * Part of the STDX General Purpose C Library by marciovmf
+ * https://github.com/marciovmf/stdx
+ *
+ * Reference-counted byte buffers for handing the same payload from one stage
+ * to the next without copying it:
+ *   - Atomic retain/release, so a buffer can cross thread pool tasks
+ *   - Slices: O(1) views into a range that share the backing store
+ *   - Optional custom XAllocator for the storage
+ *   - Copy-on-write via x_buffer_make_writable
+ *
+ * Example:
+ *     XBuffer* buf = x_buffer_create(4096, NULL);
+ *     size_t n = x_net_recv(sock, x_buffer_data(buf), x_buffer_size(buf));
+ *     XBuffer* body = x_buffer_slice(buf, header_size, n - header_size);
+ *     x_buffer_release(buf);
+ *     threadpool_enqueue(pool, parse_task, body);  // parse_task releases it
+ *
+ * Buffer contents are not synchronized: share a buffer read-only, or call
+ * x_buffer_make_writable before modifying it.
+ *
+ * To compile the implementation, define:
+ *     #define STDX_IMPLEMENTATION_BUFFER
+ * in **one** source file before including this header.
+ *
+ * Author: marciovmf
+ * License: MIT
+ * Dependencies: stdx_allocator.h, stdx_thread.h (atomics only)
+ * Usage: #include "stdx_buffer.h"
+ */
+
+#ifndef STDX_BUFFER_H
+#define STDX_BUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STDX_BUFFER_VERSION_MAJOR 1
+#define STDX_BUFFER_VERSION_MINOR 0
+#define STDX_BUFFER_VERSION_PATCH 0
+
+#define STDX_BUFFER_VERSION (STDX_BUFFER_VERSION_MAJOR * 10000 + STDX_BUFFER_VERSION_MINOR * 100 + STDX_BUFFER_VERSION_PATCH)
+
+#ifdef STDX_IMPLEMENTATION_BUFFER
+#ifndef STDX_IMPLEMENTATION_ALLOCATOR
+#define STDX_INTERNAL_ALLOCATOR_IMPLEMENTATION
+#define STDX_IMPLEMENTATION_ALLOCATOR
+#endif
+#endif
+#include <stdx_allocator.h>
+#include <stdx_thread.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+  typedef struct XBuffer_t XBuffer;
+
+  /// Allocate a buffer of `size` uninitialized bytes with a reference count
+  /// of 1. `allocator` may be NULL for malloc/free and must outlive the
+  /// buffer and every slice of it.
+  XBuffer* x_buffer_create(size_t size, XAllocator* allocator);
+
+  /// Same as x_buffer_create, initialized with a copy of `data`.
+  XBuffer* x_buffer_from(const void* data, size_t size, XAllocator* allocator);
+
+  /// Add a reference. Returns `buffer` for convenience.
+  XBuffer* x_buffer_retain(XBuffer* buffer);
+
+  /// Drop a reference. The storage is freed with the last buffer or slice
+  /// that uses it.
+  void     x_buffer_release(XBuffer* buffer);
+
+  uint8_t* x_buffer_data(XBuffer* buffer);
+  size_t   x_buffer_size(const XBuffer* buffer);
+
+  /// A new reference to `size` bytes at `offset` of `buffer`, sharing its
+  /// storage. Returns NULL if the range is out of bounds.
+  XBuffer* x_buffer_slice(XBuffer* buffer, size_t offset, size_t size);
+
+  /// True when nobody else can observe writes to this buffer's bytes.
+  bool     x_buffer_is_unique(const XBuffer* buffer);
+
+  /// Copy-on-write: returns `buffer` itself if it is unique, otherwise a
+  /// private copy of its bytes, releasing the caller's reference to
+  /// `buffer`. Returns NULL on allocation failure, in which case `buffer` is
+  /// untouched.
+  ///     buf = x_buffer_make_writable(buf);
+  XBuffer* x_buffer_make_writable(XBuffer* buffer);
+
+#ifdef STDX_IMPLEMENTATION_BUFFER
+
+#include <string.h>
+
+  struct XBuffer_t
+  {
+    volatile int32_t refcount;
+    XAllocator* allocator;
+    XBuffer* store;       // Buffer owning the bytes; NULL if this one does
+    uint8_t* data;
+    size_t size;
+    // Owned bytes follow the header
+  };
+
+  static XBuffer* x_buffer_alloc(size_t extra, XAllocator* allocator)
+  {
+    if (extra > SIZE_MAX - sizeof(XBuffer))
+      return NULL;
+    XBuffer* buffer = (XBuffer*) stdx_alloc(allocator, sizeof(XBuffer) + extra);
+    if (!buffer)
+      return NULL;
+    buffer->refcount = 1;
+    buffer->allocator = allocator;
+    buffer->store = NULL;
+    buffer->data = (uint8_t*)(buffer + 1);
+    buffer->size = extra;
+    return buffer;
+  }
+
+  XBuffer* x_buffer_create(size_t size, XAllocator* allocator)
+  {
+    return x_buffer_alloc(size, allocator);
+  }
+
+  XBuffer* x_buffer_from(const void* data, size_t size, XAllocator* allocator)
+  {
+    XBuffer* buffer = x_buffer_alloc(size, allocator);
+    if (buffer && size)
+      memcpy(buffer->data, data, size);
+    return buffer;
+  }
+
+  XBuffer* x_buffer_retain(XBuffer* buffer)
+  {
+    if (buffer)
+      x_atomic_add_i32(&buffer->refcount, 1);
+    return buffer;
+  }
+
+  void x_buffer_release(XBuffer* buffer)
+  {
+    while (buffer && x_atomic_add_i32(&buffer->refcount, -1) == 1)
+    {
+      XBuffer* store = buffer->store;
+      stdx_free(buffer->allocator, buffer);
+      buffer = store;
+    }
+  }
+
+  uint8_t* x_buffer_data(XBuffer* buffer)
+  {
+    return buffer->data;
+  }
+
+  size_t x_buffer_size(const XBuffer* buffer)
+  {
+    return buffer->size;
+  }
+
+  XBuffer* x_buffer_slice(XBuffer* buffer, size_t offset, size_t size)
+  {
+    if (offset > buffer->size || size > buffer->size - offset)
+      return NULL;
+
+    // Slices of slices point straight at the owner so chains stay one deep
+    XBuffer* store = buffer->store ? buffer->store : buffer;
+    XBuffer* slice = x_buffer_alloc(0, store->allocator);
+    if (!slice)
+      return NULL;
+    slice->store = x_buffer_retain(store);
+    slice->data = buffer->data + offset;
+    slice->size = size;
+    return slice;
+  }
+
+  bool x_buffer_is_unique(const XBuffer* buffer)
+  {
+    XBuffer* self = (XBuffer*) buffer;
+    if (x_atomic_load_i32(&self->refcount) != 1)
+      return false;
+    return !self->store || x_atomic_load_i32(&self->store->refcount) == 1;
+  }
+
+  XBuffer* x_buffer_make_writable(XBuffer* buffer)
+  {
+    if (x_buffer_is_unique(buffer))
+      return buffer;
+
+    XAllocator* allocator = buffer->store ? buffer->store->allocator : buffer->allocator;
+    XBuffer* copy = x_buffer_from(buffer->data, buffer->size, allocator);
+    if (!copy)
+      return NULL;
+    x_buffer_release(buffer);
+    return copy;
+  }
+
+#endif // STDX_IMPLEMENTATION_BUFFER
+
+#ifdef STDX_INTERNAL_ALLOCATOR_IMPLEMENTATION
+#undef STDX_IMPLEMENTATION_ALLOCATOR
+#undef STDX_INTERNAL_ALLOCATOR_IMPLEMENTATION
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STDX_BUFFER_H
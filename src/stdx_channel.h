@@ -0,0 +1,474 @@
+/*
+ * STDX - Channels
+ * Part of the STDX General Purpose C Library by marciovmf
+ * https://github.com/marciovmf/stdx
+ *
+ * Go-style channels for passing fixed-size values between threads:
+ *   - Buffered and unbuffered (rendezvous) channels
+ *   - Blocking and non-blocking send/recv
+ *   - Close semantics: receivers drain buffered values, then see CLOSED
+ *   - x_channel_select over any mix of send and recv cases, with timeout
+ *
+ * Every channel has its own lock. A blocked thread parks on its own waiter
+ * and is handed the value directly by whichever thread completes one of its
+ * cases, so there is no global lock and no broadcast wakeup.
+ *
+ * To compile the implementation, define:
+ *     #define STDX_IMPLEMENTATION_CHANNEL
+ * in **one** source file before including this header.
+ *
+ * Author: marciovmf
+ * License: MIT
+ * Dependencies: stdx_thread.h
+ * Usage: #include "stdx_channel.h"
+ */
+
+#ifndef STDX_CHANNEL_H
+#define STDX_CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STDX_CHANNEL_VERSION_MAJOR 1
+#define STDX_CHANNEL_VERSION_MINOR 0
+#define STDX_CHANNEL_VERSION_PATCH 0
+
+#define STDX_CHANNEL_VERSION (STDX_CHANNEL_VERSION_MAJOR * 10000 + STDX_CHANNEL_VERSION_MINOR * 100 + STDX_CHANNEL_VERSION_PATCH)
+
+#ifdef STDX_IMPLEMENTATION_CHANNEL
+#ifndef STDX_IMPLEMENTATION_THREAD
+#define STDX_INTERNAL_THREAD_IMPLEMENTATION
+#define STDX_IMPLEMENTATION_THREAD
+#endif
+#endif
+#include <stdx_thread.h>
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define X_CHANNEL_SELECT_MAX 64
+
+  typedef struct XChannel_t XChannel;
+
+  typedef enum
+  {
+    X_CHANNEL_OK          =  0,
+    X_CHANNEL_CLOSED      = -1,
+    X_CHANNEL_TIMEOUT     = -2,
+    X_CHANNEL_WOULD_BLOCK = -3,
+    X_CHANNEL_ERROR       = -4,
+  } XChannelResult;
+
+  typedef enum
+  {
+    X_CHANNEL_SEND,
+    X_CHANNEL_RECV,
+  } XChannelOp;
+
+  typedef struct
+  {
+    XChannel*       channel;
+    XChannelOp      op;
+    void*           data;     // Value to send, or where to store the received value
+    XChannelResult  result;   // Set on the case chosen by x_channel_select
+  } XChannelCase;
+
+  /// Create a channel of `element_size` values. A capacity of 0 creates an
+  /// unbuffered channel where every send waits for a matching recv.
+  XChannel* x_channel_create(size_t element_size, size_t capacity);
+
+  /// Destroy a channel. No thread may be using it.
+  void x_channel_destroy(XChannel* ch);
+
+  /// Close the channel. Blocked senders and receivers wake with
+  /// X_CHANNEL_CLOSED; receivers still get any buffered values first.
+  void x_channel_close(XChannel* ch);
+
+  /// Blocking send/recv. Return X_CHANNEL_OK or X_CHANNEL_CLOSED.
+  XChannelResult x_channel_send(XChannel* ch, const void* value);
+  XChannelResult x_channel_recv(XChannel* ch, void* out);
+
+  /// Non-blocking send/recv. Return X_CHANNEL_WOULD_BLOCK instead of waiting.
+  XChannelResult x_channel_try_send(XChannel* ch, const void* value);
+  XChannelResult x_channel_try_recv(XChannel* ch, void* out);
+
+  /// Wait until one of the cases can proceed and perform it. Returns the index
+  /// of the completed case (its `result` tells OK or CLOSED), or
+  /// X_CHANNEL_TIMEOUT. A negative timeout waits forever; 0 only polls.
+  int x_channel_select(XChannelCase* cases, int num_cases, int timeout_ms);
+
+#ifdef STDX_IMPLEMENTATION_CHANNEL
+
+#include <stdlib.h>
+#include <string.h>
+
+  typedef struct XChannelWaiter_t
+  {
+    volatile int32_t fired;         // -1 while waiting, then the index of the case that completed
+    XChannelResult result;
+    bool woken;
+    XMutex* lock;
+    XCondVar* cv;
+  } XChannelWaiter;
+
+  // One registration of a waiter on a channel queue
+  typedef struct XChannelSudog_t
+  {
+    XChannelWaiter* waiter;
+    int case_index;
+    void* data;
+    struct XChannelSudog_t* prev;
+    struct XChannelSudog_t* next;
+  } XChannelSudog;
+
+  typedef struct
+  {
+    XChannelSudog* head;
+    XChannelSudog* tail;
+  } XChannelWaitQueue;
+
+  struct XChannel_t
+  {
+    XMutex* lock;
+    unsigned char* buffer;
+    size_t element_size;
+    size_t capacity;
+    size_t count;
+    size_t head;
+    bool closed;
+    XChannelWaitQueue senders;
+    XChannelWaitQueue receivers;
+  };
+
+  static X_THREAD_LOCAL uint32_t x_channel_select_rotation = 0;
+
+  // Parking primitives, created the first time a thread blocks in a select
+  // and reused for every later one, so parking does no heap work
+  static X_THREAD_LOCAL XMutex* x_channel_tls_lock = NULL;
+  static X_THREAD_LOCAL XCondVar* x_channel_tls_cv = NULL;
+
+  static void x_channel_queue_push(XChannelWaitQueue* q, XChannelSudog* s)
+  {
+    s->next = NULL;
+    s->prev = q->tail;
+    if (q->tail) q->tail->next = s;
+    else q->head = s;
+    q->tail = s;
+  }
+
+  static void x_channel_queue_remove(XChannelWaitQueue* q, XChannelSudog* s)
+  {
+    if (s->prev) s->prev->next = s->next;
+    else if (q->head == s) q->head = s->next;
+    else return; // Not linked
+
+    if (s->next) s->next->prev = s->prev;
+    else q->tail = s->prev;
+    s->prev = s->next = NULL;
+  }
+
+  // Pop the first waiter that can still be claimed. Waiters already fired
+  // through another channel are dropped; the current select's own waiter is
+  // skipped so a select never pairs a send with its own recv.
+  static XChannelSudog* x_channel_queue_claim(XChannelWaitQueue* q, XChannelWaiter* self)
+  {
+    XChannelSudog* s = q->head;
+    while (s)
+    {
+      XChannelSudog* next = s->next;
+      if (s->waiter != self)
+      {
+        x_channel_queue_remove(q, s);
+        int32_t expected = -1;
+        if (x_atomic_cas_i32(&s->waiter->fired, &expected, s->case_index))
+          return s;
+      }
+      s = next;
+    }
+    return NULL;
+  }
+
+  static void x_channel_wake(XChannelSudog* s, XChannelResult result)
+  {
+    XChannelWaiter* w = s->waiter;
+    x_thread_mutex_lock(w->lock);
+    w->result = result;
+    w->woken = true;
+    x_thread_condvar_signal(w->cv);
+    x_thread_mutex_unlock(w->lock);
+  }
+
+  static inline void* x_channel_slot(XChannel* ch, size_t index)
+  {
+    return ch->buffer + ((ch->head + index) % ch->capacity) * ch->element_size;
+  }
+
+  // Both helpers expect ch->lock to be held.
+  static XChannelResult x_channel_send_locked(XChannel* ch, const void* value, XChannelWaiter* self)
+  {
+    if (ch->closed)
+      return X_CHANNEL_CLOSED;
+
+    XChannelSudog* receiver = x_channel_queue_claim(&ch->receivers, self);
+    if (receiver)
+    {
+      memcpy(receiver->data, value, ch->element_size);
+      x_channel_wake(receiver, X_CHANNEL_OK);
+      return X_CHANNEL_OK;
+    }
+
+    if (ch->count < ch->capacity)
+    {
+      memcpy(x_channel_slot(ch, ch->count), value, ch->element_size);
+      ch->count++;
+      return X_CHANNEL_OK;
+    }
+    return X_CHANNEL_WOULD_BLOCK;
+  }
+
+  static XChannelResult x_channel_recv_locked(XChannel* ch, void* out, XChannelWaiter* self)
+  {
+    if (ch->count > 0)
+    {
+      memcpy(out, x_channel_slot(ch, 0), ch->element_size);
+      ch->head = (ch->head + 1) % ch->capacity;
+      ch->count--;
+
+      // Move one blocked sender into the slot we just freed
+      XChannelSudog* sender = x_channel_queue_claim(&ch->senders, self);
+      if (sender)
+      {
+        memcpy(x_channel_slot(ch, ch->count), sender->data, ch->element_size);
+        ch->count++;
+        x_channel_wake(sender, X_CHANNEL_OK);
+      }
+      return X_CHANNEL_OK;
+    }
+
+    XChannelSudog* sender = x_channel_queue_claim(&ch->senders, self);
+    if (sender)
+    {
+      memcpy(out, sender->data, ch->element_size);
+      x_channel_wake(sender, X_CHANNEL_OK);
+      return X_CHANNEL_OK;
+    }
+
+    return ch->closed ? X_CHANNEL_CLOSED : X_CHANNEL_WOULD_BLOCK;
+  }
+
+  static XChannelResult x_channel_case_locked(XChannelCase* c, XChannelWaiter* self)
+  {
+    if (c->op == X_CHANNEL_SEND)
+      return x_channel_send_locked(c->channel, c->data, self);
+    return x_channel_recv_locked(c->channel, c->data, self);
+  }
+
+  // Lock every distinct channel in address order so concurrent selects over
+  // overlapping sets cannot deadlock.
+  static int x_channel_lock_all(XChannelCase* cases, int num_cases, XChannel** locked)
+  {
+    int n = 0;
+    for (int i = 0; i < num_cases; ++i)
+    {
+      XChannel* ch = cases[i].channel;
+      int pos = n;
+      bool dup = false;
+      for (int j = 0; j < n; ++j)
+      {
+        if (locked[j] == ch) { dup = true; break; }
+        if ((uintptr_t) locked[j] > (uintptr_t) ch) { pos = j; break; }
+      }
+      if (dup) continue;
+      memmove(&locked[pos + 1], &locked[pos], (n - pos) * sizeof(XChannel*));
+      locked[pos] = ch;
+      n++;
+    }
+
+    for (int i = 0; i < n; ++i)
+      x_thread_mutex_lock(locked[i]->lock);
+    return n;
+  }
+
+  static void x_channel_unlock_all(XChannel** locked, int n)
+  {
+    for (int i = n - 1; i >= 0; --i)
+      x_thread_mutex_unlock(locked[i]->lock);
+  }
+
+  XChannel* x_channel_create(size_t element_size, size_t capacity)
+  {
+    if (element_size == 0)
+      return NULL;
+
+    XChannel* ch = calloc(1, sizeof(XChannel));
+    if (!ch) return NULL;
+
+    ch->element_size = element_size;
+    ch->capacity = capacity;
+    if (capacity > 0)
+    {
+      ch->buffer = malloc(capacity * element_size);
+      if (!ch->buffer)
+      {
+        free(ch);
+        return NULL;
+      }
+    }
+    x_thread_mutex_init(&ch->lock);
+    return ch;
+  }
+
+  void x_channel_destroy(XChannel* ch)
+  {
+    if (!ch) return;
+    x_thread_mutex_destroy(ch->lock);
+    free(ch->buffer);
+    free(ch);
+  }
+
+  void x_channel_close(XChannel* ch)
+  {
+    x_thread_mutex_lock(ch->lock);
+    ch->closed = true;
+
+    XChannelSudog* s;
+    while ((s = x_channel_queue_claim(&ch->receivers, NULL)) != NULL)
+      x_channel_wake(s, X_CHANNEL_CLOSED);
+    while ((s = x_channel_queue_claim(&ch->senders, NULL)) != NULL)
+      x_channel_wake(s, X_CHANNEL_CLOSED);
+
+    x_thread_mutex_unlock(ch->lock);
+  }
+
+  int x_channel_select(XChannelCase* cases, int num_cases, int timeout_ms)
+  {
+    if (!cases || num_cases <= 0 || num_cases > X_CHANNEL_SELECT_MAX)
+      return X_CHANNEL_ERROR;
+
+    XChannel* locked[X_CHANNEL_SELECT_MAX];
+    int num_locked = x_channel_lock_all(cases, num_cases, locked);
+
+    // Poll every case, starting at a rotating offset so no case starves
+    int start = (int)(x_channel_select_rotation++ % (uint32_t) num_cases);
+    for (int k = 0; k < num_cases; ++k)
+    {
+      int i = (start + k) % num_cases;
+      XChannelResult r = x_channel_case_locked(&cases[i], NULL);
+      if (r != X_CHANNEL_WOULD_BLOCK)
+      {
+        x_channel_unlock_all(locked, num_locked);
+        cases[i].result = r;
+        return i;
+      }
+    }
+
+    if (timeout_ms == 0)
+    {
+      x_channel_unlock_all(locked, num_locked);
+      return X_CHANNEL_TIMEOUT;
+    }
+
+    // Nothing is ready: register on every channel and park
+    if (!x_channel_tls_lock)
+    {
+      x_thread_mutex_init(&x_channel_tls_lock);
+      x_thread_condvar_init(&x_channel_tls_cv);
+    }
+    XChannelWaiter waiter;
+    waiter.fired = -1;
+    waiter.result = X_CHANNEL_OK;
+    waiter.woken = false;
+    waiter.lock = x_channel_tls_lock;
+    waiter.cv = x_channel_tls_cv;
+
+    XChannelSudog sudogs[X_CHANNEL_SELECT_MAX];
+    for (int i = 0; i < num_cases; ++i)
+    {
+      sudogs[i].waiter = &waiter;
+      sudogs[i].case_index = i;
+      sudogs[i].data = cases[i].data;
+      x_channel_queue_push(cases[i].op == X_CHANNEL_SEND ? &cases[i].channel->senders : &cases[i].channel->receivers, &sudogs[i]);
+    }
+    x_channel_unlock_all(locked, num_locked);
+
+    uint64_t deadline = timeout_ms > 0 ? x_thread_time_ns() + (uint64_t) timeout_ms * 1000000ull : 0;
+    x_thread_mutex_lock(waiter.lock);
+    while (!waiter.woken)
+    {
+      if (timeout_ms < 0)
+      {
+        x_thread_condvar_wait(waiter.cv, waiter.lock);
+        continue;
+      }
+
+      uint64_t now = x_thread_time_ns();
+      if (now >= deadline)
+      {
+        // Claim ourselves so no late sender/receiver can complete a case.
+        // If that fails a case already completed and its wake is on the way.
+        int32_t expected = -1;
+        if (x_atomic_cas_i32(&waiter.fired, &expected, num_cases))
+          break;
+        x_thread_condvar_wait(waiter.cv, waiter.lock);
+        continue;
+      }
+      x_thread_condvar_wait_timeout(waiter.cv, waiter.lock, (int)((deadline - now + 999999) / 1000000));
+    }
+    x_thread_mutex_unlock(waiter.lock);
+
+    // Unregister from every channel the completed case did not dequeue us from
+    x_channel_lock_all(cases, num_cases, locked);
+    for (int i = 0; i < num_cases; ++i)
+      x_channel_queue_remove(cases[i].op == X_CHANNEL_SEND ? &cases[i].channel->senders : &cases[i].channel->receivers, &sudogs[i]);
+    x_channel_unlock_all(locked, num_locked);
+
+    int fired = x_atomic_load_i32(&waiter.fired);
+    if (fired >= num_cases)
+      return X_CHANNEL_TIMEOUT;
+    cases[fired].result = waiter.result;
+    return fired;
+  }
+
+  XChannelResult x_channel_send(XChannel* ch, const void* value)
+  {
+    XChannelCase c = { ch, X_CHANNEL_SEND, (void*) value, X_CHANNEL_OK };
+    x_channel_select(&c, 1, -1);
+    return c.result;
+  }
+
+  XChannelResult x_channel_recv(XChannel* ch, void* out)
+  {
+    XChannelCase c = { ch, X_CHANNEL_RECV, out, X_CHANNEL_OK };
+    x_channel_select(&c, 1, -1);
+    return c.result;
+  }
+
+  XChannelResult x_channel_try_send(XChannel* ch, const void* value)
+  {
+    x_thread_mutex_lock(ch->lock);
+    XChannelResult r = x_channel_send_locked(ch, value, NULL);
+    x_thread_mutex_unlock(ch->lock);
+    return r;
+  }
+
+  XChannelResult x_channel_try_recv(XChannel* ch, void* out)
+  {
+    x_thread_mutex_lock(ch->lock);
+    XChannelResult r = x_channel_recv_locked(ch, out, NULL);
+    x_thread_mutex_unlock(ch->lock);
+    return r;
+  }
+
+#endif // STDX_IMPLEMENTATION_CHANNEL
+
+#ifdef STDX_INTERNAL_THREAD_IMPLEMENTATION
+#undef STDX_IMPLEMENTATION_THREAD
+#undef STDX_INTERNAL_THREAD_IMPLEMENTATION
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STDX_CHANNEL_H
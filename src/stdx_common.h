@@ -78,7 +78,7 @@ extern "C" {
 // ----------------------------------------------------------------------------
 // Branch prediction
 // ----------------------------------------------------------------------------
-#if defined(PLAT_COMPILER_GCC) || defined(PLAT_COMPILER_CLANG)
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
   #define PLAT_LIKELY(x)   __builtin_expect(!!(x), 1)
   #define PLAT_UNLIKELY(x) __builtin_expect(!!(x), 0)
 #else
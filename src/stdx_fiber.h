@@ -0,0 +1,606 @@
+/*
+ * STDX - Fibers
+ * Part of the STDX General Purpose C Library by marciovmf
+ * https://github.com/marciovmf/stdx
+ *
+ * Stackful fibers scheduled cooperatively on XThreadPool workers:
+ *   - Spawn a fiber to run fn(arg) on its own stack
+ *   - Yield to let other tasks run, suspend until resumed from any thread
+ *   - Pooled stacks with a guard page below each one
+ *
+ * Context switching uses hand-written assembly on x86-64 and AArch64
+ * (GCC/Clang), native Win32 fibers on Windows and ucontext everywhere else.
+ * Define STDX_FIBER_USE_UCONTEXT to force the ucontext backend.
+ *
+ * A suspended fiber may resume on a different worker thread, so fiber code
+ * must not keep pointers to thread-local storage across a yield or suspend.
+ *
+ * To compile the implementation, define:
+ *     #define STDX_IMPLEMENTATION_FIBER
+ * in **one** source file before including this header.
+ *
+ * Author: marciovmf
+ * License: MIT
+ * Dependencies: stdx_thread.h
+ * Usage: #include "stdx_fiber.h"
+ */
+
+#ifndef STDX_FIBER_H
+#define STDX_FIBER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STDX_FIBER_VERSION_MAJOR 1
+#define STDX_FIBER_VERSION_MINOR 0
+#define STDX_FIBER_VERSION_PATCH 0
+
+#define STDX_FIBER_VERSION (STDX_FIBER_VERSION_MAJOR * 10000 + STDX_FIBER_VERSION_MINOR * 100 + STDX_FIBER_VERSION_PATCH)
+
+#ifdef STDX_IMPLEMENTATION_FIBER
+#ifndef STDX_IMPLEMENTATION_THREAD
+#define STDX_INTERNAL_THREAD_IMPLEMENTATION
+#define STDX_IMPLEMENTATION_THREAD
+#endif
+#endif
+#include <stdx_thread.h>
+
+#include <stddef.h>
+
+#ifndef STDX_FIBER_DEFAULT_STACK_SIZE
+#define STDX_FIBER_DEFAULT_STACK_SIZE (64 * 1024)
+#endif
+
+#ifndef STDX_FIBER_CACHE_SIZE
+#define STDX_FIBER_CACHE_SIZE 256
+#endif
+
+  typedef struct XFiber_t XFiber;
+  typedef struct XFiberScheduler_t XFiberScheduler;
+  typedef void (*XFiberFn)(void* arg);
+
+  /// Create a scheduler that runs fibers on `pool`. A stack_size of 0 uses
+  /// STDX_FIBER_DEFAULT_STACK_SIZE. Up to STDX_FIBER_CACHE_SIZE finished
+  /// fibers keep their stacks for reuse.
+  XFiberScheduler* x_fiber_scheduler_create(XThreadPool* pool, size_t stack_size);
+
+  /// Wait for all fibers to finish, then free the scheduler.
+  void x_fiber_scheduler_destroy(XFiberScheduler* sched);
+
+  /// Block the calling thread until every spawned fiber has finished.
+  void x_fiber_scheduler_wait(XFiberScheduler* sched);
+
+  /// Start a fiber running fn(arg). Returns 0 on success.
+  int x_fiber_spawn(XFiberScheduler* sched, XFiberFn fn, void* arg);
+
+  /// The running fiber, or NULL when called outside a fiber.
+  XFiber* x_fiber_current(void);
+
+  /// Put the running fiber at the back of the pool queue.
+  void x_fiber_yield(void);
+
+  /// Park the running fiber until x_fiber_resume is called for it. A resume
+  /// that arrives before the suspend is not lost.
+  void x_fiber_suspend(void);
+
+  /// Make a suspended fiber runnable again. Callable from any thread.
+  void x_fiber_resume(XFiber* fiber);
+
+#ifdef STDX_IMPLEMENTATION_FIBER
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define X_FIBER_BACKEND_WIN32 1
+#elif !defined(STDX_FIBER_USE_UCONTEXT) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__aarch64__))
+#define X_FIBER_BACKEND_ASM 1
+#else
+#define X_FIBER_BACKEND_UCONTEXT 1
+#endif
+
+#if defined(X_FIBER_BACKEND_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(X_FIBER_BACKEND_UCONTEXT)
+#include <ucontext.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define X_FIBER_NOINLINE __declspec(noinline)
+#else
+#define X_FIBER_NOINLINE __attribute__((noinline))
+#endif
+
+  typedef enum
+  {
+    X_FIBER_ACTION_YIELD,
+    X_FIBER_ACTION_SUSPEND,
+    X_FIBER_ACTION_DONE,
+  } XFiberAction;
+
+  typedef struct
+  {
+#if defined(X_FIBER_BACKEND_WIN32)
+    void* handle;
+#elif defined(X_FIBER_BACKEND_ASM)
+    void* sp;
+#else
+    ucontext_t uc;
+#endif
+  } XFiberContext;
+
+  struct XFiber_t
+  {
+    XFiberContext ctx;
+    XFiberScheduler* sched;
+    XFiberFn fn;
+    void* arg;
+    XFiberAction action;
+    volatile int32_t wake;          // -1 parked, 0 running, >0 resumes not yet consumed
+    void* stack;                    // Mapping base, including the guard page
+    size_t stack_size;
+  };
+
+  struct XFiberScheduler_t
+  {
+    XThreadPool* pool;
+    size_t stack_size;
+    XMpmcQueue* cache;              // Finished fibers kept for reuse
+    volatile int32_t live;
+    XMutex* lock;
+    XCondVar* idle;
+  };
+
+  // Per worker thread: the context of the pool task that is running a fiber
+  typedef struct
+  {
+    XFiberContext ctx;
+    XFiber* current;
+#if defined(X_FIBER_BACKEND_WIN32)
+    bool converted;
+#endif
+  } XFiberThread;
+
+  static X_THREAD_LOCAL XFiberThread x_fiber_tls;
+
+  // Fibers migrate between threads. Always take the address of the current
+  // thread's state through a call the compiler cannot fold across a switch.
+  static X_FIBER_NOINLINE XFiberThread* x_fiber_thread(void)
+  {
+    return &x_fiber_tls;
+  }
+
+  static void x_fiber_main(XFiber* fiber);
+
+  // ---------------------------------------------------------------------------
+  // Context switch
+  // ---------------------------------------------------------------------------
+
+#if defined(X_FIBER_BACKEND_ASM)
+
+#if defined(__APPLE__)
+#define X_FIBER_ASM_SYMBOL(name) "_" #name
+#define X_FIBER_ASM_TYPE(name)
+#else
+#define X_FIBER_ASM_SYMBOL(name) #name
+#define X_FIBER_ASM_TYPE(name) ".type " #name ", @function\n"
+#endif
+
+  // void x_fiber_switch_asm(void** save_sp, void* load_sp)
+  // Pushes the callee-saved registers on the current stack, stores the stack
+  // pointer in *save_sp, switches to load_sp and pops the same frame there.
+  void x_fiber_switch_asm(void** save_sp, void* load_sp);
+
+  // First frame of a new fiber: calls entry(fiber), which never returns
+  void x_fiber_trampoline_asm(void);
+
+#if defined(__x86_64__)
+
+  __asm__(
+      ".text\n"
+      ".globl " X_FIBER_ASM_SYMBOL(x_fiber_switch_asm) "\n"
+      X_FIBER_ASM_TYPE(x_fiber_switch_asm)
+      ".p2align 4\n"
+      X_FIBER_ASM_SYMBOL(x_fiber_switch_asm) ":\n"
+      "  pushq %rbp\n"
+      "  pushq %rbx\n"
+      "  pushq %r12\n"
+      "  pushq %r13\n"
+      "  pushq %r14\n"
+      "  pushq %r15\n"
+      "  subq $8, %rsp\n"
+      "  stmxcsr (%rsp)\n"
+      "  fnstcw 4(%rsp)\n"
+      "  movq %rsp, (%rdi)\n"
+      "  movq %rsi, %rsp\n"
+      "  ldmxcsr (%rsp)\n"
+      "  fldcw 4(%rsp)\n"
+      "  addq $8, %rsp\n"
+      "  popq %r15\n"
+      "  popq %r14\n"
+      "  popq %r13\n"
+      "  popq %r12\n"
+      "  popq %rbx\n"
+      "  popq %rbp\n"
+      "  ret\n"
+      ".globl " X_FIBER_ASM_SYMBOL(x_fiber_trampoline_asm) "\n"
+      X_FIBER_ASM_TYPE(x_fiber_trampoline_asm)
+      ".p2align 4\n"
+      X_FIBER_ASM_SYMBOL(x_fiber_trampoline_asm) ":\n"
+      "  movq %r12, %rdi\n"
+      "  callq *%r13\n"
+      "  ud2\n");
+
+  static void x_fiber_context_init(XFiberContext* ctx, void* stack_top, XFiber* fiber)
+  {
+    // Frame popped by the first switch, from low to high addresses:
+    // mxcsr/x87 control word, r15, r14, r13, r12, rbx, rbp, return address.
+    // The return address sits 8 bytes below a 16-byte boundary so the
+    // trampoline's call sees a correctly aligned stack.
+    uint64_t* top = (uint64_t*)((uintptr_t) stack_top & ~(uintptr_t) 15);
+    uint64_t* sp = top - 8;
+    sp[0] = 0x037F00001F80ull;                        // default MXCSR and x87 control word
+    sp[1] = 0;                                        // r15
+    sp[2] = 0;                                        // r14
+    sp[3] = (uint64_t)(uintptr_t) x_fiber_main;       // r13
+    sp[4] = (uint64_t)(uintptr_t) fiber;              // r12
+    sp[5] = 0;                                        // rbx
+    sp[6] = 0;                                        // rbp
+    sp[7] = (uint64_t)(uintptr_t) x_fiber_trampoline_asm;
+    ctx->sp = sp;
+  }
+
+#elif defined(__aarch64__)
+
+  __asm__(
+      ".text\n"
+      ".globl " X_FIBER_ASM_SYMBOL(x_fiber_switch_asm) "\n"
+      X_FIBER_ASM_TYPE(x_fiber_switch_asm)
+      ".p2align 4\n"
+      X_FIBER_ASM_SYMBOL(x_fiber_switch_asm) ":\n"
+      "  sub sp, sp, #160\n"
+      "  stp x19, x20, [sp, #0]\n"
+      "  stp x21, x22, [sp, #16]\n"
+      "  stp x23, x24, [sp, #32]\n"
+      "  stp x25, x26, [sp, #48]\n"
+      "  stp x27, x28, [sp, #64]\n"
+      "  stp x29, x30, [sp, #80]\n"
+      "  stp d8,  d9,  [sp, #96]\n"
+      "  stp d10, d11, [sp, #112]\n"
+      "  stp d12, d13, [sp, #128]\n"
+      "  stp d14, d15, [sp, #144]\n"
+      "  mov x2, sp\n"
+      "  str x2, [x0]\n"
+      "  mov sp, x1\n"
+      "  ldp x19, x20, [sp, #0]\n"
+      "  ldp x21, x22, [sp, #16]\n"
+      "  ldp x23, x24, [sp, #32]\n"
+      "  ldp x25, x26, [sp, #48]\n"
+      "  ldp x27, x28, [sp, #64]\n"
+      "  ldp x29, x30, [sp, #80]\n"
+      "  ldp d8,  d9,  [sp, #96]\n"
+      "  ldp d10, d11, [sp, #112]\n"
+      "  ldp d12, d13, [sp, #128]\n"
+      "  ldp d14, d15, [sp, #144]\n"
+      "  add sp, sp, #160\n"
+      "  ret\n"
+      ".globl " X_FIBER_ASM_SYMBOL(x_fiber_trampoline_asm) "\n"
+      X_FIBER_ASM_TYPE(x_fiber_trampoline_asm)
+      ".p2align 4\n"
+      X_FIBER_ASM_SYMBOL(x_fiber_trampoline_asm) ":\n"
+      "  mov x0, x19\n"
+      "  blr x20\n"
+      "  brk #0\n");
+
+  static void x_fiber_context_init(XFiberContext* ctx, void* stack_top, XFiber* fiber)
+  {
+    // Frame popped by the first switch: x19..x30 followed by d8..d15
+    uint64_t* top = (uint64_t*)((uintptr_t) stack_top & ~(uintptr_t) 15);
+    uint64_t* sp = top - 20;
+    memset(sp, 0, 20 * sizeof(uint64_t));
+    sp[0] = (uint64_t)(uintptr_t) fiber;                      // x19
+    sp[1] = (uint64_t)(uintptr_t) x_fiber_main;               // x20
+    sp[11] = (uint64_t)(uintptr_t) x_fiber_trampoline_asm;    // x30
+    ctx->sp = sp;
+  }
+
+#endif
+
+  static inline void x_fiber_context_switch(XFiberContext* from, XFiberContext* to)
+  {
+    x_fiber_switch_asm(&from->sp, to->sp);
+  }
+
+#elif defined(X_FIBER_BACKEND_UCONTEXT)
+
+  static void x_fiber_ucontext_entry(unsigned int hi, unsigned int lo)
+  {
+    XFiber* fiber = (XFiber*)(((uintptr_t) hi << 16 << 16) | (uintptr_t) lo);
+    x_fiber_main(fiber);
+  }
+
+  static void x_fiber_context_init(XFiberContext* ctx, void* stack_top, XFiber* fiber)
+  {
+    uintptr_t ptr = (uintptr_t) fiber;
+    getcontext(&ctx->uc);
+    ctx->uc.uc_stack.ss_sp = (char*) stack_top - fiber->stack_size;
+    ctx->uc.uc_stack.ss_size = fiber->stack_size;
+    ctx->uc.uc_link = NULL;
+    makecontext(&ctx->uc, (void (*)(void)) x_fiber_ucontext_entry, 2,
+        (unsigned int)(ptr >> 16 >> 16), (unsigned int)(ptr & 0xFFFFFFFFu));
+  }
+
+  static inline void x_fiber_context_switch(XFiberContext* from, XFiberContext* to)
+  {
+    swapcontext(&from->uc, &to->uc);
+  }
+
+#elif defined(X_FIBER_BACKEND_WIN32)
+
+  static VOID CALLBACK x_fiber_win32_entry(LPVOID param)
+  {
+    x_fiber_main((XFiber*) param);
+  }
+
+  static inline void x_fiber_context_switch(XFiberContext* from, XFiberContext* to)
+  {
+    (void) from;
+    SwitchToFiber(to->handle);
+  }
+
+#endif
+
+  // ---------------------------------------------------------------------------
+  // Stacks
+  // ---------------------------------------------------------------------------
+
+  static size_t x_fiber_page_size(void)
+  {
+#if defined(X_FIBER_BACKEND_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t) sysconf(_SC_PAGESIZE);
+#endif
+  }
+
+  static XFiber* x_fiber_alloc(XFiberScheduler* sched)
+  {
+    XFiber* fiber = calloc(1, sizeof(XFiber));
+    if (!fiber)
+      return NULL;
+    fiber->sched = sched;
+
+#if defined(X_FIBER_BACKEND_WIN32)
+    // Win32 fibers own their stack, guard page included
+    fiber->stack_size = sched->stack_size;
+    fiber->ctx.handle = CreateFiber(sched->stack_size, x_fiber_win32_entry, fiber);
+    if (!fiber->ctx.handle)
+    {
+      free(fiber);
+      return NULL;
+    }
+#else
+    size_t page = x_fiber_page_size();
+    size_t size = (sched->stack_size + page - 1) & ~(page - 1);
+    void* stack = mmap(NULL, size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED)
+    {
+      free(fiber);
+      return NULL;
+    }
+
+    // Stacks grow down: an overflow runs into the inaccessible lowest page
+    mprotect(stack, page, PROT_NONE);
+    fiber->stack = stack;
+    fiber->stack_size = size;
+    x_fiber_context_init(&fiber->ctx, (char*) stack + page + size, fiber);
+#endif
+    return fiber;
+  }
+
+  static void x_fiber_free(XFiber* fiber)
+  {
+#if defined(X_FIBER_BACKEND_WIN32)
+    DeleteFiber(fiber->ctx.handle);
+#else
+    munmap(fiber->stack, fiber->stack_size + x_fiber_page_size());
+#endif
+    free(fiber);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Scheduling
+  // ---------------------------------------------------------------------------
+
+  // Fiber entry. The loop lets a finished fiber be reused for a new
+  // function without rebuilding its context.
+  static void x_fiber_main(XFiber* fiber)
+  {
+    for (;;)
+    {
+      fiber->fn(fiber->arg);
+      fiber->action = X_FIBER_ACTION_DONE;
+      x_fiber_context_switch(&fiber->ctx, &x_fiber_thread()->ctx);
+    }
+  }
+
+  static void x_fiber_run_task(void* arg);
+
+  static void x_fiber_schedule(XFiber* fiber)
+  {
+    if (threadpool_enqueue(fiber->sched->pool, x_fiber_run_task, fiber) != 0)
+      x_fiber_run_task(fiber);
+  }
+
+  static void x_fiber_finish(XFiber* fiber)
+  {
+    XFiberScheduler* sched = fiber->sched;
+    if (!x_mpmc_try_push(sched->cache, &fiber))
+      x_fiber_free(fiber);
+
+    if (x_atomic_add_i32(&sched->live, -1) == 1)
+    {
+      x_thread_mutex_lock(sched->lock);
+      x_thread_condvar_broadcast(sched->idle);
+      x_thread_mutex_unlock(sched->lock);
+    }
+  }
+
+  // Pool task that runs one slice of a fiber, until it yields, suspends or ends
+  static void x_fiber_run_task(void* arg)
+  {
+    XFiber* fiber = (XFiber*) arg;
+    XFiberThread* thread = x_fiber_thread();
+
+#if defined(X_FIBER_BACKEND_WIN32)
+    if (!thread->converted)
+    {
+      thread->ctx.handle = IsThreadAFiber() ? GetCurrentFiber() : ConvertThreadToFiber(NULL);
+      thread->converted = true;
+    }
+#endif
+
+    XFiber* outer = thread->current;
+    XFiberContext saved = thread->ctx;
+
+    thread->current = fiber;
+    x_fiber_context_switch(&thread->ctx, &fiber->ctx);
+    thread->current = outer;
+    thread->ctx = saved;
+
+    switch (fiber->action)
+    {
+      case X_FIBER_ACTION_YIELD:
+        x_fiber_schedule(fiber);
+        break;
+
+      case X_FIBER_ACTION_SUSPEND:
+        // A resume that raced ahead of the suspend left a permit behind
+        if (x_atomic_add_i32(&fiber->wake, -1) > 0)
+          x_fiber_schedule(fiber);
+        break;
+
+      case X_FIBER_ACTION_DONE:
+        x_fiber_finish(fiber);
+        break;
+    }
+  }
+
+  static void x_fiber_switch_out(XFiberAction action)
+  {
+    XFiberThread* thread = x_fiber_thread();
+    XFiber* fiber = thread->current;
+    if (!fiber)
+    {
+      if (action == X_FIBER_ACTION_YIELD)
+        x_thread_yield();
+      return;
+    }
+
+    fiber->action = action;
+    x_fiber_context_switch(&fiber->ctx, &thread->ctx);
+  }
+
+  XFiberScheduler* x_fiber_scheduler_create(XThreadPool* pool, size_t stack_size)
+  {
+    if (!pool)
+      return NULL;
+
+    XFiberScheduler* sched = calloc(1, sizeof(XFiberScheduler));
+    if (!sched)
+      return NULL;
+
+    sched->pool = pool;
+    sched->stack_size = stack_size ? stack_size : STDX_FIBER_DEFAULT_STACK_SIZE;
+    sched->cache = x_mpmc_create(sizeof(XFiber*), STDX_FIBER_CACHE_SIZE);
+    x_thread_mutex_init(&sched->lock);
+    x_thread_condvar_init(&sched->idle);
+    return sched;
+  }
+
+  void x_fiber_scheduler_wait(XFiberScheduler* sched)
+  {
+    x_thread_mutex_lock(sched->lock);
+    while (x_atomic_load_i32(&sched->live) > 0)
+      x_thread_condvar_wait(sched->idle, sched->lock);
+    x_thread_mutex_unlock(sched->lock);
+  }
+
+  void x_fiber_scheduler_destroy(XFiberScheduler* sched)
+  {
+    if (!sched)
+      return;
+
+    x_fiber_scheduler_wait(sched);
+
+    XFiber* fiber;
+    while (x_mpmc_try_pop(sched->cache, &fiber))
+      x_fiber_free(fiber);
+
+    x_mpmc_destroy(sched->cache);
+    x_thread_mutex_destroy(sched->lock);
+    x_thread_condvar_destroy(sched->idle);
+    free(sched);
+  }
+
+  int x_fiber_spawn(XFiberScheduler* sched, XFiberFn fn, void* arg)
+  {
+    if (!sched || !fn)
+      return -1;
+
+    XFiber* fiber;
+    if (!x_mpmc_try_pop(sched->cache, &fiber))
+    {
+      fiber = x_fiber_alloc(sched);
+      if (!fiber)
+        return -1;
+    }
+
+    fiber->fn = fn;
+    fiber->arg = arg;
+    fiber->wake = 0;
+    x_atomic_add_i32(&sched->live, 1);
+    x_fiber_schedule(fiber);
+    return 0;
+  }
+
+  XFiber* x_fiber_current(void)
+  {
+    return x_fiber_thread()->current;
+  }
+
+  void x_fiber_yield(void)
+  {
+    x_fiber_switch_out(X_FIBER_ACTION_YIELD);
+  }
+
+  void x_fiber_suspend(void)
+  {
+    x_fiber_switch_out(X_FIBER_ACTION_SUSPEND);
+  }
+
+  void x_fiber_resume(XFiber* fiber)
+  {
+    if (fiber && x_atomic_add_i32(&fiber->wake, 1) == -1)
+      x_fiber_schedule(fiber);
+  }
+
+#endif // STDX_IMPLEMENTATION_FIBER
+
+#ifdef STDX_INTERNAL_THREAD_IMPLEMENTATION
+#undef STDX_IMPLEMENTATION_THREAD
+#undef STDX_INTERNAL_THREAD_IMPLEMENTATION
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STDX_FIBER_H
@@ -9,6 +9,26 @@
  *   - Source location tagging (file, line, function)
  *   - Multiple log output targets selectable via flags
  *   - Convenience macros for common log levels (debug, info, warning, error, fatal)
+ *   - Asynchronous mode: producers format into a preallocated lock-free ring
+ *     and a background writer batches records into large writes
+ *   - Safe to use from any thread: per-thread formatting buffers, one write
+ *     per record, a lock-free level check, and init/close that wait for
+ *     in-flight calls instead of racing them
+ *   - Binary mode (x_log_bin): call sites register once and each record is a
+ *     site id, a timestamp and the raw argument bytes in a per-thread ring;
+ *     text is rebuilt in the background or offline with logger_bin_decode
+ *   - File flush policies with a large write buffer, and rotation by size or
+ *     age with a background hook for the rotated files (e.g. to compress them)
+ *   - Structured records (x_log_kv) with typed fields, written as JSON lines
+ *     or logfmt
+ *   - Per call site rate limiting and 1-in-N sampling macros
+ *   - Extra sinks with their own level and formatter, including an in-memory
+ *     ring and a local Unix datagram (syslog) sink; the async writer hands
+ *     them records in batches
+ *   - A flight recorder: the last records of every thread, debug level
+ *     included, kept in memory and dumped from a crash handler
+ *   - Named categories (net, fs, ...) with their own runtime level, checked
+ *     with a single load and compare
  *
  * Designed for easy integration and customizable runtime logging control.
  *
@@ -18,6 +38,7 @@
  *
  * Author: marciovmf
  * License: MIT
+ * Dependencies: stdx_thread.h
  * Usage: #include "stdx_log.h"
  */
 
@@ -30,7 +51,7 @@ extern "C"
 #endif
 
 #define STDX_LOG_VERSION_MAJOR 1
-#define STDX_LOG_VERSION_MINOR 0
+#define STDX_LOG_VERSION_MINOR 1
 #define STDX_LOG_VERSION_PATCH 0
 
 #define STDX_LOG_VERSION (STDX_LOG_VERSION_MAJOR * 10000 + STDX_LOG_VERSION_MINOR * 100 + STDX_LOG_VERSION_PATCH)
@@ -41,9 +62,59 @@ extern "C"
   #endif
 #endif
 
+#ifdef STDX_IMPLEMENTATION_LOG
+#ifndef STDX_IMPLEMENTATION_THREAD
+#define STDX_INTERNAL_THREAD_IMPLEMENTATION
+#define STDX_IMPLEMENTATION_THREAD
+#endif
+#endif
+#include <stdx_thread.h>
+#include <stdx_common.h>
+
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifndef STDX_LOG_MIN_LEVEL
+#define STDX_LOG_MIN_LEVEL 0          // Log sites below this level (0 debug, 1 info, 2 warning, 3 error) are compiled out
+#endif
+
+#ifndef STDX_LOG_QUEUE_CAPACITY
+#define STDX_LOG_QUEUE_CAPACITY 8192  // Default number of records in the async ring
+#endif
+
+#ifndef STDX_LOG_SLOT_SIZE
+#define STDX_LOG_SLOT_SIZE 256        // Inline bytes per async record; longer ones go to the heap
+#endif
+
+#ifndef STDX_LOG_WRITER_INTERVAL_MS
+#define STDX_LOG_WRITER_INTERVAL_MS 10 // How long the idle async writer sleeps between polls
+#endif
+
+#ifndef STDX_LOG_BIN_RING_SIZE
+#define STDX_LOG_BIN_RING_SIZE (64 * 1024) // Default per-thread ring for binary records
+#endif
+
+#ifndef STDX_LOG_BIN_MAX_ARGS
+#define STDX_LOG_BIN_MAX_ARGS 16        // Arguments a binary call site may take, '*' widths included
+#endif
+
+#ifndef STDX_LOG_FILE_BUFFER_SIZE
+#define STDX_LOG_FILE_BUFFER_SIZE (256 * 1024) // Default file buffer for the buffered flush policies
+#endif
+
+#ifndef STDX_LOG_SINK_BATCH
+#define STDX_LOG_SINK_BATCH 64          // Most records the async writer hands a sink per call
+#endif
+
+#ifndef STDX_LOG_FLIGHT_RECORD_SIZE
+#define STDX_LOG_FLIGHT_RECORD_SIZE 256 // Bytes the flight recorder keeps per record, longer ones are cut
+#endif
+
+#ifndef STDX_LOG_BATCH_SIZE
+#define STDX_LOG_BATCH_SIZE (64 * 1024) // Bytes the async writer gathers per write call
+#endif
 
   typedef enum
   {
@@ -71,11 +142,22 @@ extern "C"
 
   } XLogComponent;
 
+  /// How x_log_kv records are serialized.
+  typedef enum
+  {
+    XLOG_KV_JSON = 0,         // {"ts":"...","level":"INFO","msg":"...","key":value}
+    XLOG_KV_LOGFMT,           // ts=... level=INFO msg="..." key=value
+  } XLogKVFormat;
+
   typedef struct
   {
-    FILE* file;              // Log file pointer (optional)
+    int fd;                  // Log file descriptor, -1 when none
     int outputs;             // Which outputs enabled (console/file/both)
     XLogLevel level;          // Minimum level to log
+    struct XLogAsync_t* async; // Background writer, NULL when synchronous
+    struct XLogFile_t* file; // Buffering and rotation, NULL when every record is written straight through
+    int time_format;         // XLogTimeFormat
+    XLogKVFormat kv_format;
 #ifdef _WIN32
     bool vt_enabled;         // Windows VT ANSI mode enabled?
 #endif
@@ -102,34 +184,543 @@ extern "C"
     XLOG_COLOR_BRIGHT_WHITE,
   } XLogColor;
 
+  /// What the async ring does when producers outrun the writer.
+  typedef enum
+  {
+    XLOG_OVERFLOW_BLOCK = 0,  // Wait for the writer to free a slot
+    XLOG_OVERFLOW_DROP,       // Discard the record
+    XLOG_OVERFLOW_COUNT,      // Discard the record and log how many were lost
+  } XLogOverflowPolicy;
+
+  /// How XLOG_TIMESTAMP renders: one precision, optionally with flags.
+  typedef enum
+  {
+    XLOG_TIME_SECONDS   = 0,        // [2024-05-01 13:45:12]
+    XLOG_TIME_MILLIS    = 1,        // [2024-05-01 13:45:12.123]
+    XLOG_TIME_MICROS    = 2,        // [2024-05-01 13:45:12.123456]
+    XLOG_TIME_NANOS     = 3,        // [2024-05-01 13:45:12.123456789]
+    XLOG_TIME_PRECISION = 3,        // Mask for the values above
+    XLOG_TIME_UTC       = 1 << 2,   // UTC instead of local time
+    XLOG_TIME_ISO8601   = 1 << 3,   // [2024-05-01T13:45:12.123+02:00], 'Z' for UTC
+  } XLogTimeFormat;
+
+  /// When file output reaches the disk. Buffered records are also written
+  /// when the buffer fills up, when an ERROR or FATAL record is logged, and
+  /// on logger_flush and logger_close.
+  typedef enum
+  {
+    XLOG_FLUSH_ALWAYS = 0,    // Write every record (every batch in async mode) right away
+    XLOG_FLUSH_EVERY_N,       // Once flush_every records are buffered
+    XLOG_FLUSH_INTERVAL,      // At most flush_interval_ms after a record was buffered
+    XLOG_FLUSH_ON_ERROR,      // Only for ERROR and FATAL records, or a full buffer
+  } XLogFlushPolicy;
+
+  /// Called on a background thread with the new name of every file set aside
+  /// by rotation, e.g. to compress or upload it. The file is no longer used
+  /// by the logger.
+  typedef void (*XLogRotateFn)(const char* rotated_path, void* user);
+
+  /// Zero initialize and set what you need. Zero values pick the defaults.
+  typedef struct
+  {
+    int outputs;                  // XLogOutputFlags
+    XLogLevel level;
+    const char* filename;         // Appended to when outputs has XLOG_OUTPUT_FILE
+    bool async;                   // Hand records to a background writer thread
+    size_t queue_capacity;        // Async ring slots, default STDX_LOG_QUEUE_CAPACITY
+    XLogOverflowPolicy overflow;
+    int time_format;              // XLogTimeFormat, default XLOG_TIME_SECONDS in local time
+    XLogKVFormat kv_format;       // x_log_kv output, default JSON lines
+
+    XLogFlushPolicy flush;
+    uint32_t flush_every;         // XLOG_FLUSH_EVERY_N records, default 64
+    uint32_t flush_interval_ms;   // XLOG_FLUSH_INTERVAL, default 1000
+    size_t file_buffer_size;      // Buffered policies, default STDX_LOG_FILE_BUFFER_SIZE
+
+    uint64_t rotate_size;         // Start a new file once it would exceed this many bytes, 0 = never
+    uint32_t rotate_interval_s;   // Start a new file this often, 0 = never
+    XLogRotateFn on_rotate;       // Optional, see XLogRotateFn
+    void* rotate_user;
+  } XLogConfig;
+
+  typedef struct
+  {
+    uint64_t records_written;     // Records handed to the outputs
+    uint64_t records_dropped;     // Records lost to a full async ring, or logged from a sink callback
+    uint64_t writes;              // write calls issued to the log file
+  } XLogStats;
+
   void logger_init(XLogOutputFlags outputs, XLogLevel level, const char *filename);
+
+  /// Initialize from a config. Closes a logger that is already running;
+  /// calls from other threads meanwhile wait for the new one.
+  void logger_init_ex(const XLogConfig* config);
+
+  /// Stops the async writer after it drained every queued record, and closes
+  /// the log file. Console logging keeps working synchronously afterwards.
   void logger_close(void);
+
+  /// Block until every record logged before the call has been written.
+  void logger_flush(void);
+
+  /// Change the minimum level while other threads keep logging.
+  void logger_set_level(XLogLevel level);
+  XLogLevel logger_get_level(void);
+
+  /// Counters since the last logger_init.
+  void logger_stats(XLogStats* out);
+
+  // ---------------------------------------------------------------------------
+  // Sinks
+  // ---------------------------------------------------------------------------
+
+  typedef struct XLogSink_t XLogSink;
+
+  /// One formatted record, newline included. `text` is not NUL terminated.
+  typedef struct
+  {
+    XLogLevel level;
+    const char* text;
+    size_t length;
+  } XLogRecord;
+
+  /// Receives records in the order they were logged: one per call from
+  /// synchronous loggers, batches of up to STDX_LOG_SINK_BATCH from the async
+  /// writer. Calls to the same sink never overlap. Synchronous loggers call
+  /// it on the logging thread. The async writer hands the ring slots back
+  /// before calling it, but a slow sink still slows the writer, and the ring
+  /// then fills and applies its overflow policy as with a slow disk. Records
+  /// logged from inside the callback (or a format callback) are dropped and
+  /// counted in XLogStats.records_dropped.
+  typedef void (*XLogSinkWriteFn)(void* user, const XLogRecord* records, size_t count);
+
+  /// Optional per-sink formatter: write this sink's version of `record` to
+  /// `dst` and return its length. If that is more than `cap`, it is called
+  /// again with a buffer large enough.
+  typedef size_t (*XLogSinkFormatFn)(void* user, const XLogRecord* record, char* dst, size_t cap);
+
+  typedef struct
+  {
+    XLogLevel level;              // Minimum level this sink receives
+    XLogSinkWriteFn write;
+    XLogSinkFormatFn format;      // Optional
+    void (*close)(void* user);    // Optional, called by logger_remove_sink
+    void* user;
+  } XLogSinkDesc;
+
+  /// Register a sink next to the console and file outputs. Sinks stay
+  /// registered across logger_init_ex and logger_close until removed.
+  XLogSink* logger_add_sink(const XLogSinkDesc* desc);
+
+  /// Unregister a sink. Returns once no thread is writing to it any more.
+  void logger_remove_sink(XLogSink* sink);
+
+  /// A sink that keeps the most recent `capacity` bytes of whole records in
+  /// memory, e.g. to attach them to a crash report.
+  XLogSink* logger_add_memory_sink(XLogLevel level, size_t capacity);
+
+  /// Copy a memory sink's records, oldest first. Returns the number of bytes
+  /// held; copies at most `cap` of them and NUL terminates `dst` when `cap` > 0.
+  size_t logger_memory_sink_read(XLogSink* sink, char* dst, size_t cap);
+
+#ifndef _WIN32
+  /// A sink that sends each record as one datagram to a local Unix socket,
+  /// without blocking; records are dropped while the receiver is full or
+  /// absent. With an `ident` the records are framed for syslog
+  /// ("<pri>ident: text"), so "/dev/log" works as `path`.
+  XLogSink* logger_add_unix_sink(XLogLevel level, const char* path, const char* ident);
+#endif
+
+  // ---------------------------------------------------------------------------
+  // Flight recorder
+  // ---------------------------------------------------------------------------
+
+  /// Keep the last `records` records (rounded up to a power of two) of every
+  /// thread in memory, down to `level` even when the outputs are set higher.
+  /// Recording formats into a ring owned by the thread: no locks, no I/O and
+  /// no allocation after the thread's first record. A ring outlives its
+  /// thread, so the dump still shows what an exited thread did last, until a
+  /// new thread takes it over; memory is bounded by the most threads that
+  /// recorded at the same time. Rings are freed by logger_flight_disable.
+  bool logger_flight_enable(XLogLevel level, size_t records);
+  void logger_flight_disable(void);
+
+  /// Write the recorded records to `fd`, thread by thread, oldest first.
+  /// Async-signal-safe, for SIGSEGV/SIGABRT handlers; `fd` can be 2 or a
+  /// file opened with open(). Returns the number of records written.
+  size_t logger_flight_dump(int fd);
+
   void logger_log(XLogLevel level, XLogColor fg, XLogColor bg, XLogComponent components, const char* file, int line, const char* func, const char* fmt,  ...);
   void logger_print(XLogLevel level, const char* fmt, ...);
 
 #define x_log_raw(level, fg, bg, components, fmt, ...)  logger_log(level, fg, bg, components, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
-#define x_log_debug(fmt, ...)      logger_log(XLOG_LEVEL_DEBUG,     XLOG_COLOR_BLUE,    XLOG_COLOR_BLACK, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__)
-#define x_log_info(fmt, ...)       logger_log(XLOG_LEVEL_INFO,      XLOG_COLOR_WHITE,   XLOG_COLOR_BLACK, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__)
-#define x_log_warning(fmt, ...)    logger_log(XLOG_LEVEL_WARNING,   XLOG_COLOR_YELLOW,  XLOG_COLOR_BLACK, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__)
-#define x_log_error(fmt, ...)      logger_log(XLOG_LEVEL_ERROR,     XLOG_COLOR_RED,     XLOG_COLOR_BLACK, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__)
+
+  /// Runtime minimum level. The logging macros compare against it before
+  /// evaluating their arguments; change it with logger_set_level.
+  extern volatile int32_t x_log_level_threshold;
+
+#define x_log_enabled(level) ((int32_t) (level) >= x_atomic_load_i32(&x_log_level_threshold))
+
+#define X_LOG_SITE(hint, level, fg, bg, fmt, ...) \
+  do { if (hint(x_log_enabled(level))) logger_log(level, fg, bg, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__); } while (0)
+
+  // Compiled out, but the arguments are still type checked and count as used
+#define X_LOG_ELIDED(level, fg, bg, fmt, ...) \
+  do { if (0) logger_log(level, fg, bg, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__); } while (0)
+
+#if STDX_LOG_MIN_LEVEL <= 0
+#define x_log_debug(fmt, ...)      X_LOG_SITE(PLAT_UNLIKELY, XLOG_LEVEL_DEBUG, XLOG_COLOR_BLUE, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#else
+#define x_log_debug(fmt, ...)      X_LOG_ELIDED(XLOG_LEVEL_DEBUG, XLOG_COLOR_BLUE, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#endif
+#if STDX_LOG_MIN_LEVEL <= 1
+#define x_log_info(fmt, ...)       X_LOG_SITE(PLAT_LIKELY, XLOG_LEVEL_INFO, XLOG_COLOR_WHITE, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#else
+#define x_log_info(fmt, ...)       X_LOG_ELIDED(XLOG_LEVEL_INFO, XLOG_COLOR_WHITE, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#endif
+#if STDX_LOG_MIN_LEVEL <= 2
+#define x_log_warning(fmt, ...)    X_LOG_SITE(PLAT_LIKELY, XLOG_LEVEL_WARNING, XLOG_COLOR_YELLOW, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#else
+#define x_log_warning(fmt, ...)    X_LOG_ELIDED(XLOG_LEVEL_WARNING, XLOG_COLOR_YELLOW, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#endif
+#if STDX_LOG_MIN_LEVEL <= 3
+#define x_log_error(fmt, ...)      X_LOG_SITE(PLAT_LIKELY, XLOG_LEVEL_ERROR, XLOG_COLOR_RED, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#else
+#define x_log_error(fmt, ...)      X_LOG_ELIDED(XLOG_LEVEL_ERROR, XLOG_COLOR_RED, XLOG_COLOR_BLACK, fmt, ##__VA_ARGS__)
+#endif
 #define x_log_fatal(fmt, ...)      do{ logger_log(XLOG_LEVEL_FATAL, XLOG_COLOR_WHITE,   XLOG_COLOR_RED,   XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__); ASSERT_BREAK();} while(0);
 
+  // ---------------------------------------------------------------------------
+  // Rate limiting and sampling
+  // ---------------------------------------------------------------------------
+
+  /// Per call site state for the _ratelimited and _sampled macros.
+  typedef struct XLogLimiter_t
+  {
+    volatile int64_t tat;           // Earliest time the bucket is full again, in x_thread_time_ns
+    volatile int32_t counter;       // Calls seen, for sampling
+    volatile int32_t suppressed;    // Dropped since the last record that got through
+    // Call site, for reporting what a burst left suppressed. Only limiters
+    // with a file are listed, so they must have static storage.
+    const char* file;
+    int line;
+    XLogLevel level;
+    volatile int32_t listed;
+    struct XLogLimiter_t* next;
+  } XLogLimiter;
+
+  /// Token bucket refilled at `per_sec` tokens per second, holding at most
+  /// `per_sec`. Returns true if a record may go through, with the number of
+  /// records dropped since the previous one in `*suppressed`. Lock-free.
+  bool logger_ratelimit(XLogLimiter* limiter, uint32_t per_sec, int32_t* suppressed);
+
+  /// True for one call in every `one_in`.
+  bool logger_sample(XLogLimiter* limiter, uint32_t one_in);
+
+  /// Log the "N similar messages suppressed" line for every rate limited site
+  /// that dropped records since its last one got through. logger_flush and
+  /// logger_close call it; call it periodically to hear about a burst's tail
+  /// before the site logs again.
+  void logger_report_suppressed(void);
+
+  // A record that gets through after others were dropped is preceded by a
+  // "N similar messages suppressed" line from the same site. Sampling does not
+  // report, since the ratio is fixed.
+#define X_LOG_RATELIMITED(lvl, fg, bg, per_sec, fmt, ...) \
+  do { \
+    static XLogLimiter x_log_limiter_ = { .file = __FILE__, .line = __LINE__, .level = (lvl) }; \
+    int32_t x_log_suppressed_ = 0; \
+    if ((int32_t) (lvl) >= STDX_LOG_MIN_LEVEL && x_log_enabled(lvl) \
+        && logger_ratelimit(&x_log_limiter_, (per_sec), &x_log_suppressed_)) \
+    { \
+      if (x_log_suppressed_) \
+        logger_log(lvl, fg, bg, XLOG_DEFAULT, __FILE__, __LINE__, __func__, "%d similar messages suppressed\n", (int) x_log_suppressed_); \
+      logger_log(lvl, fg, bg, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__); \
+    } \
+  } while (0)
+
+#define X_LOG_SAMPLED(level, fg, bg, one_in, fmt, ...) \
+  do { \
+    static XLogLimiter x_log_limiter_; \
+    if ((int32_t) (level) >= STDX_LOG_MIN_LEVEL && x_log_enabled(level) && logger_sample(&x_log_limiter_, (one_in))) \
+      logger_log(level, fg, bg, XLOG_DEFAULT, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__); \
+  } while (0)
+
+#define x_log_debug_ratelimited(per_sec, fmt, ...)   X_LOG_RATELIMITED(XLOG_LEVEL_DEBUG, XLOG_COLOR_BLUE, XLOG_COLOR_BLACK, per_sec, fmt, ##__VA_ARGS__)
+#define x_log_info_ratelimited(per_sec, fmt, ...)    X_LOG_RATELIMITED(XLOG_LEVEL_INFO, XLOG_COLOR_WHITE, XLOG_COLOR_BLACK, per_sec, fmt, ##__VA_ARGS__)
+#define x_log_warning_ratelimited(per_sec, fmt, ...) X_LOG_RATELIMITED(XLOG_LEVEL_WARNING, XLOG_COLOR_YELLOW, XLOG_COLOR_BLACK, per_sec, fmt, ##__VA_ARGS__)
+#define x_log_error_ratelimited(per_sec, fmt, ...)   X_LOG_RATELIMITED(XLOG_LEVEL_ERROR, XLOG_COLOR_RED, XLOG_COLOR_BLACK, per_sec, fmt, ##__VA_ARGS__)
+
+#define x_log_debug_sampled(one_in, fmt, ...)        X_LOG_SAMPLED(XLOG_LEVEL_DEBUG, XLOG_COLOR_BLUE, XLOG_COLOR_BLACK, one_in, fmt, ##__VA_ARGS__)
+#define x_log_info_sampled(one_in, fmt, ...)         X_LOG_SAMPLED(XLOG_LEVEL_INFO, XLOG_COLOR_WHITE, XLOG_COLOR_BLACK, one_in, fmt, ##__VA_ARGS__)
+#define x_log_warning_sampled(one_in, fmt, ...)      X_LOG_SAMPLED(XLOG_LEVEL_WARNING, XLOG_COLOR_YELLOW, XLOG_COLOR_BLACK, one_in, fmt, ##__VA_ARGS__)
+#define x_log_error_sampled(one_in, fmt, ...)        X_LOG_SAMPLED(XLOG_LEVEL_ERROR, XLOG_COLOR_RED, XLOG_COLOR_BLACK, one_in, fmt, ##__VA_ARGS__)
+
+  // ---------------------------------------------------------------------------
+  // Categories
+  // ---------------------------------------------------------------------------
+
+#define X_LOG_LEVEL_INHERIT -1            // A category following the global level
+#define X_LOG_UNREGISTERED  INT32_MIN     // Lets a category's first check through to register it
+
+  /// A named category with its own level. Define it once at file scope and
+  /// declare it wherever it is used:
+  ///     X_LOG_CATEGORY_DEFINE(log_net, "net");      // net.c
+  ///     X_LOG_CATEGORY_DECLARE(log_net);            // net.h
+  ///     x_log_cat_debug(log_net, "sent %d bytes", n);
+  /// It registers itself the first time it is checked.
+  typedef struct XLogCategory_t
+  {
+    volatile int32_t threshold;   // What the macros compare against
+    volatile int32_t level;       // Own level or X_LOG_LEVEL_INHERIT
+    const char* name;
+    struct XLogCategory_t* next;
+  } XLogCategory;
+
+#define X_LOG_CATEGORY_DEFINE(var, name) XLogCategory var = { X_LOG_UNREGISTERED, X_LOG_LEVEL_INHERIT, name, NULL }
+#define X_LOG_CATEGORY_DECLARE(var) extern XLogCategory var
+
+#define x_log_category_enabled(cat, level) ((int32_t) (level) >= x_atomic_load_i32(&(cat).threshold))
+
+  void logger_log_category(XLogCategory* category, XLogLevel level, const char* file, int line, const char* func, const char* fmt, ...);
+
+  /// Give every category called `name` its own level, or X_LOG_LEVEL_INHERIT
+  /// to follow logger_set_level again. Takes effect at once for registered
+  /// categories; the others pick it up when they register, so a config file
+  /// can set categories of code that has not logged yet.
+  void logger_category_set_level(const char* name, int level);
+
+  /// The level a category called `name` logs at, its own or the global one.
+  XLogLevel logger_category_get_level(const char* name);
+
+#define X_LOG_CAT_SITE(hint, cat, level, fmt, ...) \
+  do { \
+    if ((int32_t) (level) >= STDX_LOG_MIN_LEVEL && hint(x_log_category_enabled(cat, level))) \
+      logger_log_category(&(cat), level, __FILE__, __LINE__, __func__, fmt"\n", ##__VA_ARGS__); \
+  } while (0)
+
+#define x_log_cat_debug(cat, fmt, ...)    X_LOG_CAT_SITE(PLAT_UNLIKELY, cat, XLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define x_log_cat_info(cat, fmt, ...)     X_LOG_CAT_SITE(PLAT_LIKELY, cat, XLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define x_log_cat_warning(cat, fmt, ...)  X_LOG_CAT_SITE(PLAT_LIKELY, cat, XLOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define x_log_cat_error(cat, fmt, ...)    X_LOG_CAT_SITE(PLAT_LIKELY, cat, XLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+  // ---------------------------------------------------------------------------
+  // Structured logging
+  // ---------------------------------------------------------------------------
+
+  typedef enum
+  {
+    XLOG_KV_INT,
+    XLOG_KV_UINT,
+    XLOG_KV_DOUBLE,
+    XLOG_KV_BOOL,
+    XLOG_KV_STR,
+  } XLogKVType;
+
+  /// One typed field of a structured record. Build them with the X_KV_*
+  /// macros; string values are copied when the record is logged.
+  typedef struct
+  {
+    const char* key;
+    XLogKVType type;
+    union
+    {
+      int64_t i;
+      uint64_t u;
+      double d;
+      const char* s;
+    } value;
+  } XLogKV;
+
+#define X_KV_INT(k, v)    ((XLogKV){ (k), XLOG_KV_INT,    { .i = (int64_t) (v) } })
+#define X_KV_UINT(k, v)   ((XLogKV){ (k), XLOG_KV_UINT,   { .u = (uint64_t) (v) } })
+#define X_KV_DOUBLE(k, v) ((XLogKV){ (k), XLOG_KV_DOUBLE, { .d = (double) (v) } })
+#define X_KV_BOOL(k, v)   ((XLogKV){ (k), XLOG_KV_BOOL,   { .i = (v) ? 1 : 0 } })
+#define X_KV_STR(k, v)    ((XLogKV){ (k), XLOG_KV_STR,    { .s = (v) } })
+
+  /// Log `msg` and `fields` as one JSON line or logfmt line, depending on
+  /// XLogConfig.kv_format. Nothing is truncated.
+  void logger_log_kv(XLogLevel level, const char* file, int line, const char* msg, const XLogKV* fields, size_t count);
+
+  ///     x_log_kv(XLOG_LEVEL_INFO, "request done", X_KV_INT("latency_us", us), X_KV_STR("path", path));
+#define x_log_kv(level, msg, ...) \
+  do { \
+    if ((int32_t) (level) >= STDX_LOG_MIN_LEVEL && x_log_enabled(level)) \
+    { \
+      const XLogKV x_log_kv_[] = { { NULL, XLOG_KV_INT, { 0 } }, ##__VA_ARGS__ }; \
+      logger_log_kv((level), __FILE__, __LINE__, (msg), x_log_kv_ + 1, sizeof(x_log_kv_) / sizeof(x_log_kv_[0]) - 1); \
+    } \
+  } while (0)
+
+  // ---------------------------------------------------------------------------
+  // Binary logging
+  // ---------------------------------------------------------------------------
+
+  /// A binary log call site. x_log_bin declares one per statement; it is
+  /// registered on first use, when its format string is parsed once.
+  typedef struct XLogSite_t
+  {
+    const char* file;
+    int line;
+    XLogLevel level;
+    const char* fmt;
+    volatile int32_t id;        // 0 until registered
+    int32_t num_args;           // -1 if fmt has a conversion binary mode can't store
+    uint8_t arg_types[STDX_LOG_BIN_MAX_ARGS];
+    struct XLogSite_t* next;
+  } XLogSite;
+
+  typedef struct
+  {
+    const char* path;           // Binary stream for logger_bin_decode; NULL decodes in the background into the regular outputs
+    size_t ring_size;           // Per-thread ring bytes, default STDX_LOG_BIN_RING_SIZE
+  } XLogBinConfig;
+
+  /// Start the binary consumer. While it is not running, x_log_bin formats
+  /// and logs the record as text right away.
+  bool logger_bin_open(const XLogBinConfig* config);
+
+  /// Drain every ring and stop the consumer.
+  void logger_bin_close(void);
+
+  /// Block until every binary record logged before the call was consumed.
+  void logger_bin_flush(void);
+
+  /// Decode a binary log written by logger_bin_open into text. Must run on
+  /// the same architecture that wrote it. Returns the number of records, or
+  /// -1 if the file can't be read or holds a truncated or malformed record;
+  /// records before the bad one have already been written to `out`.
+  int  logger_bin_decode(const char* path, FILE* out);
+
+  void logger_log_bin(XLogSite* site, ...);
+
+  /// Records are dropped, and counted in XLogStats, when the calling thread's
+  /// ring is full. Arguments are copied by value; strings (%s) are copied too.
+#define x_log_bin(lvl, format, ...) \
+  do { \
+    static XLogSite x_log_site_ = { .file = __FILE__, .line = __LINE__, .level = (lvl), .fmt = format"\n" }; \
+    if ((int32_t) (lvl) >= STDX_LOG_MIN_LEVEL && x_log_enabled(lvl)) \
+      logger_log_bin(&x_log_site_, ##__VA_ARGS__); \
+  } while (0)
+
 #ifdef STDX_IMPLEMENTATION_LOG
 
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#ifndef STDX_LOG_LINE_SIZE
+#define STDX_LOG_LINE_SIZE 2048  // Per-thread formatting buffer; longer records use the heap
+#endif
 
-  static XLogger g_logger =
+#define X_LOG_STRIPES 16
+
+  // What logging falls back to before logger_init and after logger_close
+  static XLogger g_log_console =
   {
-    .file = NULL,
+    .fd = -1,
     .outputs = XLOG_OUTPUT_CONSOLE,
     .level = XLOG_LEVEL_DEBUG,
+    .async = NULL,
+    .file = NULL,
 #ifdef _WIN32
     .vt_enabled = false,
 #endif
   };
 
+  // Published by logger_init_ex while the previous logger drains; calls that
+  // see it wait for the new logger instead of writing anywhere
+  static XLogger g_log_switching = { .fd = -1 };
+
+  // The running logger is swapped as a whole, so a thread that loaded it
+  // sees a consistent set of outputs until it leaves logger_log.
+  static XLogger* volatile g_logger = &g_log_console;
+  volatile int32_t x_log_level_threshold = XLOG_LEVEL_DEBUG;
+  // What the outputs want; the threshold may be lower for the flight recorder
+  static volatile int32_t g_log_output_level = XLOG_LEVEL_DEBUG;
+  static volatile int32_t g_log_admin = 0;   // Serializes init/close
+
+  // Calls in flight, striped over cache lines so concurrent loggers do not
+  // all hit the same counter. There are two sets: calls count into the
+  // current epoch, and retiring a logger flips the epoch and waits only for
+  // the old set to drain, so a steady stream of new calls can't hold it up.
+  typedef struct
+  {
+    volatile int32_t count;
+    char pad[X_CACHE_LINE_SIZE - sizeof(int32_t)];
+  } XLogStripe;
+
+  static XLogStripe g_log_inflight[2][X_LOG_STRIPES];
+  static volatile int32_t g_log_epoch = 0;
+  static volatile int32_t g_log_quiescing = 0;  // Serializes epoch flips
+  static volatile int32_t g_log_next_stripe = 0;
+  static X_THREAD_LOCAL int32_t x_log_tls_stripe = -1;
+
+  static X_THREAD_LOCAL char x_log_tls_prefix[1024];
+  static X_THREAD_LOCAL char x_log_tls_line[STDX_LOG_LINE_SIZE];
+  static X_THREAD_LOCAL bool x_log_tls_in_sink = false;  // Inside a sink's format or write callback
+
+  typedef struct
+  {
+    volatile int64_t sequence;
+    char* heap;               // Record text when it did not fit inline
+    uint32_t length;
+    uint8_t level;
+    uint8_t fg;
+    uint8_t bg;
+    char text[STDX_LOG_SLOT_SIZE];
+  } XLogSlot;
+
+  // Bounded MPSC ring in the style of x_mpmc, except producers format
+  // straight into the slot they claimed instead of copying a finished
+  // element in, and the single consumer needs no CAS.
+  typedef struct XLogAsync_t
+  {
+    volatile int64_t enqueue_pos;
+    char pad0[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+    volatile int64_t dequeue_pos;   // Advanced by the writer only
+    volatile int64_t written_pos;   // Every record before it reached the OS
+    char pad1[X_CACHE_LINE_SIZE - 2 * sizeof(int64_t)];
+
+    XLogSlot* slots;
+    int64_t mask;
+    XLogger* logger;
+    XLogOverflowPolicy overflow;
+    volatile int64_t dropped;
+    int64_t dropped_reported;
+
+    volatile int32_t stop;
+    volatile int32_t writer_waiting;
+    volatile int32_t flush_waiting;
+    XThread* writer;
+    XMutex* lock;
+    XCondVar* wake;                 // The writer parks here
+    XCondVar* drained;              // logger_flush parks here
+
+    char* console_batch;
+    size_t console_len;
+    char* file_batch;
+    size_t file_len;
+    uint32_t file_records;
+    bool file_urgent;               // The batch holds an ERROR or FATAL record
+    char* sink_text;                // Inline records copied out for the sinks, STDX_LOG_SINK_BATCH slots' worth
+  } XLogAsync;
+
+  static volatile int64_t g_log_records_written = 0;
+  static volatile int64_t g_log_records_dropped = 0;
+  static volatile int64_t g_log_writes = 0;
+
   /* Internal helpers */
 
   static int map_color_to_ansi(XLogColor color, bool fg)
@@ -137,23 +728,23 @@ extern "C"
     const int ANSI_BACKGROUND = 10;
     int bg = fg ? 0 : ANSI_BACKGROUND;
     switch (color) {
-      case XLOG_COLOR_BLACK:          return 30 + ANSI_BACKGROUND;
-      case XLOG_COLOR_RED:            return 31 + ANSI_BACKGROUND;
-      case XLOG_COLOR_GREEN:          return 32 + ANSI_BACKGROUND;
-      case XLOG_COLOR_YELLOW:         return 33 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BLUE:           return 34 + ANSI_BACKGROUND;
-      case XLOG_COLOR_MAGENTA:        return 35 + ANSI_BACKGROUND;
-      case XLOG_COLOR_CYAN:           return 36 + ANSI_BACKGROUND;
-      case XLOG_COLOR_WHITE:          return 37 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_BLACK:   return 90 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_RED:     return 91 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_GREEN:   return 92 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_YELLOW:  return 93 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_BLUE:    return 94 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_MAGENTA: return 95 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_CYAN:    return 96 + ANSI_BACKGROUND;
-      case XLOG_COLOR_BRIGHT_WHITE:   return 97 + ANSI_BACKGROUND;
-      default:                   return 39 + ANSI_BACKGROUND; // reset to default
+      case XLOG_COLOR_BLACK:          return 30 + bg;
+      case XLOG_COLOR_RED:            return 31 + bg;
+      case XLOG_COLOR_GREEN:          return 32 + bg;
+      case XLOG_COLOR_YELLOW:         return 33 + bg;
+      case XLOG_COLOR_BLUE:           return 34 + bg;
+      case XLOG_COLOR_MAGENTA:        return 35 + bg;
+      case XLOG_COLOR_CYAN:           return 36 + bg;
+      case XLOG_COLOR_WHITE:          return 37 + bg;
+      case XLOG_COLOR_BRIGHT_BLACK:   return 90 + bg;
+      case XLOG_COLOR_BRIGHT_RED:     return 91 + bg;
+      case XLOG_COLOR_BRIGHT_GREEN:   return 92 + bg;
+      case XLOG_COLOR_BRIGHT_YELLOW:  return 93 + bg;
+      case XLOG_COLOR_BRIGHT_BLUE:    return 94 + bg;
+      case XLOG_COLOR_BRIGHT_MAGENTA: return 95 + bg;
+      case XLOG_COLOR_BRIGHT_CYAN:    return 96 + bg;
+      case XLOG_COLOR_BRIGHT_WHITE:   return 97 + bg;
+      default:                   return 39 + bg; // reset to default
     }
   }
 
@@ -172,7 +763,7 @@ extern "C"
 #endif
 
   /* Enable VT processing on Windows 10+ */
-  static inline void enable_windows_vt(void)
+  static inline void enable_windows_vt(XLogger* logger)
   {
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
     if (hOut == INVALID_HANDLE_VALUE) return;
@@ -183,7 +774,7 @@ extern "C"
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
     if (SetConsoleMode(hOut, dwMode))
     {
-      g_logger.vt_enabled = true;
+      logger->vt_enabled = true;
     }
   }
 
@@ -250,28 +841,34 @@ extern "C"
 
 #else // _WIN32
 
-  /* Output message with ANSI colors */
-  static inline void x_log_output_console_ansi(XLogColor fg, XLogColor bg const char *msg)
+  /* Output message with ANSI colors, in a single write */
+  static inline void x_log_output_console_ansi(XLogColor fg, XLogColor bg, const char *msg, size_t len)
   {
-    //const char* color = ansi_color_code(level);
-    char* color = "\x1b[%d;%dm";
     char color[32];
-    snprintf(color, sizeof(color),
+    int n = snprintf(color, sizeof(color),
         "\x1b[%d;%dm",
         map_color_to_ansi(fg, true),
         map_color_to_ansi(bg, false));
-    fprintf(stdout, "%s%s\x1b[0m", color, msg);
+    struct iovec iov[3] =
+    {
+      { color, (size_t) n },
+      { (void*) msg, len },
+      { (void*) "\x1b[0m", 4 },
+    };
+    if (writev(STDOUT_FILENO, iov, 3) < 0)
+      return;
   }
 #endif
 
   /* Common console output */
-  static inline void x_log_output_console(XLogColor fg, XLogColor bg, const char *msg)
+  static inline void x_log_output_console(XLogger* logger, XLogColor fg, XLogColor bg, const char *msg, size_t len)
   {
 #ifdef _WIN32
     //const char* color_code = ansi_color_code(level);
 
     
-    if (g_logger.vt_enabled)
+    (void) len;
+    if (logger->vt_enabled)
     {
       /* Use ANSI */
       fprintf(stdout,
@@ -286,124 +883,3148 @@ extern "C"
       x_log_output_console_winapi(fg, bg, msg);
     }
 #else
-    x_log_output_console_ansi(msg, level);
+    (void) logger;
+    x_log_output_console_ansi(fg, bg, msg, len);
 #endif
   }
 
-  /* File output (no colors) */
-  static inline void x_log_output_file(const char *msg)
+  static void x_log_fd_write(int fd, const char* data, size_t len)
   {
-    if (g_logger.file)
+    while (len > 0)
     {
-      fputs(msg, g_logger.file);
-      fflush(g_logger.file);
+#ifdef _WIN32
+      int n = _write(fd, data, (unsigned int) (len > 0x40000000 ? 0x40000000 : len));
+#else
+      ssize_t n = write(fd, data, len);
+#endif
+      if (n <= 0)
+        return;
+      data += n;
+      len -= (size_t) n;
     }
   }
 
-  void logger_log(XLogLevel level, XLogColor fg, XLogColor bg, XLogComponent components, const char* file, int line, const char* func, const char* fmt, ...)
+  // Buffered or rotating file output. Writers take the lock; the optional
+  // thread handles interval flushes, timed rotation and on_rotate calls, so
+  // neither ever runs on a thread that is logging.
+  typedef struct XLogFile_t
   {
-    static const char* x_log_level_strings[] =
-    {
-      "DEBUG",
-      "INFO",
-      "WARNING",
-      "ERROR",
-      "FATAL"
-    };
+    XMutex* lock;
+    char* path;
+    char* buffer;
+    size_t len;
+    size_t cap;                   // 0 with XLOG_FLUSH_ALWAYS
+    XLogFlushPolicy flush;
+    uint32_t flush_every;
+    uint32_t flush_interval_ms;
+    uint32_t pending;             // Records in the buffer
+    uint64_t pending_since_ns;    // When the oldest of them was buffered
 
-    if (level < g_logger.level)
+    uint64_t rotate_size;
+    uint32_t rotate_interval_s;
+    uint64_t size;                // Bytes in the current file
+    int64_t opened_s;
+    XLogRotateFn on_rotate;
+    void* rotate_user;
+    char** rotated;               // Waiting for on_rotate
+    size_t rotated_count;
+    size_t rotated_cap;
+
+    XThread* thread;
+    XCondVar* wake;
+    bool stop;
+  } XLogFile;
+
+  static int x_log_open_file(const char* path)
+  {
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+  }
+
+  static void x_log_close_file(int fd)
+  {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+  }
+
+  static void x_log_file_write(XLogger* logger, const char* data, size_t len)
+  {
+    x_log_fd_write(logger->fd, data, len);
+    x_atomic_add_i64(&g_log_writes, 1);
+    if (logger->file)
+      logger->file->size += len;
+  }
+
+  static void x_log_file_flush_locked(XLogger* logger)
+  {
+    XLogFile* f = logger->file;
+    if (f->len)
+      x_log_file_write(logger, f->buffer, f->len);
+    f->len = 0;
+    f->pending = 0;
+  }
+
+  /* Set the current file aside as "<path>.<date>-<time>[.N]" and start a new one */
+  static void x_log_file_rotate_locked(XLogger* logger, int64_t now_s)
+  {
+    XLogFile* f = logger->file;
+    x_log_file_flush_locked(logger);
+    f->opened_s = now_s;
+    if (f->size == 0)
       return;
 
-    char timebuf[30] = {0};
-    if (components & XLOG_TIMESTAMP)
+    size_t cap = strlen(f->path) + 40;
+    char* rotated = malloc(cap);
+    if (!rotated)
+      return;
+    time_t t = (time_t) now_s;
+    struct tm tm_info;
+#ifdef _WIN32
+    localtime_s(&tm_info, &t);
+#else
+    localtime_r(&t, &tm_info);
+#endif
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_info);
+    snprintf(rotated, cap, "%s.%s", f->path, stamp);
+    for (int n = 1; n < 1000; ++n)
     {
-      time_t t = time(NULL);
-      struct tm tm_info;
-
 #ifdef _WIN32
-      localtime_s(&tm_info, &t);
+      if (_access(rotated, 0) != 0)
 #else
-      localtime_r(&t, &tm_info);
+      if (access(rotated, F_OK) != 0)
 #endif
-      strftime(timebuf, sizeof(timebuf), "[%Y-%m-%d %H:%M:%S] ", &tm_info);
+        break;
+      snprintf(rotated, cap, "%s.%s.%d", f->path, stamp, n);
     }
 
-    char tag[32] = {0};
-    if (components & XLOG_TAG)
+    x_log_close_file(logger->fd);
+    bool renamed = rename(f->path, rotated) == 0;
+    logger->fd = x_log_open_file(f->path);
+    f->size = 0;
+    if (!renamed)
     {
-      snprintf((char*) tag, sizeof(tag), "%s ", x_log_level_strings[level]);
+      // Keep appending to the same file rather than losing records
+      free(rotated);
+      return;
     }
 
-    char source_info[1024] = {0};
-    if (components & XLOG_SOURCEINFO)
+    if (f->on_rotate && f->thread)
     {
-      snprintf(source_info, sizeof(source_info), "%s:%d %s() : ", file, line, func);
+      if (f->rotated_count == f->rotated_cap)
+      {
+        size_t grown_cap = f->rotated_cap ? f->rotated_cap * 2 : 4;
+        char** grown = realloc(f->rotated, grown_cap * sizeof(char*));
+        if (!grown)
+        {
+          free(rotated);
+          return;
+        }
+        f->rotated = grown;
+        f->rotated_cap = grown_cap;
+      }
+      f->rotated[f->rotated_count++] = rotated;
+      x_thread_condvar_signal(f->wake);
+      return;
     }
+    free(rotated);
+  }
 
-    /* Format the message body */
-    char msgbuf[1024];
-    va_list args;
-    va_start(args, fmt);
+  static bool x_log_file_rotation_due(XLogFile* f, size_t incoming, int64_t now_s)
+  {
+    if (f->rotate_size && f->size + f->len + incoming > f->rotate_size && f->size + f->len > 0)
+      return true;
+    return f->rotate_interval_s && now_s - f->opened_s >= (int64_t) f->rotate_interval_s;
+  }
 
-#ifdef _WIN32
-    vsnprintf_s(msgbuf, sizeof(msgbuf), _TRUNCATE, fmt, args);
-#else
-    vsnprintf(msgbuf, sizeof(msgbuf), fmt, args);
-#endif
-    va_end(args);
+  /* File output (no colors). `records` is how many records `msg` holds;
+     `urgent` when one of them is ERROR or above. */
+  static void x_log_output_file(XLogger* logger, const char *msg, size_t len, uint32_t records, bool urgent)
+  {
+    XLogFile* f = logger->file;
+    if (!f)
+    {
+      if (logger->fd >= 0)
+        x_log_file_write(logger, msg, len);
+      return;
+    }
+
+    x_thread_mutex_lock(f->lock);
+    if (f->rotate_size || f->rotate_interval_s)
+    {
+      int64_t now_s = (int64_t) time(NULL);
+      if (x_log_file_rotation_due(f, len, now_s))
+        x_log_file_rotate_locked(logger, now_s);
+    }
 
+    if (logger->fd < 0)
+    {
+      x_thread_mutex_unlock(f->lock);
+      return;
+    }
 
-    char finalbuf[1280];
-    snprintf(finalbuf, sizeof(finalbuf), "%s%s%s%s",
-        tag,
-        timebuf,
-        source_info, msgbuf);
+    if (len > f->cap - f->len)
+      x_log_file_flush_locked(logger);
 
-    if (g_logger.outputs & XLOG_OUTPUT_CONSOLE)
+    if (len > f->cap)
     {
-      x_log_output_console(fg, bg, finalbuf);
+      x_log_file_write(logger, msg, len);
+    }
+    else
+    {
+      memcpy(f->buffer + f->len, msg, len);
+      f->len += len;
+      if (f->pending == 0)
+        f->pending_since_ns = x_thread_time_ns();
+      f->pending += records;
+
+      bool flush = urgent;
+      if (f->flush == XLOG_FLUSH_EVERY_N)
+        flush = flush || f->pending >= f->flush_every;
+      else if (f->flush == XLOG_FLUSH_INTERVAL)
+        flush = flush || x_thread_time_ns() - f->pending_since_ns >= (uint64_t) f->flush_interval_ms * 1000000;
+      if (flush)
+        x_log_file_flush_locked(logger);
     }
+    x_thread_mutex_unlock(f->lock);
+  }
+
+  /* Interval flushes and timed rotation, then hand rotated files to on_rotate */
+  static void x_log_file_tick(XLogger* logger)
+  {
+    XLogFile* f = logger->file;
+    x_thread_mutex_lock(f->lock);
+    if (f->flush == XLOG_FLUSH_INTERVAL && f->pending
+        && x_thread_time_ns() - f->pending_since_ns >= (uint64_t) f->flush_interval_ms * 1000000)
+      x_log_file_flush_locked(logger);
+
+    int64_t now_s = (int64_t) time(NULL);
+    if (f->rotate_interval_s && logger->fd >= 0 && x_log_file_rotation_due(f, 0, now_s))
+      x_log_file_rotate_locked(logger, now_s);
 
-    if (g_logger.outputs & XLOG_OUTPUT_FILE)
+    char** rotated = f->rotated;
+    size_t count = f->rotated_count;
+    f->rotated = NULL;
+    f->rotated_count = 0;
+    f->rotated_cap = 0;
+    x_thread_mutex_unlock(f->lock);
+
+    for (size_t i = 0; i < count; ++i)
     {
-      x_log_output_file(finalbuf);
+      f->on_rotate(rotated[i], f->rotate_user);
+      free(rotated[i]);
     }
+    free(rotated);
   }
 
-  /* Initialize logger */
-  void logger_init(XLogOutputFlags outputs, XLogLevel level, const char *filename)
+  static void* x_log_file_main(void* arg)
   {
-    g_logger.outputs = outputs;
-    g_logger.level = level;
-    printf("log initialized\n");
+    XLogger* logger = (XLogger*) arg;
+    XLogFile* f = logger->file;
+    uint32_t period = 1000;
+    if (f->flush == XLOG_FLUSH_INTERVAL && f->flush_interval_ms < period)
+      period = f->flush_interval_ms ? f->flush_interval_ms : 1;
+
+    for (;;)
+    {
+      x_log_file_tick(logger);
+      x_thread_mutex_lock(f->lock);
+      if (!f->stop && f->rotated_count == 0)
+        x_thread_condvar_wait_timeout(f->wake, f->lock, period);
+      bool stop = f->stop;
+      x_thread_mutex_unlock(f->lock);
+      if (stop)
+        break;
+    }
+    x_log_file_tick(logger);
+    return NULL;
+  }
 
+  static XLogFile* x_log_file_create(XLogger* logger, const XLogConfig* config)
+  {
+    XLogFile* f = calloc(1, sizeof(XLogFile));
+    if (!f)
+      return NULL;
+    f->path = malloc(strlen(config->filename) + 1);
+    f->flush = config->flush;
+    f->flush_every = config->flush_every ? config->flush_every : 64;
+    f->flush_interval_ms = config->flush_interval_ms ? config->flush_interval_ms : 1000;
+    f->cap = config->flush == XLOG_FLUSH_ALWAYS ? 0
+      : config->file_buffer_size ? config->file_buffer_size : STDX_LOG_FILE_BUFFER_SIZE;
+    f->buffer = f->cap ? malloc(f->cap) : NULL;
+    if (!f->path || (f->cap && !f->buffer))
+    {
+      free(f->path);
+      free(f->buffer);
+      free(f);
+      return NULL;
+    }
+    strcpy(f->path, config->filename);
+    f->rotate_size = config->rotate_size;
+    f->rotate_interval_s = config->rotate_interval_s;
+    f->on_rotate = config->on_rotate;
+    f->rotate_user = config->rotate_user;
+    f->opened_s = (int64_t) time(NULL);
 #ifdef _WIN32
-    enable_windows_vt();
+    long long end = _lseeki64(logger->fd, 0, SEEK_END);
+#else
+    long long end = (long long) lseek(logger->fd, 0, SEEK_END);
 #endif
+    f->size = end > 0 ? (uint64_t) end : 0;
+    x_thread_mutex_init(&f->lock);
+    x_thread_condvar_init(&f->wake);
+    logger->file = f;
 
-    if ((outputs & XLOG_OUTPUT_FILE) && filename != NULL)
+    if (f->flush == XLOG_FLUSH_INTERVAL || f->rotate_interval_s || f->on_rotate)
     {
-      g_logger.file = fopen(filename, "a");
-      if (!g_logger.file)
-      {
-        fprintf(stderr, "ERROR: Failed to open log file '%s'\n", filename);
-        g_logger.outputs &= ~XLOG_OUTPUT_FILE; /* disable file output */
-      }
+      XThreadAttr attr = { 0 };
+      attr.name = "stdx-logfile";
+      x_thread_create_ex(&f->thread, &attr, x_log_file_main, logger);
     }
+    return f;
   }
 
-  /* Close logger and free resources */
-  void logger_close(void)
+  /* Write what is buffered and wait for pending on_rotate calls */
+  static void x_log_file_destroy(XLogger* logger)
   {
-    if (g_logger.file)
+    XLogFile* f = logger->file;
+    x_thread_mutex_lock(f->lock);
+    x_log_file_flush_locked(logger);
+    f->stop = true;
+    x_thread_condvar_signal(f->wake);
+    x_thread_mutex_unlock(f->lock);
+    if (f->thread)
     {
-      fclose(g_logger.file);
-      g_logger.file = NULL;
+      x_thread_join(f->thread);
+      x_thread_destroy(f->thread);
     }
+    x_thread_mutex_destroy(f->lock);
+    x_thread_condvar_destroy(f->wake);
+    free(f->rotated);
+    free(f->buffer);
+    free(f->path);
+    free(f);
+    logger->file = NULL;
   }
 
+  static inline XLogStripe* x_log_enter(void)
+  {
+    if (x_log_tls_stripe < 0)
+      x_log_tls_stripe = x_atomic_add_i32(&g_log_next_stripe, 1) % X_LOG_STRIPES;
+    for (;;)
+    {
+      // Only counts if the epoch did not flip in between; otherwise the
+      // flip may already have looked at this counter
+      int32_t epoch = x_atomic_load_i32(&g_log_epoch);
+      XLogStripe* stripe = &g_log_inflight[epoch][x_log_tls_stripe];
+      x_atomic_add_i32(&stripe->count, 1);
+      if (x_atomic_load_i32(&g_log_epoch) == epoch)
+        return stripe;
+      x_atomic_add_i32(&stripe->count, -1);
+    }
+  }
 
-#endif //STDX_IMPLEMENTATION_LOG
+  static inline void x_log_leave(XLogStripe* stripe)
+  {
+    x_atomic_add_i32(&stripe->count, -1);
+  }
+
+  /* Enter and load the running logger, waiting out a logger_init_ex swap */
+  static XLogStripe* x_log_enter_logger(XLogger** logger)
+  {
+    for (;;)
+    {
+      XLogStripe* stripe = x_log_enter();
+      *logger = (XLogger*) x_atomic_load_ptr((void* volatile*) &g_logger);
+      if (*logger != &g_log_switching)
+        return stripe;
+      // Not counted while waiting, or the swap could not retire the old one
+      x_log_leave(stripe);
+      x_thread_yield();
+    }
+  }
+
+  /* Wait until every call that might still hold the previous logger left */
+  static void x_log_quiesce(void)
+  {
+    int32_t expected = 0;
+    while (!x_atomic_cas_i32(&g_log_quiescing, &expected, 1))
+    {
+      expected = 0;
+      x_thread_yield();
+    }
+
+    // Calls from before the flip may hold what was just unpublished; calls
+    // after it count into the other set and reload the pointers. A flip
+    // that ran before ours already waited for everything older.
+    int32_t old = x_atomic_load_i32(&g_log_epoch);
+    x_atomic_store_i32(&g_log_epoch, old ^ 1);
+    for (int i = 0; i < X_LOG_STRIPES; ++i)
+    {
+      while (x_atomic_load_i32(&g_log_inflight[old][i].count) != 0)
+        x_thread_yield();
+    }
+
+    x_atomic_store_i32(&g_log_quiescing, 0);
+  }
+
+  static const char* x_log_level_strings[] =
+  {
+    "DEBUG",
+    "INFO",
+    "WARNING",
+    "ERROR",
+    "FATAL"
+  };
+
+  static XLogColor x_log_level_color(XLogLevel level)
+  {
+    switch (level)
+    {
+      case XLOG_LEVEL_DEBUG:   return XLOG_COLOR_BLUE;
+      case XLOG_LEVEL_WARNING: return XLOG_COLOR_YELLOW;
+      case XLOG_LEVEL_ERROR:   return XLOG_COLOR_RED;
+      default:                 return XLOG_COLOR_WHITE;
+    }
+  }
+
+  static int64_t x_log_wall_time_ns(void)
+  {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimePreciseAsFileTime(&ft);
+    uint64_t t = ((uint64_t) ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (int64_t) (t - 116444736000000000ULL) * 100;  // 100ns ticks since 1601
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+  }
+
+  // The date and time only change once a second, so each thread keeps the
+  // last second it rendered and only appends the fraction to it.
+  typedef struct
+  {
+    int64_t second;
+    int format;
+    size_t date_len;
+    size_t zone_len;
+    char date[32];      // "2024-05-01 13:45:12"
+    char zone[8];       // "Z" or "+02:00" in ISO-8601 mode
+  } XLogTimeCache;
+
+  static X_THREAD_LOCAL XLogTimeCache x_log_tls_time = { .second = -1, .format = -1 };
+
+  /* "date time.fraction" for a wall clock time in nanoseconds since the
+     epoch. Returns the length written, which fits in 48 bytes. */
+  static size_t x_log_format_date(char* dst, int64_t wall_ns, int format)
+  {
+    int64_t second = wall_ns / 1000000000;
+    int64_t fraction = wall_ns % 1000000000;
+    if (fraction < 0)
+    {
+      fraction += 1000000000;
+      second--;
+    }
+
+    XLogTimeCache* cache = &x_log_tls_time;
+    if (cache->second != second || cache->format != format)
+    {
+      time_t t = (time_t) second;
+      struct tm tm_info;
+#ifdef _WIN32
+      if (format & XLOG_TIME_UTC) gmtime_s(&tm_info, &t);
+      else localtime_s(&tm_info, &t);
+#else
+      if (format & XLOG_TIME_UTC) gmtime_r(&t, &tm_info);
+      else localtime_r(&t, &tm_info);
+#endif
+      cache->date_len = strftime(cache->date, sizeof(cache->date),
+          (format & XLOG_TIME_ISO8601) ? "%Y-%m-%dT%H:%M:%S" : "%Y-%m-%d %H:%M:%S", &tm_info);
+      cache->zone_len = 0;
+      if ((format & XLOG_TIME_ISO8601) && (format & XLOG_TIME_UTC))
+      {
+        cache->zone[0] = 'Z';
+        cache->zone_len = 1;
+      }
+      else if (format & XLOG_TIME_ISO8601)
+      {
+        // strftime's %z is "+0200"; ISO-8601 extended format wants "+02:00"
+        char offset[8];
+        if (strftime(offset, sizeof(offset), "%z", &tm_info) == 5)
+        {
+          memcpy(cache->zone, offset, 3);
+          cache->zone[3] = ':';
+          memcpy(cache->zone + 4, offset + 3, 2);
+          cache->zone_len = 6;
+        }
+      }
+      cache->second = second;
+      cache->format = format;
+    }
+
+    static const int digits[] = { 0, 3, 6, 9 };
+    int width = digits[format & XLOG_TIME_PRECISION];
+    size_t len = 0;
+    memcpy(dst + len, cache->date, cache->date_len);
+    len += cache->date_len;
+    if (width)
+    {
+      for (int i = width; i < 9; ++i)
+        fraction /= 10;
+      dst[len++] = '.';
+      for (int i = width - 1; i >= 0; --i)
+      {
+        dst[len + i] = (char) ('0' + fraction % 10);
+        fraction /= 10;
+      }
+      len += (size_t) width;
+    }
+    memcpy(dst + len, cache->zone, cache->zone_len);
+    len += cache->zone_len;
+    dst[len] = 0;
+    return len;
+  }
+
+  /* "[date time.fraction] ". Returns the length written, which fits in 64 bytes. */
+  static size_t x_log_format_time(char* dst, int64_t wall_ns, int format)
+  {
+    dst[0] = '[';
+    size_t len = 1 + x_log_format_date(dst + 1, wall_ns, format);
+    dst[len++] = ']';
+    dst[len++] = ' ';
+    dst[len] = 0;
+    return len;
+  }
+
+  /* Tag, timestamp and source location. Returns the length written. */
+  static size_t x_log_format_prefix(char* dst, size_t cap, XLogLevel level, XLogComponent components, int time_format, const char* file, int line, const char* func)
+  {
+    size_t len = 0;
+    dst[0] = 0;
+
+    if (components & XLOG_TAG)
+    {
+      int n = snprintf(dst + len, cap - len, "%s ", x_log_level_strings[level]);
+      if (n > 0) len += (size_t) n < cap - len ? (size_t) n : cap - len - 1;
+    }
+
+    if ((components & XLOG_TIMESTAMP) && cap - len > 64)
+    {
+      len += x_log_format_time(dst + len, x_log_wall_time_ns(), time_format);
+    }
+
+    if (components & XLOG_SOURCEINFO)
+    {
+      int n = snprintf(dst + len, cap - len, "%s:%d %s() : ", file, line, func);
+      if (n > 0) len += (size_t) n < cap - len ? (size_t) n : cap - len - 1;
+    }
+    return len;
+  }
+
+  /* Prefix plus message. Returns the full length, which is >= cap when the
+     record was truncated. */
+  static size_t x_log_render(char* dst, size_t cap, const char* prefix, size_t prefix_len, const char* fmt, va_list args)
+  {
+    size_t n = prefix_len < cap ? prefix_len : cap - 1;
+    memcpy(dst, prefix, n);
+    dst[n] = 0;
+    int m = vsnprintf(dst + n, cap - n, fmt, args);
+    return prefix_len + (m > 0 ? (size_t) m : 0);
+  }
+
+  /* Render into `buf`, or into a heap block when it is too small. Returns
+     the block used; the caller frees it if it is not `buf`. */
+  static char* x_log_render_alloc(char* buf, size_t cap, size_t* out_len, const char* prefix, size_t prefix_len, const char* fmt, va_list args)
+  {
+    va_list copy;
+    va_copy(copy, args);
+    size_t len = x_log_render(buf, cap, prefix, prefix_len, fmt, copy);
+    va_end(copy);
+
+    if (len < cap)
+    {
+      *out_len = len;
+      return buf;
+    }
+
+    char* heap = malloc(len + 1);
+    if (!heap)
+    {
+      *out_len = cap - 1;
+      return buf;
+    }
+    x_log_render(heap, len + 1, prefix, prefix_len, fmt, args);
+    *out_len = len;
+    return heap;
+  }
+
+  typedef struct
+  {
+    size_t count;
+    XLogSink* sinks[];
+  } XLogSinkSet;
+
+  // Replaced as a whole when sinks come and go, like g_logger
+  static XLogSinkSet* volatile g_log_sinks = NULL;
+
+  static void x_log_sinks_write(const XLogRecord* records, size_t count);
+
+  /* Synchronous output of one finished record */
+  static void x_log_emit(XLogger* logger, XLogLevel level, XLogColor fg, XLogColor bg, const char* msg, size_t len)
+  {
+    if (logger->outputs & XLOG_OUTPUT_CONSOLE)
+    {
+      x_log_output_console(logger, fg, bg, msg, len);
+    }
+
+    if (logger->outputs & XLOG_OUTPUT_FILE)
+    {
+      x_log_output_file(logger, msg, len, 1, level >= XLOG_LEVEL_ERROR);
+    }
+
+    if (x_atomic_load_ptr((void* volatile*) &g_log_sinks))
+    {
+      XLogRecord record = { level, msg, len };
+      x_log_sinks_write(&record, 1);
+    }
+    x_atomic_add_i64(&g_log_records_written, 1);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Async writer
+  // ---------------------------------------------------------------------------
+
+  static XLogSlot* x_log_ring_claim(XLogAsync* a, int64_t* out_pos)
+  {
+    int64_t pos = x_atomic_load_i64(&a->enqueue_pos);
+    for (;;)
+    {
+      XLogSlot* slot = &a->slots[pos & a->mask];
+      int64_t diff = x_atomic_load_i64(&slot->sequence) - pos;
+      if (diff == 0)
+      {
+        if (x_atomic_cas_i64(&a->enqueue_pos, &pos, pos + 1))
+        {
+          *out_pos = pos;
+          return slot;
+        }
+      }
+      else if (diff < 0)
+      {
+        return NULL;
+      }
+      else
+      {
+        pos = x_atomic_load_i64(&a->enqueue_pos);
+      }
+    }
+  }
+
+  static bool x_log_ring_ready(XLogAsync* a)
+  {
+    int64_t pos = x_atomic_load_i64(&a->dequeue_pos);
+    return x_atomic_load_i64(&a->slots[pos & a->mask].sequence) == pos + 1;
+  }
+
+  static void x_log_wake(XLogAsync* a, volatile int32_t* waiting, XCondVar* cv)
+  {
+    // Pairs with the fence in the parking paths: either the sleeper sees our
+    // update when it re-checks, or we see it waiting here.
+    x_atomic_fence();
+    if (x_atomic_load_i32(waiting) > 0)
+    {
+      x_thread_mutex_lock(a->lock);
+      x_thread_condvar_broadcast(cv);
+      x_thread_mutex_unlock(a->lock);
+    }
+  }
+
+  static void x_log_batch_flush(XLogAsync* a)
+  {
+    if (a->console_len)
+    {
+      x_log_fd_write(1, a->console_batch, a->console_len);
+      a->console_len = 0;
+    }
+    if (a->file_len)
+    {
+      x_log_output_file(a->logger, a->file_batch, a->file_len, a->file_records, a->file_urgent);
+      a->file_len = 0;
+      a->file_records = 0;
+      a->file_urgent = false;
+    }
+  }
+
+  static void x_log_batch_append(XLogAsync* a, char* batch, size_t* batch_len, const char* data, size_t len)
+  {
+    if (*batch_len + len > STDX_LOG_BATCH_SIZE)
+      x_log_batch_flush(a);
+
+    if (len > STDX_LOG_BATCH_SIZE)
+    {
+      // Too big to gather; write it on its own
+      if (batch == a->file_batch)
+        x_log_output_file(a->logger, data, len, 1, true);
+      else
+        x_log_fd_write(1, data, len);
+      return;
+    }
+    memcpy(batch + *batch_len, data, len);
+    *batch_len += len;
+  }
+
+  static void x_log_batch_record(XLogAsync* a, XLogLevel level, XLogColor fg, XLogColor bg, const char* text, size_t len)
+  {
+    if (a->logger->outputs & XLOG_OUTPUT_CONSOLE)
+    {
+      bool colors = true;
+#ifdef _WIN32
+      colors = a->logger->vt_enabled;
+#endif
+      char color[32];
+      int n = colors ? snprintf(color, sizeof(color), "\x1b[%d;%dm", map_color_to_ansi(fg, true), map_color_to_ansi(bg, false)) : 0;
+      x_log_batch_append(a, a->console_batch, &a->console_len, color, (size_t) n);
+      x_log_batch_append(a, a->console_batch, &a->console_len, text, len);
+      if (colors)
+        x_log_batch_append(a, a->console_batch, &a->console_len, "\x1b[0m", 4);
+    }
+
+    if (a->logger->outputs & XLOG_OUTPUT_FILE)
+    {
+      x_log_batch_append(a, a->file_batch, &a->file_len, text, len);
+      a->file_records++;
+      a->file_urgent = a->file_urgent || level >= XLOG_LEVEL_ERROR;
+    }
+  }
+
+  /* Write out every published record. Returns how many there were. */
+  static size_t x_log_drain(XLogAsync* a)
+  {
+    int64_t pos = a->dequeue_pos;
+    size_t count = 0;
+    XLogRecord records[STDX_LOG_SINK_BATCH];
+    char* owned[STDX_LOG_SINK_BATCH];
+    for (;;)
+    {
+      // Each slot goes back to the producers as soon as its text was copied
+      // out, so the sinks below hold up only this thread
+      bool sinks = x_atomic_load_ptr((void* volatile*) &g_log_sinks) != NULL;
+      size_t n = 0;
+      while (n < STDX_LOG_SINK_BATCH)
+      {
+        XLogSlot* slot = &a->slots[pos & a->mask];
+        if (x_atomic_load_i64(&slot->sequence) != pos + 1)
+          break;
+        const char* text = slot->heap ? slot->heap : slot->text;
+        x_log_batch_record(a, (XLogLevel) slot->level, (XLogColor) slot->fg, (XLogColor) slot->bg, text, slot->length);
+        owned[n] = NULL;
+        if (sinks)
+        {
+          if (slot->heap)
+          {
+            owned[n] = slot->heap;
+            slot->heap = NULL;
+          }
+          else
+          {
+            text = memcpy(a->sink_text + n * STDX_LOG_SLOT_SIZE, slot->text, slot->length);
+          }
+          records[n].level = (XLogLevel) slot->level;
+          records[n].text = text;
+          records[n].length = slot->length;
+        }
+        free(slot->heap);
+        slot->heap = NULL;
+        x_atomic_store_i64(&slot->sequence, pos + a->mask + 1);
+        pos++;
+        n++;
+      }
+      if (n == 0)
+        break;
+
+      if (sinks)
+      {
+        x_log_sinks_write(records, n);
+        for (size_t i = 0; i < n; ++i)
+          free(owned[i]);
+      }
+      count += n;
+    }
+
+    int64_t dropped = x_atomic_load_i64(&a->dropped);
+    if (a->overflow == XLOG_OVERFLOW_COUNT && dropped != a->dropped_reported)
+    {
+      char note[96];
+      int n = snprintf(note, sizeof(note), "WARNING log: %lld records dropped, async queue full\n", (long long) (dropped - a->dropped_reported));
+      a->dropped_reported = dropped;
+      x_log_batch_record(a, XLOG_LEVEL_WARNING, XLOG_COLOR_YELLOW, XLOG_COLOR_BLACK, note, (size_t) n);
+      if (x_atomic_load_ptr((void* volatile*) &g_log_sinks))
+      {
+        XLogRecord record = { XLOG_LEVEL_WARNING, note, (size_t) n };
+        x_log_sinks_write(&record, 1);
+      }
+    }
+
+    x_log_batch_flush(a);
+    x_atomic_store_i64(&a->dequeue_pos, pos);
+    if (count)
+    {
+      x_atomic_add_i64(&g_log_records_written, (int64_t) count);
+      x_atomic_store_i64(&a->written_pos, pos);
+      x_log_wake(a, &a->flush_waiting, a->drained);
+    }
+    return count;
+  }
+
+  static void* x_log_writer_main(void* arg)
+  {
+    XLogAsync* a = (XLogAsync*) arg;
+    for (;;)
+    {
+      if (x_log_drain(a))
+        continue;
+      if (x_atomic_load_i32(&a->stop))
+        break;
+
+      x_thread_mutex_lock(a->lock);
+      x_atomic_store_i32(&a->writer_waiting, 1);
+      x_atomic_fence();
+      if (!x_log_ring_ready(a) && !x_atomic_load_i32(&a->stop))
+        x_thread_condvar_wait_timeout(a->wake, a->lock, STDX_LOG_WRITER_INTERVAL_MS);
+      x_atomic_store_i32(&a->writer_waiting, 0);
+      x_thread_mutex_unlock(a->lock);
+    }
+    return NULL;
+  }
+
+  static XLogAsync* x_log_async_create(XLogger* logger, const XLogConfig* config)
+  {
+    size_t capacity = config->queue_capacity ? config->queue_capacity : STDX_LOG_QUEUE_CAPACITY;
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    XLogAsync* a = calloc(1, sizeof(XLogAsync));
+    if (!a) return NULL;
+    a->slots = malloc(size * sizeof(XLogSlot));
+    a->console_batch = malloc(STDX_LOG_BATCH_SIZE);
+    a->file_batch = malloc(STDX_LOG_BATCH_SIZE);
+    a->sink_text = malloc(STDX_LOG_SINK_BATCH * STDX_LOG_SLOT_SIZE);
+    if (!a->slots || !a->console_batch || !a->file_batch || !a->sink_text)
+    {
+      free(a->slots);
+      free(a->console_batch);
+      free(a->file_batch);
+      free(a->sink_text);
+      free(a);
+      return NULL;
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+      a->slots[i].sequence = (int64_t) i;
+      a->slots[i].heap = NULL;
+    }
+    a->mask = (int64_t) size - 1;
+    a->logger = logger;
+    a->overflow = config->overflow;
+    x_thread_mutex_init(&a->lock);
+    x_thread_condvar_init(&a->wake);
+    x_thread_condvar_init(&a->drained);
+
+    XThreadAttr attr = { 0 };
+    attr.name = "stdx-log";
+    if (x_thread_create_ex(&a->writer, &attr, x_log_writer_main, a) != 0)
+    {
+      x_thread_mutex_destroy(a->lock);
+      x_thread_condvar_destroy(a->wake);
+      x_thread_condvar_destroy(a->drained);
+      free(a->slots);
+      free(a->console_batch);
+      free(a->file_batch);
+      free(a->sink_text);
+      free(a);
+      return NULL;
+    }
+    return a;
+  }
+
+  static void x_log_async_destroy(XLogAsync* a)
+  {
+    x_atomic_store_i32(&a->stop, 1);
+    x_log_wake(a, &a->writer_waiting, a->wake);
+    x_thread_join(a->writer);
+    x_thread_destroy(a->writer);
+    x_thread_mutex_destroy(a->lock);
+    x_thread_condvar_destroy(a->wake);
+    x_thread_condvar_destroy(a->drained);
+    free(a->slots);
+    free(a->console_batch);
+    free(a->file_batch);
+    free(a->sink_text);
+    free(a);
+  }
+
+  /* A slot to write a record into, or NULL if the record was dropped */
+  static XLogSlot* x_log_enqueue_claim(XLogAsync* a, int64_t* pos)
+  {
+    XLogSlot* slot = x_log_ring_claim(a, pos);
+    while (!slot)
+    {
+      if (a->overflow != XLOG_OVERFLOW_BLOCK)
+      {
+        x_atomic_add_i64(&a->dropped, 1);
+        x_atomic_add_i64(&g_log_records_dropped, 1);
+        return NULL;
+      }
+      x_log_wake(a, &a->writer_waiting, a->wake);
+      x_thread_yield();
+      slot = x_log_ring_claim(a, pos);
+    }
+    return slot;
+  }
+
+  static void x_log_enqueue_publish(XLogAsync* a, XLogSlot* slot, int64_t pos, XLogLevel level, XLogColor fg, XLogColor bg, char* text, size_t len)
+  {
+    slot->heap = text != slot->text ? text : NULL;
+    slot->length = (uint32_t) len;
+    slot->level = (uint8_t) level;
+    slot->fg = (uint8_t) fg;
+    slot->bg = (uint8_t) bg;
+    x_atomic_store_i64(&slot->sequence, pos + 1);
+
+    // The idle writer polls every STDX_LOG_WRITER_INTERVAL_MS. Waking it per
+    // record would cost a futex call each time, so only do it when the ring
+    // is filling up or the record is important.
+    if (level >= XLOG_LEVEL_ERROR || pos - x_atomic_load_i64(&a->dequeue_pos) >= (a->mask + 1) / 4)
+      x_log_wake(a, &a->writer_waiting, a->wake);
+  }
+
+  static void x_log_enqueue(XLogAsync* a, XLogLevel level, XLogColor fg, XLogColor bg, const char* prefix, size_t prefix_len, const char* fmt, va_list args)
+  {
+    int64_t pos;
+    XLogSlot* slot = x_log_enqueue_claim(a, &pos);
+    if (!slot)
+      return;
+    size_t len;
+    char* text = x_log_render_alloc(slot->text, sizeof(slot->text), &len, prefix, prefix_len, fmt, args);
+    x_log_enqueue_publish(a, slot, pos, level, fg, bg, text, len);
+  }
+
+  /* Queue an already formatted record */
+  static void x_log_enqueue_text(XLogAsync* a, XLogLevel level, XLogColor fg, XLogColor bg, const char* msg, size_t len)
+  {
+    int64_t pos;
+    XLogSlot* slot = x_log_enqueue_claim(a, &pos);
+    if (!slot)
+      return;
+    char* text = slot->text;
+    if (len > sizeof(slot->text))
+    {
+      text = malloc(len);
+      if (!text)
+      {
+        text = slot->text;
+        len = sizeof(slot->text);
+      }
+    }
+    memcpy(text, msg, len);
+    x_log_enqueue_publish(a, slot, pos, level, fg, bg, text, len);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Flight recorder
+  // ---------------------------------------------------------------------------
+  //
+  // Every thread owns a ring of fixed-size entries and is its only writer.
+  // An entry's seq is cleared while it is rewritten and set to its index + 1
+  // when complete, so a dump taken at any point, even from a signal handler
+  // interrupting the writer, skips entries it would see half written.
+
+  typedef struct
+  {
+    volatile int64_t seq;
+    int32_t level;
+    int32_t length;
+    char text[STDX_LOG_FLIGHT_RECORD_SIZE];
+  } XLogFlightEntry;
+
+  typedef struct XLogFlightRing_t
+  {
+    struct XLogFlightRing_t* next;
+    volatile int64_t head;        // Records written
+    volatile int64_t first;       // First record of the current owner
+    volatile int32_t thread;      // Order in which threads started recording
+    volatile int32_t in_use;      // Cleared when the owner exits; its records stay until reused
+    XLogFlightEntry* entries;
+  } XLogFlightRing;
+
+  typedef struct
+  {
+    XLogFlightRing* volatile rings;   // Push-only
+    volatile int32_t threads;
+    int32_t generation;
+    int32_t level;
+    int64_t mask;
+  } XLogFlight;
+
+  static XLogFlight* volatile g_log_flight = NULL;
+  static volatile int32_t g_log_flight_generation = 0;
+  static X_THREAD_LOCAL XLogFlightRing* x_log_tls_flight_ring = NULL;
+  static X_THREAD_LOCAL int32_t x_log_tls_flight_generation = 0;
+
+  static void x_log_watch_thread_exit(void);
+
+  static XLogFlightRing* x_log_flight_ring(XLogFlight* flight)
+  {
+    // Take the ring of an exited thread before growing the list
+    for (XLogFlightRing* r = (XLogFlightRing*) x_atomic_load_ptr((void* volatile*) &flight->rings); r; r = r->next)
+    {
+      int32_t expected = 0;
+      if (x_atomic_load_i32(&r->in_use) == 0 && x_atomic_cas_i32(&r->in_use, &expected, 1))
+      {
+        // The previous owner's records are not shown under the new thread
+        x_atomic_store_i64(&r->first, x_atomic_load_i64(&r->head));
+        x_atomic_store_i32(&r->thread, x_atomic_add_i32(&flight->threads, 1) + 1);
+        return r;
+      }
+    }
+
+    XLogFlightRing* ring = calloc(1, sizeof(XLogFlightRing));
+    if (!ring)
+      return NULL;
+    ring->entries = calloc((size_t) flight->mask + 1, sizeof(XLogFlightEntry));
+    if (!ring->entries)
+    {
+      free(ring);
+      return NULL;
+    }
+    ring->thread = x_atomic_add_i32(&flight->threads, 1) + 1;
+    ring->in_use = 1;
+
+    void* head = x_atomic_load_ptr((void* volatile*) &flight->rings);
+    do
+    {
+      ring->next = (XLogFlightRing*) head;
+    } while (!x_atomic_cas_ptr((void* volatile*) &flight->rings, &head, ring));
+    return ring;
+  }
+
+  static XLogFlightEntry* x_log_flight_claim(XLogFlight* flight, int64_t* index)
+  {
+    XLogFlightRing* ring = x_log_tls_flight_ring;
+    if (!ring || x_log_tls_flight_generation != flight->generation)
+    {
+      ring = x_log_flight_ring(flight);
+      if (!ring)
+        return NULL;
+      x_log_tls_flight_ring = ring;
+      x_log_tls_flight_generation = flight->generation;
+      x_log_watch_thread_exit();
+    }
+
+    *index = ring->head;
+    XLogFlightEntry* entry = &ring->entries[*index & flight->mask];
+    x_atomic_store_i64(&entry->seq, 0);
+    // The text written next must not become visible before the seq reset
+    x_atomic_fence();
+    return entry;
+  }
+
+  static void x_log_flight_publish(XLogFlightEntry* entry, int64_t index, XLogLevel level, size_t length)
+  {
+    if (length >= sizeof(entry->text))
+    {
+      // Cut, but keep the line break
+      length = sizeof(entry->text);
+      entry->text[length - 1] = '\n';
+    }
+    entry->level = (int32_t) level;
+    entry->length = (int32_t) length;
+    x_atomic_store_i64(&entry->seq, index + 1);
+    x_atomic_store_i64(&x_log_tls_flight_ring->head, index + 1);
+  }
+
+  static void x_log_flight_vrecord(XLogFlight* flight, XLogLevel level, const char* prefix, size_t prefix_len, const char* fmt, va_list args)
+  {
+    int64_t index;
+    XLogFlightEntry* entry = x_log_flight_claim(flight, &index);
+    if (!entry)
+      return;
+    if (prefix_len > sizeof(entry->text))
+      prefix_len = sizeof(entry->text);
+    memcpy(entry->text, prefix, prefix_len);
+    size_t length = prefix_len;
+    if (prefix_len < sizeof(entry->text))
+    {
+      int n = vsnprintf(entry->text + prefix_len, sizeof(entry->text) - prefix_len, fmt, args);
+      length += n > 0 ? (size_t) n : 0;
+    }
+    x_log_flight_publish(entry, index, level, length);
+  }
+
+  static void x_log_flight_text(XLogFlight* flight, XLogLevel level, const char* text, size_t len)
+  {
+    int64_t index;
+    XLogFlightEntry* entry = x_log_flight_claim(flight, &index);
+    if (!entry)
+      return;
+    memcpy(entry->text, text, len < sizeof(entry->text) ? len : sizeof(entry->text));
+    x_log_flight_publish(entry, index, level, len);
+  }
+
+  /* Level the outputs want for a category; NULL for the global one */
+  static int32_t x_log_output_level(XLogCategory* category)
+  {
+    int32_t level = category ? x_atomic_load_i32(&category->level) : X_LOG_LEVEL_INHERIT;
+    return level == X_LOG_LEVEL_INHERIT ? x_atomic_load_i32(&g_log_output_level) : level;
+  }
+
+  /* Records logged by a sink callback are dropped: the sink's lock is held
+     and the thread's line buffer may still be the record being delivered */
+  static bool x_log_reentered(void)
+  {
+    if (!x_log_tls_in_sink)
+      return false;
+    x_atomic_add_i64(&g_log_records_dropped, 1);
+    return true;
+  }
+
+  static void x_log_vlog(XLogCategory* category, XLogLevel level, XLogColor fg, XLogColor bg, XLogComponent components, const char* file, int line, const char* func, const char* fmt, va_list args)
+  {
+    if (x_log_reentered())
+      return;
+    XLogger* logger;
+    XLogStripe* stripe = x_log_enter_logger(&logger);
+
+    char* prefix = x_log_tls_prefix;
+    size_t prefix_len = x_log_format_prefix(prefix, sizeof(x_log_tls_prefix), level, components, logger->time_format, file, line, func);
+    if (category)
+    {
+      int n = snprintf(prefix + prefix_len, sizeof(x_log_tls_prefix) - prefix_len, "[%s] ", category->name);
+      if (n > 0) prefix_len += (size_t) n < sizeof(x_log_tls_prefix) - prefix_len ? (size_t) n : sizeof(x_log_tls_prefix) - prefix_len - 1;
+    }
+
+    XLogFlight* flight = (XLogFlight*) x_atomic_load_ptr((void* volatile*) &g_log_flight);
+    if (flight && (int32_t) level >= flight->level)
+    {
+      va_list copy;
+      va_copy(copy, args);
+      x_log_flight_vrecord(flight, level, prefix, prefix_len, fmt, copy);
+      va_end(copy);
+    }
+    if ((int32_t) level < x_log_output_level(category))
+    {
+      // Only the flight recorder wanted this one
+      x_log_leave(stripe);
+      return;
+    }
+
+    if (logger->async)
+    {
+      x_log_enqueue(logger->async, level, fg, bg, prefix, prefix_len, fmt, args);
+    }
+    else
+    {
+      size_t len;
+      char* text = x_log_render_alloc(x_log_tls_line, sizeof(x_log_tls_line), &len, prefix, prefix_len, fmt, args);
+      x_log_emit(logger, level, fg, bg, text, len);
+      if (text != x_log_tls_line)
+        free(text);
+    }
+    x_log_leave(stripe);
+  }
+
+  void logger_log(XLogLevel level, XLogColor fg, XLogColor bg, XLogComponent components, const char* file, int line, const char* func, const char* fmt, ...)
+  {
+    if ((int32_t) level < x_atomic_load_i32(&x_log_level_threshold))
+      return;
+
+    va_list args;
+    va_start(args, fmt);
+    x_log_vlog(NULL, level, fg, bg, components, file, line, func, fmt, args);
+    va_end(args);
+  }
+
+  static XLogLimiter* volatile g_log_limiters = NULL;  // Push-only, sites that ever suppressed
+
+  static void x_log_limiter_list(XLogLimiter* limiter)
+  {
+    int32_t expected = 0;
+    if (!limiter->file || !x_atomic_cas_i32(&limiter->listed, &expected, 1))
+      return;
+    void* head = x_atomic_load_ptr((void* volatile*) &g_log_limiters);
+    do
+    {
+      limiter->next = (XLogLimiter*) head;
+    } while (!x_atomic_cas_ptr((void* volatile*) &g_log_limiters, &head, limiter));
+  }
+
+  void logger_report_suppressed(void)
+  {
+    for (XLogLimiter* limiter = (XLogLimiter*) x_atomic_load_ptr((void* volatile*) &g_log_limiters); limiter; limiter = limiter->next)
+    {
+      // The site itself may take the count first; each record is reported once
+      int32_t suppressed = x_atomic_load_i32(&limiter->suppressed) ? x_atomic_exchange_i32(&limiter->suppressed, 0) : 0;
+      if (suppressed)
+        logger_log(limiter->level, x_log_level_color(limiter->level), XLOG_COLOR_BLACK, XLOG_DEFAULT,
+            limiter->file, limiter->line, "", "%d similar messages suppressed\n", (int) suppressed);
+    }
+  }
+
+  bool logger_ratelimit(XLogLimiter* limiter, uint32_t per_sec, int32_t* suppressed)
+  {
+    // GCRA form of the token bucket: one timestamp, updated with a CAS
+    int64_t interval = per_sec ? 1000000000 / (int64_t) per_sec : 0;
+    int64_t now = (int64_t) x_thread_time_ns();
+    int64_t tat = x_atomic_load_i64(&limiter->tat);
+    for (;;)
+    {
+      int64_t start = tat > now ? tat : now;
+      if (per_sec == 0 || start - now > 1000000000 - interval)
+      {
+        if (x_atomic_add_i32(&limiter->suppressed, 1) == 0)
+          x_log_limiter_list(limiter);
+        return false;
+      }
+      if (x_atomic_cas_i64(&limiter->tat, &tat, start + interval))
+        break;
+    }
+    *suppressed = x_atomic_load_i32(&limiter->suppressed) ? x_atomic_exchange_i32(&limiter->suppressed, 0) : 0;
+    return true;
+  }
+
+  bool logger_sample(XLogLimiter* limiter, uint32_t one_in)
+  {
+    uint32_t n = (uint32_t) x_atomic_add_i32(&limiter->counter, 1);
+    return one_in <= 1 || n % one_in == 0;
+  }
+
+  static void x_log_admin_lock(void)
+  {
+    int32_t expected = 0;
+    while (!x_atomic_cas_i32(&g_log_admin, &expected, 1))
+    {
+      expected = 0;
+      x_thread_yield();
+    }
+  }
+
+  static void x_log_admin_unlock(void)
+  {
+    x_atomic_store_i32(&g_log_admin, 0);
+  }
+
+  static XLogCategory* g_log_categories = NULL;   // Registered, under the admin lock
+
+  /* A category's threshold, or the global one for NULL. Admin lock held. */
+  static int32_t x_log_threshold_for(XLogCategory* category)
+  {
+    int32_t level = x_log_output_level(category);
+    XLogFlight* flight = (XLogFlight*) x_atomic_load_ptr((void* volatile*) &g_log_flight);
+    if (flight && flight->level < level)
+      level = flight->level;
+    return level;
+  }
+
+  /* The macros check against the lowest level anyone wants. Admin lock held. */
+  static void x_log_update_threshold(void)
+  {
+    x_atomic_store_i32(&x_log_level_threshold, x_log_threshold_for(NULL));
+    for (XLogCategory* category = g_log_categories; category; category = category->next)
+      x_atomic_store_i32(&category->threshold, x_log_threshold_for(category));
+  }
+
+  /* Swap in a new logger and tear the old one down once nobody uses it */
+  static void x_log_install(XLogger* logger)
+  {
+    XLogger* old = (XLogger*) x_atomic_exchange_ptr((void* volatile*) &g_logger, logger);
+    if (old == &g_log_console || old == &g_log_switching)
+      return;
+
+    x_log_quiesce();
+    if (old->async)
+      x_log_async_destroy(old->async);
+    if (old->file)
+      x_log_file_destroy(old);
+    if (old->fd >= 0)
+      x_log_close_file(old->fd);
+    free(old);
+  }
+
+  /* Initialize logger */
+  void logger_init(XLogOutputFlags outputs, XLogLevel level, const char *filename)
+  {
+    XLogConfig config = { 0 };
+    config.outputs = outputs;
+    config.level = level;
+    config.filename = filename;
+    logger_init_ex(&config);
+  }
+
+  void logger_init_ex(const XLogConfig* config)
+  {
+    XLogger* logger = calloc(1, sizeof(XLogger));
+    if (!logger)
+      return;
+    logger->fd = -1;
+    logger->outputs = config->outputs;
+    logger->level = config->level;
+    logger->time_format = config->time_format;
+    logger->kv_format = config->kv_format;
+
+#ifdef _WIN32
+    enable_windows_vt(logger);
+#endif
+
+    if ((config->outputs & XLOG_OUTPUT_FILE) && config->filename != NULL)
+    {
+      logger->fd = x_log_open_file(config->filename);
+      if (logger->fd < 0)
+      {
+        fprintf(stderr, "ERROR: Failed to open log file '%s'\n", config->filename);
+        logger->outputs &= ~XLOG_OUTPUT_FILE; /* disable file output */
+      }
+      else if (config->flush != XLOG_FLUSH_ALWAYS || config->rotate_size || config->rotate_interval_s)
+      {
+        if (!x_log_file_create(logger, config))
+          fprintf(stderr, "ERROR: Failed to set up log file buffering, writing straight through\n");
+      }
+    }
+
+    if (config->async)
+    {
+      logger->async = x_log_async_create(logger, config);
+      if (!logger->async)
+        fprintf(stderr, "ERROR: Failed to start the async log writer, logging synchronously\n");
+    }
+
+    x_log_admin_lock();
+    // Retire the previous logger first so its records land before ours
+    x_log_install(&g_log_switching);
+    x_atomic_store_i64(&g_log_records_written, 0);
+    x_atomic_store_i64(&g_log_records_dropped, 0);
+    x_atomic_store_i64(&g_log_writes, 0);
+    x_atomic_store_i32(&g_log_output_level, (int32_t) config->level);
+    x_log_update_threshold();
+    x_log_install(logger);
+    x_log_admin_unlock();
+  }
+
+  void logger_flush(void)
+  {
+    logger_report_suppressed();
+    XLogger* logger;
+    XLogStripe* stripe = x_log_enter_logger(&logger);
+    XLogAsync* a = logger->async;
+    if (a)
+    {
+      int64_t target = x_atomic_load_i64(&a->enqueue_pos);
+      x_thread_mutex_lock(a->lock);
+      x_atomic_add_i32(&a->flush_waiting, 1);
+      x_thread_condvar_signal(a->wake);
+      while (x_atomic_load_i64(&a->written_pos) < target)
+        x_thread_condvar_wait_timeout(a->drained, a->lock, 10);
+      x_atomic_add_i32(&a->flush_waiting, -1);
+      x_thread_mutex_unlock(a->lock);
+    }
+    if (logger->file)
+    {
+      x_thread_mutex_lock(logger->file->lock);
+      x_log_file_flush_locked(logger);
+      x_thread_mutex_unlock(logger->file->lock);
+    }
+    x_log_leave(stripe);
+  }
+
+  void logger_set_level(XLogLevel level)
+  {
+    x_log_admin_lock();
+    x_atomic_store_i32(&g_log_output_level, (int32_t) level);
+    x_log_update_threshold();
+    x_log_admin_unlock();
+  }
+
+  XLogLevel logger_get_level(void)
+  {
+    return (XLogLevel) x_atomic_load_i32(&g_log_output_level);
+  }
+
+  void logger_stats(XLogStats* out)
+  {
+    out->records_written = (uint64_t) x_atomic_load_i64(&g_log_records_written);
+    out->records_dropped = (uint64_t) x_atomic_load_i64(&g_log_records_dropped);
+    out->writes = (uint64_t) x_atomic_load_i64(&g_log_writes);
+  }
+
+  /* Close logger and free resources */
+  void logger_close(void)
+  {
+    logger_report_suppressed();
+    x_log_admin_lock();
+    x_log_install(&g_log_console);
+    x_log_admin_unlock();
+  }
+
+  // ---------------------------------------------------------------------------
+  // Binary logging
+  // ---------------------------------------------------------------------------
+  //
+  // Producers append [u32 size][u32 site id][u64 time][arguments] to a ring
+  // owned by their thread, 8-byte aligned; a zero size marks the unused tail
+  // before a wrap. One consumer thread walks every ring. The binary file
+  // uses the same records, preceded by a definition of each site (its id
+  // with the top bit set) the first time the site appears.
+
+#define X_LOG_BIN_MAGIC "XLOGBIN1"
+#define X_LOG_BIN_SITE_DEF 0x80000000u
+#define X_LOG_BIN_HEADER 16
+
+  enum
+  {
+    X_LOG_ARG_INT = 1,
+    X_LOG_ARG_LONG,
+    X_LOG_ARG_LLONG,
+    X_LOG_ARG_SIZE,
+    X_LOG_ARG_PTRDIFF,
+    X_LOG_ARG_INTMAX,
+    X_LOG_ARG_DOUBLE,
+    X_LOG_ARG_LDOUBLE,
+    X_LOG_ARG_PTR,
+    X_LOG_ARG_STR,
+  };
+
+  typedef struct
+  {
+    const char* start;          // The '%'
+    const char* end;            // One past the conversion character
+    bool star_width;
+    bool star_precision;
+    int type;                   // X_LOG_ARG_*, 0 for "%%"
+  } XLogFmtSpec;
+
+  typedef struct XLogBinRing_t
+  {
+    volatile int64_t head;      // Bytes produced, written by the owner thread
+    char pad0[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+    volatile int64_t tail;      // Bytes consumed
+    char pad1[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+    struct XLogBinRing_t* next;
+    size_t size;
+    uint8_t* data;
+    volatile int32_t in_use;    // Cleared when the owner thread exits, so another can take it
+  } XLogBinRing;
+
+  typedef struct
+  {
+    XLogBinRing* volatile rings;  // Push-only
+    size_t ring_size;
+    int32_t generation;
+    int fd;                       // Binary output, -1 to decode into the logger
+    int64_t wall_offset_ns;       // Realtime minus monotonic clock at open
+
+    XThread* thread;
+    XMutex* lock;
+    XCondVar* wake;
+    XCondVar* drained;
+    volatile int32_t stop;
+    volatile int32_t waiting;
+    volatile int32_t flush_waiting;
+    volatile int64_t flush_requested;
+    volatile int64_t flush_done;
+
+    // Consumer only
+    XLogSite** sites;           // By id
+    size_t sites_cap;
+    uint8_t* defined;           // Sites already written to the binary file
+    char* batch;
+    size_t batch_len;
+  } XLogBin;
+
+  static XLogBin* volatile g_log_bin = NULL;
+  static volatile int32_t g_log_bin_generation = 0;
+  static XLogSite* volatile g_log_sites = NULL;
+  static volatile int32_t g_log_next_site = 0;
+  static X_THREAD_LOCAL XLogBinRing* x_log_tls_bin_ring = NULL;
+  static X_THREAD_LOCAL int32_t x_log_tls_bin_generation = 0;
+
+  /* Next conversion in a printf format, or NULL at the end */
+  static const char* x_log_fmt_next(const char* p, XLogFmtSpec* spec)
+  {
+    while (*p && *p != '%')
+      p++;
+    if (!*p)
+      return NULL;
+
+    memset(spec, 0, sizeof(*spec));
+    spec->start = p++;
+    if (*p == '%')
+    {
+      spec->end = p + 1;
+      return spec->end;
+    }
+
+    while (*p && strchr("-+ #0'", *p))
+      p++;
+    if (*p == '*') { spec->star_width = true; p++; }
+    while (*p >= '0' && *p <= '9')
+      p++;
+    if (*p == '.')
+    {
+      p++;
+      if (*p == '*') { spec->star_precision = true; p++; }
+      while (*p >= '0' && *p <= '9')
+        p++;
+    }
+
+    int length = 0;   // 'h' and "hh" promote to int anyway
+    if (*p == 'h') { p++; if (*p == 'h') p++; }
+    else if (*p == 'l') { p++; length = 'l'; if (*p == 'l') { p++; length = 'q'; } }
+    else if (*p == 'j' || *p == 'z' || *p == 't' || *p == 'L') length = *p++;
+
+    switch (*p)
+    {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        spec->type = length == 'l' ? X_LOG_ARG_LONG
+          : length == 'q' ? X_LOG_ARG_LLONG
+          : length == 'z' ? X_LOG_ARG_SIZE
+          : length == 't' ? X_LOG_ARG_PTRDIFF
+          : length == 'j' ? X_LOG_ARG_INTMAX
+          : X_LOG_ARG_INT;
+        break;
+      case 'c':
+        spec->type = length == 0 ? X_LOG_ARG_INT : -1;
+        break;
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec->type = length == 'L' ? X_LOG_ARG_LDOUBLE : X_LOG_ARG_DOUBLE;
+        break;
+      case 's':
+        spec->type = length == 0 ? X_LOG_ARG_STR : -1;
+        break;
+      case 'p':
+        spec->type = X_LOG_ARG_PTR;
+        break;
+      default:
+        spec->type = -1;  // %n, wide strings, or garbage
+        break;
+    }
+    spec->end = *p ? p + 1 : p;
+    return spec->end;
+  }
+
+  static int32_t x_log_bin_parse(XLogSite* site)
+  {
+    int32_t count = 0;
+    XLogFmtSpec spec;
+    const char* p = site->fmt;
+    while ((p = x_log_fmt_next(p, &spec)) != NULL)
+    {
+      if (spec.type == 0)
+        continue;
+      int needed = (spec.star_width ? 1 : 0) + (spec.star_precision ? 1 : 0) + 1;
+      if (spec.type < 0 || count + needed > STDX_LOG_BIN_MAX_ARGS)
+        return -1;
+      if (spec.star_width)
+        site->arg_types[count++] = X_LOG_ARG_INT;
+      if (spec.star_precision)
+        site->arg_types[count++] = X_LOG_ARG_INT;
+      site->arg_types[count++] = (uint8_t) spec.type;
+    }
+    return count;
+  }
+
+  static int32_t x_log_bin_register(XLogSite* site)
+  {
+    int32_t expected = 0;
+    if (x_atomic_cas_i32(&site->id, &expected, -1))
+    {
+      site->num_args = x_log_bin_parse(site);
+      void* head = x_atomic_load_ptr((void* volatile*) &g_log_sites);
+      do
+      {
+        site->next = (XLogSite*) head;
+      } while (!x_atomic_cas_ptr((void* volatile*) &g_log_sites, &head, site));
+      x_atomic_store_i32(&site->id, x_atomic_add_i32(&g_log_next_site, 1) + 1);
+    }
+
+    // Another thread is registering it
+    int32_t id;
+    while ((id = x_atomic_load_i32(&site->id)) < 0)
+      x_thread_yield();
+    return id;
+  }
+
+  static size_t x_log_bin_arg_size(int type)
+  {
+    switch (type)
+    {
+      case X_LOG_ARG_INT:     return sizeof(int);
+      case X_LOG_ARG_LONG:    return sizeof(long);
+      case X_LOG_ARG_LLONG:   return sizeof(long long);
+      case X_LOG_ARG_SIZE:    return sizeof(size_t);
+      case X_LOG_ARG_PTRDIFF: return sizeof(ptrdiff_t);
+      case X_LOG_ARG_INTMAX:  return sizeof(intmax_t);
+      case X_LOG_ARG_DOUBLE:  return sizeof(double);
+      case X_LOG_ARG_LDOUBLE: return sizeof(long double);
+      case X_LOG_ARG_PTR:     return sizeof(void*);
+      default:                return sizeof(uint32_t); // String length, bytes follow
+    }
+  }
+
+  static uint8_t* x_log_bin_encode(uint8_t* dst, int type, va_list* args)
+  {
+#define X_LOG_BIN_PUT(T) { T v = va_arg(*args, T); memcpy(dst, &v, sizeof(v)); return dst + sizeof(v); }
+    switch (type)
+    {
+      case X_LOG_ARG_INT:     X_LOG_BIN_PUT(int)
+      case X_LOG_ARG_LONG:    X_LOG_BIN_PUT(long)
+      case X_LOG_ARG_LLONG:   X_LOG_BIN_PUT(long long)
+      case X_LOG_ARG_SIZE:    X_LOG_BIN_PUT(size_t)
+      case X_LOG_ARG_PTRDIFF: X_LOG_BIN_PUT(ptrdiff_t)
+      case X_LOG_ARG_INTMAX:  X_LOG_BIN_PUT(intmax_t)
+      case X_LOG_ARG_DOUBLE:  X_LOG_BIN_PUT(double)
+      case X_LOG_ARG_LDOUBLE: X_LOG_BIN_PUT(long double)
+      case X_LOG_ARG_PTR:     X_LOG_BIN_PUT(void*)
+      default:
+      {
+        const char* str = va_arg(*args, const char*);
+        if (!str) str = "(null)";
+        uint32_t len = (uint32_t) strlen(str);
+        memcpy(dst, &len, sizeof(len));
+        memcpy(dst + sizeof(len), str, len);
+        return dst + sizeof(len) + len;
+      }
+    }
+#undef X_LOG_BIN_PUT
+  }
+
+  // ---------------------------------------------------------------------------
+  // Thread exit
+  // ---------------------------------------------------------------------------
+
+  // Per-thread rings go back to a free state when their thread exits, so
+  // thread churn reuses them instead of growing the lists. A TLS key whose
+  // value is non-NULL gets its destructor called at exit.
+  static void x_log_thread_exit(void);
+
+#ifdef _WIN32
+  static DWORD g_log_exit_key = FLS_OUT_OF_INDEXES;
+  static void WINAPI x_log_thread_exit_callback(void* value)
+  {
+    if (value)
+      x_log_thread_exit();
+  }
+#else
+  static pthread_key_t g_log_exit_key;
+  static void x_log_thread_exit_callback(void* value)
+  {
+    (void) value;
+    x_log_thread_exit();
+  }
+#endif
+  static volatile int32_t g_log_exit_key_state = 0;  // 0 none, 1 creating, 2 ready, -1 unavailable
+  static X_THREAD_LOCAL bool x_log_tls_exit_watched = false;
+
+  /* Call x_log_thread_exit when the calling thread exits */
+  static void x_log_watch_thread_exit(void)
+  {
+    if (x_log_tls_exit_watched)
+      return;
+    x_log_tls_exit_watched = true;
+
+    int32_t expected = 0;
+    if (x_atomic_cas_i32(&g_log_exit_key_state, &expected, 1))
+    {
+#ifdef _WIN32
+      g_log_exit_key = FlsAlloc(x_log_thread_exit_callback);
+      bool created = g_log_exit_key != FLS_OUT_OF_INDEXES;
+#else
+      bool created = pthread_key_create(&g_log_exit_key, x_log_thread_exit_callback) == 0;
+#endif
+      x_atomic_store_i32(&g_log_exit_key_state, created ? 2 : -1);
+    }
+    int32_t state;
+    while ((state = x_atomic_load_i32(&g_log_exit_key_state)) == 1)
+      x_thread_yield();
+    if (state != 2)
+      return;
+#ifdef _WIN32
+    FlsSetValue(g_log_exit_key, (void*) 1);
+#else
+    pthread_setspecific(g_log_exit_key, (void*) 1);
+#endif
+  }
+
+  static XLogBinRing* x_log_bin_ring(XLogBin* bin)
+  {
+    if (x_log_tls_bin_ring && x_log_tls_bin_generation == bin->generation)
+      return x_log_tls_bin_ring;
+
+    // A ring left by an exited thread keeps its place in the list; whatever
+    // it still holds is drained in order before the new owner's records
+    XLogBinRing* ring = NULL;
+    for (XLogBinRing* r = (XLogBinRing*) x_atomic_load_ptr((void* volatile*) &bin->rings); r; r = r->next)
+    {
+      int32_t expected = 0;
+      if (x_atomic_load_i32(&r->in_use) == 0 && x_atomic_cas_i32(&r->in_use, &expected, 1))
+      {
+        ring = r;
+        break;
+      }
+    }
+
+    if (!ring)
+    {
+      ring = calloc(1, sizeof(XLogBinRing));
+      if (!ring)
+        return NULL;
+      ring->size = bin->ring_size;
+      ring->data = malloc(ring->size);
+      if (!ring->data)
+      {
+        free(ring);
+        return NULL;
+      }
+      ring->in_use = 1;
+
+      void* head = x_atomic_load_ptr((void* volatile*) &bin->rings);
+      do
+      {
+        ring->next = (XLogBinRing*) head;
+      } while (!x_atomic_cas_ptr((void* volatile*) &bin->rings, &head, ring));
+    }
+
+    x_log_tls_bin_ring = ring;
+    x_log_tls_bin_generation = bin->generation;
+    x_log_watch_thread_exit();
+    return ring;
+  }
+
+  /* Hand the exiting thread's rings back, unless they were freed with their owner */
+  static void x_log_thread_exit(void)
+  {
+    XLogStripe* stripe = x_log_enter();
+    XLogBin* bin = (XLogBin*) x_atomic_load_ptr((void* volatile*) &g_log_bin);
+    if (bin && x_log_tls_bin_ring && x_log_tls_bin_generation == bin->generation)
+      x_atomic_store_i32(&x_log_tls_bin_ring->in_use, 0);
+    x_log_tls_bin_ring = NULL;
+    XLogFlight* flight = (XLogFlight*) x_atomic_load_ptr((void* volatile*) &g_log_flight);
+    if (flight && x_log_tls_flight_ring && x_log_tls_flight_generation == flight->generation)
+      x_atomic_store_i32(&x_log_tls_flight_ring->in_use, 0);
+    x_log_tls_flight_ring = NULL;
+    x_log_leave(stripe);
+  }
+
+  static void x_log_wake_bin(XLogBin* bin);
+
+  void logger_log_bin(XLogSite* site, ...)
+  {
+    if ((int32_t) site->level < x_atomic_load_i32(&x_log_level_threshold))
+      return;
+
+    int32_t id = x_atomic_load_i32(&site->id);
+    if (id <= 0)
+      id = x_log_bin_register(site);
+
+    va_list args;
+    va_start(args, site);
+
+    XLogStripe* stripe = x_log_enter();
+    XLogBin* bin = (XLogBin*) x_atomic_load_ptr((void* volatile*) &g_log_bin);
+    if (!bin || site->num_args < 0 || (int32_t) site->level < x_atomic_load_i32(&g_log_output_level))
+    {
+      // Not running, or a format we can't store: log it as text right away
+      x_log_leave(stripe);
+      x_log_vlog(NULL, site->level, x_log_level_color(site->level), site->level == XLOG_LEVEL_FATAL ? XLOG_COLOR_RED : XLOG_COLOR_BLACK,
+          XLOG_DEFAULT, site->file, site->line, "", site->fmt, args);
+      va_end(args);
+      return;
+    }
+
+    XLogBinRing* ring = x_log_bin_ring(bin);
+    if (!ring)
+    {
+      x_log_leave(stripe);
+      va_end(args);
+      return;
+    }
+
+    size_t size = X_LOG_BIN_HEADER;
+    va_list sizing;
+    va_copy(sizing, args);
+    for (int32_t i = 0; i < site->num_args; ++i)
+    {
+      if (site->arg_types[i] == X_LOG_ARG_STR)
+      {
+        const char* str = va_arg(sizing, const char*);
+        size += sizeof(uint32_t) + strlen(str ? str : "(null)");
+      }
+      else
+      {
+        uint8_t scratch[32];
+        x_log_bin_encode(scratch, site->arg_types[i], &sizing);
+        size += x_log_bin_arg_size(site->arg_types[i]);
+      }
+    }
+    va_end(sizing);
+    size = (size + 7) & ~(size_t) 7;
+
+    int64_t head = ring->head;
+    int64_t tail = x_atomic_load_i64(&ring->tail);
+    size_t offset = (size_t) head & (ring->size - 1);
+    size_t contiguous = ring->size - offset;
+    size_t needed = size <= contiguous ? size : size + contiguous;
+    if (size > ring->size / 2 || (int64_t) needed > (int64_t) ring->size - (head - tail))
+    {
+      x_atomic_add_i64(&g_log_records_dropped, 1);
+      x_log_leave(stripe);
+      va_end(args);
+      return;
+    }
+
+    if (size > contiguous)
+    {
+      uint32_t wrap = 0;
+      memcpy(ring->data + offset, &wrap, sizeof(wrap));
+      head += (int64_t) contiguous;
+      offset = 0;
+    }
+
+    uint8_t* dst = ring->data + offset;
+    uint32_t size32 = (uint32_t) size;
+    uint32_t id32 = (uint32_t) id;
+    uint64_t now = x_thread_time_ns();
+    memcpy(dst, &size32, sizeof(size32));
+    memcpy(dst + 4, &id32, sizeof(id32));
+    memcpy(dst + 8, &now, sizeof(now));
+    dst += X_LOG_BIN_HEADER;
+    for (int32_t i = 0; i < site->num_args; ++i)
+      dst = x_log_bin_encode(dst, site->arg_types[i], &args);
+    va_end(args);
+
+    x_atomic_store_i64(&ring->head, head + (int64_t) size);
+    if ((size_t) (head + (int64_t) size - tail) > ring->size / 2)
+      x_log_wake_bin(bin);
+    x_log_leave(stripe);
+  }
+
+  // Growable text. It may start out in a caller's buffer (heap = false) and
+  // moves to the heap when that is too small.
+  typedef struct
+  {
+    char* data;
+    size_t len;
+    size_t cap;
+    bool heap;
+  } XLogText;
+
+  /* Make room for `len` more bytes plus a terminator */
+  static bool x_log_text_reserve(XLogText* t, size_t len)
+  {
+    if (t->len + len + 1 > t->cap)
+    {
+      size_t cap = t->cap ? t->cap : 256;
+      while (cap < t->len + len + 1)
+        cap *= 2;
+      char* grown = t->heap ? realloc(t->data, cap) : malloc(cap);
+      if (!grown)
+        return false;
+      if (!t->heap && t->len)
+        memcpy(grown, t->data, t->len);
+      t->data = grown;
+      t->cap = cap;
+      t->heap = true;
+    }
+    return true;
+  }
+
+  static void x_log_text_append(XLogText* t, const char* data, size_t len)
+  {
+    if (!x_log_text_reserve(t, len))
+      return;
+    memcpy(t->data + t->len, data, len);
+    t->len += len;
+    t->data[t->len] = 0;
+  }
+
+  static void x_log_text_printf(XLogText* t, const char* fmt, ...)
+  {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0)
+      return;
+    if ((size_t) n < sizeof(buf))
+    {
+      x_log_text_append(t, buf, (size_t) n);
+      return;
+    }
+    char* big = malloc((size_t) n + 1);
+    if (!big)
+      return;
+    va_start(args, fmt);
+    vsnprintf(big, (size_t) n + 1, fmt, args);
+    va_end(args);
+    x_log_text_append(t, big, (size_t) n);
+    free(big);
+  }
+
+  /* Rebuild the text of one record */
+  static void x_log_bin_format(XLogText* out, const XLogSite* site, int64_t wall_ns, const uint8_t* args, const uint8_t* end)
+  {
+    char timebuf[64];
+    x_log_format_time(timebuf, wall_ns, XLOG_TIME_NANOS);
+    x_log_text_printf(out, "%s %s%s:%d : ", x_log_level_strings[site->level], timebuf, site->file, site->line);
+
+    const char* p = site->fmt;
+    const char* literal = p;
+    int arg = 0;
+    XLogFmtSpec spec;
+    while ((p = x_log_fmt_next(p, &spec)) != NULL)
+    {
+      x_log_text_append(out, literal, (size_t) (spec.start - literal));
+      literal = spec.end;
+      if (spec.type == 0)
+      {
+        x_log_text_append(out, "%", 1);
+        continue;
+      }
+
+      // Substitute '*' values so the spec can be printed on its own
+      char piece[64];
+      size_t n = 0;
+      for (const char* c = spec.start; c < spec.end && n < sizeof(piece) - 16; ++c)
+      {
+        if (*c == '*')
+        {
+          int value = 0;
+          if (args + sizeof(int) <= end)
+            memcpy(&value, args, sizeof(int));
+          args += sizeof(int);
+          arg++;
+          n += (size_t) snprintf(piece + n, sizeof(piece) - n, "%d", value);
+        }
+        else
+        {
+          piece[n++] = *c;
+        }
+      }
+      piece[n] = 0;
+
+      int type = site->arg_types[arg++];
+      size_t size = x_log_bin_arg_size(type);
+      if (args + size > end)
+        break;
+
+#define X_LOG_BIN_GET(T) { T v; memcpy(&v, args, sizeof(v)); x_log_text_printf(out, piece, v); args += sizeof(v); break; }
+      switch (type)
+      {
+        case X_LOG_ARG_INT:     X_LOG_BIN_GET(int)
+        case X_LOG_ARG_LONG:    X_LOG_BIN_GET(long)
+        case X_LOG_ARG_LLONG:   X_LOG_BIN_GET(long long)
+        case X_LOG_ARG_SIZE:    X_LOG_BIN_GET(size_t)
+        case X_LOG_ARG_PTRDIFF: X_LOG_BIN_GET(ptrdiff_t)
+        case X_LOG_ARG_INTMAX:  X_LOG_BIN_GET(intmax_t)
+        case X_LOG_ARG_DOUBLE:  X_LOG_BIN_GET(double)
+        case X_LOG_ARG_LDOUBLE: X_LOG_BIN_GET(long double)
+        case X_LOG_ARG_PTR:     X_LOG_BIN_GET(void*)
+        default:
+        {
+          uint32_t len;
+          memcpy(&len, args, sizeof(len));
+          args += sizeof(len);
+          if (len > (size_t) (end - args))
+            len = (uint32_t) (end - args);
+          // Print through the original spec so widths and precision apply
+          char* str = malloc((size_t) len + 1);
+          if (str)
+          {
+            memcpy(str, args, len);
+            str[len] = 0;
+            x_log_text_printf(out, piece, str);
+            free(str);
+          }
+          args += len;
+          break;
+        }
+      }
+#undef X_LOG_BIN_GET
+    }
+    x_log_text_append(out, literal, strlen(literal));
+  }
+
+  static XLogSite* x_log_bin_site(XLogBin* bin, uint32_t id)
+  {
+    if (id >= bin->sites_cap || !bin->sites[id])
+    {
+      size_t cap = bin->sites_cap ? bin->sites_cap : 64;
+      int32_t count = x_atomic_load_i32(&g_log_next_site) + 1;
+      while (cap < (size_t) count)
+        cap *= 2;
+      if (cap > bin->sites_cap)
+      {
+        XLogSite** sites = realloc(bin->sites, cap * sizeof(XLogSite*));
+        uint8_t* defined = realloc(bin->defined, cap);
+        if (sites) bin->sites = sites;
+        if (defined) bin->defined = defined;
+        if (!sites || !defined)
+          return NULL;
+        memset(bin->sites + bin->sites_cap, 0, (cap - bin->sites_cap) * sizeof(XLogSite*));
+        memset(bin->defined + bin->sites_cap, 0, cap - bin->sites_cap);
+        bin->sites_cap = cap;
+      }
+      for (XLogSite* s = (XLogSite*) x_atomic_load_ptr((void* volatile*) &g_log_sites); s; s = s->next)
+      {
+        int32_t sid = x_atomic_load_i32(&s->id);
+        if (sid > 0 && (size_t) sid < bin->sites_cap)
+          bin->sites[sid] = s;
+      }
+    }
+    return id < bin->sites_cap ? bin->sites[id] : NULL;
+  }
+
+  static void x_log_bin_batch(XLogBin* bin, const void* data, size_t len)
+  {
+    if (bin->batch_len + len > STDX_LOG_BATCH_SIZE)
+    {
+      x_log_fd_write(bin->fd, bin->batch, bin->batch_len);
+      bin->batch_len = 0;
+    }
+    if (len > STDX_LOG_BATCH_SIZE)
+    {
+      x_log_fd_write(bin->fd, data, len);
+      return;
+    }
+    memcpy(bin->batch + bin->batch_len, data, len);
+    bin->batch_len += len;
+  }
+
+  static void x_log_bin_define(XLogBin* bin, uint32_t id, const XLogSite* site)
+  {
+    uint32_t file_len = (uint32_t) strlen(site->file);
+    uint32_t fmt_len = (uint32_t) strlen(site->fmt);
+    uint32_t size = (X_LOG_BIN_HEADER + 16 + file_len + fmt_len + 7) & ~7u;
+    uint8_t header[X_LOG_BIN_HEADER + 8];
+    uint32_t tagged = id | X_LOG_BIN_SITE_DEF;
+    int32_t level = (int32_t) site->level;
+    int32_t line = site->line;
+    memset(header, 0, sizeof(header));
+    memcpy(header, &size, 4);
+    memcpy(header + 4, &tagged, 4);
+    memcpy(header + 16, &level, 4);
+    memcpy(header + 20, &line, 4);
+    x_log_bin_batch(bin, header, sizeof(header));
+    x_log_bin_batch(bin, &file_len, 4);
+    x_log_bin_batch(bin, site->file, file_len);
+    x_log_bin_batch(bin, &fmt_len, 4);
+    x_log_bin_batch(bin, site->fmt, fmt_len);
+    uint8_t pad[8] = { 0 };
+    x_log_bin_batch(bin, pad, size - (X_LOG_BIN_HEADER + 16 + file_len + fmt_len));
+    bin->defined[id] = 1;
+  }
+
+  static void x_log_bin_consume(XLogBin* bin, const uint8_t* record, uint32_t size, XLogText* text)
+  {
+    uint32_t id;
+    uint64_t when;
+    memcpy(&id, record + 4, 4);
+    memcpy(&when, record + 8, 8);
+    XLogSite* site = x_log_bin_site(bin, id);
+    if (!site)
+      return;
+
+    if (bin->fd >= 0)
+    {
+      if (!bin->defined[id])
+        x_log_bin_define(bin, id, site);
+      x_log_bin_batch(bin, record, size);
+      return;
+    }
+
+    text->len = 0;
+    x_log_bin_format(text, site, (int64_t) when + bin->wall_offset_ns, record + X_LOG_BIN_HEADER, record + size);
+    if (!text->data)
+      return;
+
+    XLogger* logger;
+    XLogStripe* stripe = x_log_enter_logger(&logger);
+    x_log_emit(logger, site->level, x_log_level_color(site->level), site->level == XLOG_LEVEL_FATAL ? XLOG_COLOR_RED : XLOG_COLOR_BLACK, text->data, text->len);
+    x_log_leave(stripe);
+  }
+
+  static size_t x_log_bin_drain(XLogBin* bin, XLogText* text)
+  {
+    size_t count = 0;
+    for (XLogBinRing* ring = (XLogBinRing*) x_atomic_load_ptr((void* volatile*) &bin->rings); ring; ring = ring->next)
+    {
+      int64_t tail = ring->tail;
+      int64_t head = x_atomic_load_i64(&ring->head);
+      while (tail < head)
+      {
+        size_t offset = (size_t) tail & (ring->size - 1);
+        uint32_t size;
+        memcpy(&size, ring->data + offset, sizeof(size));
+        if (size == 0)
+        {
+          tail += (int64_t) (ring->size - offset);
+          continue;
+        }
+        x_log_bin_consume(bin, ring->data + offset, size, text);
+        tail += size;
+        count++;
+      }
+      x_atomic_store_i64(&ring->tail, tail);
+    }
+
+    if (bin->batch_len)
+    {
+      x_log_fd_write(bin->fd, bin->batch, bin->batch_len);
+      bin->batch_len = 0;
+    }
+    return count;
+  }
+
+  static void* x_log_bin_main(void* arg)
+  {
+    XLogBin* bin = (XLogBin*) arg;
+    XLogText text = { 0 };
+    for (;;)
+    {
+      int64_t requested = x_atomic_load_i64(&bin->flush_requested);
+      size_t count = x_log_bin_drain(bin, &text);
+      if (requested != x_atomic_load_i64(&bin->flush_done))
+      {
+        x_atomic_store_i64(&bin->flush_done, requested);
+        x_thread_mutex_lock(bin->lock);
+        x_thread_condvar_broadcast(bin->drained);
+        x_thread_mutex_unlock(bin->lock);
+      }
+      if (count)
+        continue;
+      if (x_atomic_load_i32(&bin->stop))
+        break;
+
+      x_thread_mutex_lock(bin->lock);
+      x_atomic_store_i32(&bin->waiting, 1);
+      x_atomic_fence();
+      if (!x_atomic_load_i32(&bin->stop) && x_atomic_load_i64(&bin->flush_requested) == x_atomic_load_i64(&bin->flush_done))
+        x_thread_condvar_wait_timeout(bin->wake, bin->lock, STDX_LOG_WRITER_INTERVAL_MS);
+      x_atomic_store_i32(&bin->waiting, 0);
+      x_thread_mutex_unlock(bin->lock);
+    }
+    x_log_bin_drain(bin, &text);
+    free(text.data);
+    return NULL;
+  }
+
+  static void x_log_wake_bin(XLogBin* bin)
+  {
+    x_atomic_fence();
+    if (x_atomic_load_i32(&bin->waiting))
+    {
+      x_thread_mutex_lock(bin->lock);
+      x_thread_condvar_signal(bin->wake);
+      x_thread_mutex_unlock(bin->lock);
+    }
+  }
+
+  bool logger_bin_open(const XLogBinConfig* config)
+  {
+    XLogBin* bin = calloc(1, sizeof(XLogBin));
+    if (!bin)
+      return false;
+
+    size_t size = 4096;
+    size_t wanted = config && config->ring_size ? config->ring_size : STDX_LOG_BIN_RING_SIZE;
+    while (size < wanted)
+      size <<= 1;
+    bin->ring_size = size;
+    bin->fd = -1;
+    bin->batch = malloc(STDX_LOG_BATCH_SIZE);
+    if (!bin->batch)
+    {
+      free(bin);
+      return false;
+    }
+
+    bin->wall_offset_ns = x_log_wall_time_ns() - (int64_t) x_thread_time_ns();
+
+    if (config && config->path)
+    {
+#ifdef _WIN32
+      bin->fd = _open(config->path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+      bin->fd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+      if (bin->fd < 0)
+      {
+        fprintf(stderr, "ERROR: Failed to open binary log file '%s'\n", config->path);
+        free(bin->batch);
+        free(bin);
+        return false;
+      }
+      char header[16];
+      memcpy(header, X_LOG_BIN_MAGIC, 8);
+      memcpy(header + 8, &bin->wall_offset_ns, 8);
+      x_log_fd_write(bin->fd, header, sizeof(header));
+    }
+
+    x_thread_mutex_init(&bin->lock);
+    x_thread_condvar_init(&bin->wake);
+    x_thread_condvar_init(&bin->drained);
+
+    x_log_admin_lock();
+    bool running = x_atomic_load_ptr((void* volatile*) &g_log_bin) != NULL;
+    bool started = false;
+    if (!running)
+    {
+      bin->generation = x_atomic_add_i32(&g_log_bin_generation, 1) + 1;
+      XThreadAttr attr = { 0 };
+      attr.name = "stdx-logbin";
+      started = x_thread_create_ex(&bin->thread, &attr, x_log_bin_main, bin) == 0;
+      if (started)
+        x_atomic_store_ptr((void* volatile*) &g_log_bin, bin);
+    }
+    x_log_admin_unlock();
+    if (started)
+      return true;
+
+    // Nothing was published, so nobody else can see `bin` yet
+    if (running)
+      fprintf(stderr, "ERROR: Binary logging is already running\n");
+    else
+      fprintf(stderr, "ERROR: Failed to start the binary log consumer\n");
+    if (bin->fd >= 0)
+      x_log_close_file(bin->fd);
+    x_thread_mutex_destroy(bin->lock);
+    x_thread_condvar_destroy(bin->wake);
+    x_thread_condvar_destroy(bin->drained);
+    free(bin->batch);
+    free(bin);
+    return false;
+  }
+
+  void logger_bin_flush(void)
+  {
+    XLogStripe* stripe = x_log_enter();
+    XLogBin* bin = (XLogBin*) x_atomic_load_ptr((void* volatile*) &g_log_bin);
+    if (bin)
+    {
+      int64_t target = x_atomic_add_i64(&bin->flush_requested, 1) + 1;
+      x_thread_mutex_lock(bin->lock);
+      x_thread_condvar_signal(bin->wake);
+      while (x_atomic_load_i64(&bin->flush_done) < target)
+        x_thread_condvar_wait_timeout(bin->drained, bin->lock, 10);
+      x_thread_mutex_unlock(bin->lock);
+    }
+    x_log_leave(stripe);
+  }
+
+  void logger_bin_close(void)
+  {
+    x_log_admin_lock();
+    XLogBin* bin = (XLogBin*) x_atomic_exchange_ptr((void* volatile*) &g_log_bin, NULL);
+    x_log_admin_unlock();
+    if (!bin)
+      return;
+
+    // Nobody can append once the in-flight calls are gone
+    x_log_quiesce();
+    x_atomic_store_i32(&bin->stop, 1);
+    x_log_wake_bin(bin);
+    x_thread_join(bin->thread);
+    x_thread_destroy(bin->thread);
+
+    XLogBinRing* ring = bin->rings;
+    while (ring)
+    {
+      XLogBinRing* next = ring->next;
+      free(ring->data);
+      free(ring);
+      ring = next;
+    }
+    if (bin->fd >= 0)
+      x_log_close_file(bin->fd);
+    x_thread_mutex_destroy(bin->lock);
+    x_thread_condvar_destroy(bin->wake);
+    x_thread_condvar_destroy(bin->drained);
+    free(bin->sites);
+    free(bin->defined);
+    free(bin->batch);
+    free(bin);
+  }
+
+  int logger_bin_decode(const char* path, FILE* out)
+  {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+      return -1;
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = file_size > 0 ? malloc((size_t) file_size) : NULL;
+    if (!data || fread(data, 1, (size_t) file_size, f) != (size_t) file_size || file_size < 16 || memcmp(data, X_LOG_BIN_MAGIC, 8) != 0)
+    {
+      free(data);
+      fclose(f);
+      return -1;
+    }
+    fclose(f);
+
+    int64_t wall_offset;
+    memcpy(&wall_offset, data + 8, 8);
+
+    XLogSite* sites = NULL;
+    size_t sites_cap = 0;
+    XLogText text = { 0 };
+    int records = 0;
+    size_t pos = 16;
+    while (pos < (size_t) file_size)
+    {
+      uint32_t size, id;
+      if (pos + X_LOG_BIN_HEADER > (size_t) file_size)
+      {
+        records = -1;
+        break;
+      }
+      memcpy(&size, data + pos, 4);
+      memcpy(&id, data + pos + 4, 4);
+      if (size < X_LOG_BIN_HEADER || size > (size_t) file_size - pos)
+      {
+        records = -1;
+        break;
+      }
+      const uint8_t* record = data + pos;
+      pos += size;
+
+      if (id & X_LOG_BIN_SITE_DEF)
+      {
+        id &= ~X_LOG_BIN_SITE_DEF;
+        if (id >= sites_cap)
+        {
+          size_t cap = sites_cap ? sites_cap : 64;
+          while (cap <= id)
+            cap *= 2;
+          XLogSite* grown = realloc(sites, cap * sizeof(XLogSite));
+          if (!grown)
+          {
+            records = -1;
+            break;
+          }
+          memset(grown + sites_cap, 0, (cap - sites_cap) * sizeof(XLogSite));
+          sites = grown;
+          sites_cap = cap;
+        }
+
+        // Level, line and file length, then the file, the format length and
+        // the format; every length is checked against the record before use
+        int32_t level, line;
+        uint32_t file_len, fmt_len = 0;
+        bool valid = size >= 28;
+        if (valid)
+        {
+          memcpy(&level, record + 16, 4);
+          memcpy(&line, record + 20, 4);
+          memcpy(&file_len, record + 24, 4);
+          valid = level >= XLOG_LEVEL_DEBUG && level <= XLOG_LEVEL_FATAL && 28 + (uint64_t) file_len + 4 <= size;
+        }
+        if (valid)
+        {
+          memcpy(&fmt_len, record + 28 + file_len, 4);
+          valid = 28 + (uint64_t) file_len + 4 + fmt_len <= size;
+        }
+        if (!valid)
+        {
+          records = -1;
+          break;
+        }
+
+        // The strings are copied out of `data` so the site owns them
+        XLogSite* site = &sites[id];
+        free((void*) site->file);
+        site->file = NULL;
+        site->fmt = NULL;
+        char* strings = malloc((size_t) file_len + fmt_len + 2);
+        if (!strings)
+        {
+          records = -1;
+          break;
+        }
+        memcpy(strings, record + 28, file_len);
+        strings[file_len] = 0;
+        memcpy(strings + file_len + 1, record + 32 + file_len, fmt_len);
+        strings[file_len + 1 + fmt_len] = 0;
+        site->file = strings;
+        site->fmt = strings + file_len + 1;
+        site->line = line;
+        site->level = (XLogLevel) level;
+        site->num_args = x_log_bin_parse(site);
+        site->id = (int32_t) id;
+        if (site->num_args < 0)
+        {
+          // A writer never stores a format it can't replay
+          records = -1;
+          break;
+        }
+        continue;
+      }
+
+      if (id >= sites_cap || !sites[id].fmt)
+        continue;
+      uint64_t when;
+      memcpy(&when, record + 8, 8);
+      text.len = 0;
+      x_log_bin_format(&text, &sites[id], (int64_t) when + wall_offset, record + X_LOG_BIN_HEADER, record + size);
+      if (text.data)
+        fwrite(text.data, 1, text.len, out);
+      records++;
+    }
+
+    for (size_t i = 0; i < sites_cap; ++i)
+      free((void*) sites[i].file);
+    free(sites);
+    free(text.data);
+    free(data);
+    return records;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Structured logging
+  // ---------------------------------------------------------------------------
+
+  static void x_log_kv_uint(XLogText* t, uint64_t value)
+  {
+    char digits[24];
+    size_t n = sizeof(digits);
+    do
+    {
+      digits[--n] = (char) ('0' + value % 10);
+      value /= 10;
+    } while (value);
+    x_log_text_append(t, digits + n, sizeof(digits) - n);
+  }
+
+  static void x_log_kv_int(XLogText* t, int64_t value)
+  {
+    if (value < 0)
+    {
+      x_log_text_append(t, "-", 1);
+      x_log_kv_uint(t, (uint64_t) 0 - (uint64_t) value);
+      return;
+    }
+    x_log_kv_uint(t, (uint64_t) value);
+  }
+
+  static void x_log_kv_double(XLogText* t, double value, bool json)
+  {
+    if (value != value || value - value != 0)
+    {
+      // NaN and infinities are not JSON numbers
+      const char* name = value != value ? "nan" : value > 0 ? "inf" : "-inf";
+      x_log_text_append(t, json ? "null" : name, strlen(json ? "null" : name));
+      return;
+    }
+    // Shortest precision that reads back as the same value. Any decimal of
+    // up to 15 digits survives the trip through a double, so when the
+    // shortest form is that short, %.15g already yields it.
+    char buf[32];
+    int n = 0;
+    for (int precision = 15; precision <= 17; ++precision)
+    {
+      n = snprintf(buf, sizeof(buf), "%.*g", precision, value);
+      if (strtod(buf, NULL) == value)
+        break;
+    }
+    // snprintf and strtod follow LC_NUMERIC; the output is always C-style
+    for (int i = 0; i < n; ++i)
+    {
+      if (buf[i] == ',')
+        buf[i] = '.';
+    }
+    x_log_text_append(t, buf, (size_t) n);
+  }
+
+  static void x_log_kv_json_string(XLogText* t, const char* str)
+  {
+    static const char hex[] = "0123456789abcdef";
+    x_log_text_append(t, "\"", 1);
+    const char* run = str;
+    for (const char* p = str; *p; ++p)
+    {
+      unsigned char c = (unsigned char) *p;
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+      x_log_text_append(t, run, (size_t) (p - run));
+      run = p + 1;
+      char esc[6] = { '\\', (char) c, 0, 0, 0, 0 };
+      size_t esc_len = 2;
+      switch (c)
+      {
+        case '"': case '\\': break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        default:
+          esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+          esc[4] = hex[c >> 4]; esc[5] = hex[c & 15];
+          esc_len = 6;
+          break;
+      }
+      x_log_text_append(t, esc, esc_len);
+    }
+    x_log_text_append(t, run, strlen(run));
+    x_log_text_append(t, "\"", 1);
+  }
+
+  /* logfmt values are bare unless they are empty or hold spaces, quotes,
+     '=' or control characters */
+  static void x_log_kv_logfmt_string(XLogText* t, const char* str)
+  {
+    bool quote = *str == 0;
+    for (const char* p = str; *p && !quote; ++p)
+      quote = (unsigned char) *p <= ' ' || *p == '"' || *p == '=' || *p == '\\';
+    if (quote)
+      x_log_kv_json_string(t, str);
+    else
+      x_log_text_append(t, str, strlen(str));
+  }
+
+  static void x_log_kv_key(XLogText* t, const char* key, bool json, bool first)
+  {
+    if (json)
+    {
+      if (!first)
+        x_log_text_append(t, ",", 1);
+      x_log_kv_json_string(t, key);
+      x_log_text_append(t, ":", 1);
+    }
+    else
+    {
+      if (!first)
+        x_log_text_append(t, " ", 1);
+      x_log_text_append(t, key, strlen(key));
+      x_log_text_append(t, "=", 1);
+    }
+  }
+
+  static void x_log_kv_render(XLogText* t, XLogKVFormat format, int time_format, XLogLevel level, const char* file, int line, const char* msg, const XLogKV* fields, size_t count)
+  {
+    bool json = format != XLOG_KV_LOGFMT;
+    char date[48];
+    size_t date_len = x_log_format_date(date, x_log_wall_time_ns(), time_format | XLOG_TIME_ISO8601);
+
+    if (json)
+      x_log_text_append(t, "{", 1);
+    x_log_kv_key(t, "ts", json, true);
+    if (json) x_log_text_append(t, "\"", 1);
+    x_log_text_append(t, date, date_len);
+    if (json) x_log_text_append(t, "\"", 1);
+    x_log_kv_key(t, "level", json, false);
+    if (json) x_log_kv_json_string(t, x_log_level_strings[level]);
+    else x_log_text_append(t, x_log_level_strings[level], strlen(x_log_level_strings[level]));
+    x_log_kv_key(t, "msg", json, false);
+    if (json) x_log_kv_json_string(t, msg ? msg : "");
+    else x_log_kv_logfmt_string(t, msg ? msg : "");
+    x_log_kv_key(t, "file", json, false);
+    if (json) x_log_kv_json_string(t, file);
+    else x_log_kv_logfmt_string(t, file);
+    x_log_kv_key(t, "line", json, false);
+    x_log_kv_int(t, line);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const XLogKV* kv = &fields[i];
+      x_log_kv_key(t, kv->key ? kv->key : "", json, false);
+      switch (kv->type)
+      {
+        case XLOG_KV_INT:    x_log_kv_int(t, kv->value.i); break;
+        case XLOG_KV_UINT:   x_log_kv_uint(t, kv->value.u); break;
+        case XLOG_KV_DOUBLE: x_log_kv_double(t, kv->value.d, json); break;
+        case XLOG_KV_BOOL:
+          x_log_text_append(t, kv->value.i ? "true" : "false", kv->value.i ? 4 : 5);
+          break;
+        default:
+        {
+          const char* str = kv->value.s;
+          if (!str)
+            x_log_text_append(t, json ? "null" : "\"\"", json ? 4 : 2);
+          else if (json)
+            x_log_kv_json_string(t, str);
+          else
+            x_log_kv_logfmt_string(t, str);
+          break;
+        }
+      }
+    }
+
+    if (json)
+      x_log_text_append(t, "}", 1);
+    x_log_text_append(t, "\n", 1);
+  }
+
+  void logger_log_kv(XLogLevel level, const char* file, int line, const char* msg, const XLogKV* fields, size_t count)
+  {
+    if ((int32_t) level < x_atomic_load_i32(&x_log_level_threshold) || x_log_reentered())
+      return;
+
+    XLogger* logger;
+    XLogStripe* stripe = x_log_enter_logger(&logger);
+
+    XLogText text = { x_log_tls_line, 0, sizeof(x_log_tls_line), false };
+    x_log_kv_render(&text, logger->kv_format, logger->time_format, level, file, line, msg, fields, count);
+
+    XLogFlight* flight = (XLogFlight*) x_atomic_load_ptr((void* volatile*) &g_log_flight);
+    if (flight && (int32_t) level >= flight->level)
+      x_log_flight_text(flight, level, text.data, text.len);
+
+    XLogColor fg = x_log_level_color(level);
+    XLogColor bg = level == XLOG_LEVEL_FATAL ? XLOG_COLOR_RED : XLOG_COLOR_BLACK;
+    if ((int32_t) level >= x_atomic_load_i32(&g_log_output_level))
+    {
+      if (logger->async)
+        x_log_enqueue_text(logger->async, level, fg, bg, text.data, text.len);
+      else
+        x_log_emit(logger, level, fg, bg, text.data, text.len);
+    }
+
+    if (text.heap)
+      free(text.data);
+    x_log_leave(stripe);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Sinks
+  // ---------------------------------------------------------------------------
+
+  struct XLogSink_t
+  {
+    XLogSinkDesc desc;
+    XMutex* lock;
+  };
+
+  static void x_log_sink_deliver(XLogSink* sink, const XLogRecord* records, size_t count)
+  {
+    XLogRecord filtered[STDX_LOG_SINK_BATCH];
+    size_t m = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (records[i].level >= sink->desc.level)
+        filtered[m++] = records[i];
+    }
+    if (m == 0)
+      return;
+
+    // The caller's record may live in x_log_tls_line, so format elsewhere
+    char buf[STDX_LOG_LINE_SIZE];
+    XLogText text = { buf, 0, sizeof(buf), false };
+    if (sink->desc.format)
+    {
+      // Format the whole batch into one buffer first; it may move while growing
+      size_t offsets[STDX_LOG_SINK_BATCH];
+      for (size_t i = 0; i < m; ++i)
+      {
+        offsets[i] = text.len;
+        size_t room = text.cap - text.len - 1;
+        size_t n = sink->desc.format(sink->desc.user, &filtered[i], text.data + text.len, room);
+        if (n > room)
+        {
+          if (!x_log_text_reserve(&text, n))
+            n = 0;
+          else
+            n = sink->desc.format(sink->desc.user, &filtered[i], text.data + text.len, n);
+        }
+        text.len += n;
+        filtered[i].length = n;
+      }
+      for (size_t i = 0; i < m; ++i)
+        filtered[i].text = text.data + offsets[i];
+    }
+
+    x_thread_mutex_lock(sink->lock);
+    sink->desc.write(sink->desc.user, filtered, m);
+    x_thread_mutex_unlock(sink->lock);
+    if (text.heap)
+      free(text.data);
+  }
+
+  static void x_log_sinks_write(const XLogRecord* records, size_t count)
+  {
+    XLogStripe* stripe = x_log_enter();
+    XLogSinkSet* set = (XLogSinkSet*) x_atomic_load_ptr((void* volatile*) &g_log_sinks);
+    x_log_tls_in_sink = true;
+    for (size_t i = 0; set && i < set->count; ++i)
+      x_log_sink_deliver(set->sinks[i], records, count);
+    x_log_tls_in_sink = false;
+    x_log_leave(stripe);
+  }
+
+  /* Publish a copy of the sink set with `add` added or `remove` removed */
+  static void x_log_sinks_update(XLogSink* add, XLogSink* remove)
+  {
+    x_log_admin_lock();
+    XLogSinkSet* old = (XLogSinkSet*) x_atomic_load_ptr((void* volatile*) &g_log_sinks);
+    size_t count = old ? old->count : 0;
+    XLogSinkSet* set = malloc(sizeof(XLogSinkSet) + (count + 1) * sizeof(XLogSink*));
+    if (!set)
+    {
+      x_log_admin_unlock();
+      return;
+    }
+    set->count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (old->sinks[i] != remove)
+        set->sinks[set->count++] = old->sinks[i];
+    }
+    if (add)
+      set->sinks[set->count++] = add;
+    if (set->count == 0)
+    {
+      free(set);
+      set = NULL;
+    }
+    x_atomic_store_ptr((void* volatile*) &g_log_sinks, set);
+    x_log_admin_unlock();
+
+    x_log_quiesce();
+    free(old);
+  }
+
+  XLogSink* logger_add_sink(const XLogSinkDesc* desc)
+  {
+    if (!desc || !desc->write)
+      return NULL;
+    XLogSink* sink = calloc(1, sizeof(XLogSink));
+    if (!sink)
+      return NULL;
+    sink->desc = *desc;
+    x_thread_mutex_init(&sink->lock);
+    x_log_sinks_update(sink, NULL);
+    return sink;
+  }
+
+  void logger_remove_sink(XLogSink* sink)
+  {
+    if (!sink)
+      return;
+    x_log_sinks_update(NULL, sink);
+    if (sink->desc.close)
+      sink->desc.close(sink->desc.user);
+    x_thread_mutex_destroy(sink->lock);
+    free(sink);
+  }
+
+  typedef struct
+  {
+    XMutex* lock;
+    char* data;
+    size_t len;
+    size_t cap;
+  } XLogMemorySink;
+
+  static void x_log_memory_sink_write(void* user, const XLogRecord* records, size_t count)
+  {
+    XLogMemorySink* m = (XLogMemorySink*) user;
+    x_thread_mutex_lock(m->lock);
+    for (size_t i = 0; i < count; ++i)
+    {
+      const char* text = records[i].text;
+      size_t len = records[i].length;
+      if (len > m->cap)
+        continue;
+      if (m->len + len > m->cap)
+      {
+        // Drop the oldest records, at least half of the buffer, so the
+        // move is amortized
+        size_t drop = m->len + len - m->cap;
+        if (drop < m->cap / 2)
+          drop = m->cap / 2 < m->len ? m->cap / 2 : m->len;
+        const char* cut = drop < m->len ? memchr(m->data + drop, '\n', m->len - drop) : NULL;
+        drop = cut ? (size_t) (cut - m->data) + 1 : m->len;
+        memmove(m->data, m->data + drop, m->len - drop);
+        m->len -= drop;
+      }
+      memcpy(m->data + m->len, text, len);
+      m->len += len;
+    }
+    x_thread_mutex_unlock(m->lock);
+  }
+
+  static void x_log_memory_sink_close(void* user)
+  {
+    XLogMemorySink* m = (XLogMemorySink*) user;
+    x_thread_mutex_destroy(m->lock);
+    free(m->data);
+    free(m);
+  }
+
+  XLogSink* logger_add_memory_sink(XLogLevel level, size_t capacity)
+  {
+    XLogMemorySink* m = calloc(1, sizeof(XLogMemorySink));
+    if (!m)
+      return NULL;
+    m->cap = capacity ? capacity : 64 * 1024;
+    m->data = malloc(m->cap);
+    if (!m->data)
+    {
+      free(m);
+      return NULL;
+    }
+    x_thread_mutex_init(&m->lock);
+
+    XLogSinkDesc desc = { 0 };
+    desc.level = level;
+    desc.write = x_log_memory_sink_write;
+    desc.close = x_log_memory_sink_close;
+    desc.user = m;
+    XLogSink* sink = logger_add_sink(&desc);
+    if (!sink)
+      x_log_memory_sink_close(m);
+    return sink;
+  }
+
+  size_t logger_memory_sink_read(XLogSink* sink, char* dst, size_t cap)
+  {
+    if (!sink || sink->desc.write != x_log_memory_sink_write)
+      return 0;
+    XLogMemorySink* m = (XLogMemorySink*) sink->desc.user;
+    x_thread_mutex_lock(m->lock);
+    size_t len = m->len;
+    if (cap > 0)
+    {
+      size_t n = len < cap - 1 ? len : cap - 1;
+      memcpy(dst, m->data, n);
+      dst[n] = 0;
+    }
+    x_thread_mutex_unlock(m->lock);
+    return len;
+  }
+
+#ifndef _WIN32
+  typedef struct
+  {
+    int fd;
+    struct sockaddr_un addr;
+    char ident[64];
+  } XLogUnixSink;
+
+  static void x_log_unix_sink_write(void* user, const XLogRecord* records, size_t count)
+  {
+    XLogUnixSink* u = (XLogUnixSink*) user;
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t len = records[i].length;
+      // One datagram per record; receivers add their own line breaks
+      if (len && records[i].text[len - 1] == '\n')
+        len--;
+      sendto(u->fd, records[i].text, len, MSG_DONTWAIT, (const struct sockaddr*) &u->addr, sizeof(u->addr));
+    }
+  }
+
+  /* "<pri>ident: text", facility user */
+  static size_t x_log_unix_sink_format(void* user, const XLogRecord* record, char* dst, size_t cap)
+  {
+    static const int severity[] = { 7, 6, 4, 3, 2 };
+    XLogUnixSink* u = (XLogUnixSink*) user;
+    char header[96];
+    int n = snprintf(header, sizeof(header), "<%d>%s: ", 8 + severity[record->level], u->ident);
+    size_t len = (size_t) n + record->length;
+    if (len <= cap)
+    {
+      memcpy(dst, header, (size_t) n);
+      memcpy(dst + n, record->text, record->length);
+    }
+    return len;
+  }
+
+  static void x_log_unix_sink_close(void* user)
+  {
+    XLogUnixSink* u = (XLogUnixSink*) user;
+    close(u->fd);
+    free(u);
+  }
+
+  XLogSink* logger_add_unix_sink(XLogLevel level, const char* path, const char* ident)
+  {
+    if (!path || strlen(path) >= sizeof(((struct sockaddr_un*) 0)->sun_path))
+      return NULL;
+    XLogUnixSink* u = calloc(1, sizeof(XLogUnixSink));
+    if (!u)
+      return NULL;
+    u->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (u->fd < 0)
+    {
+      free(u);
+      return NULL;
+    }
+    u->addr.sun_family = AF_UNIX;
+    strcpy(u->addr.sun_path, path);
+    if (ident)
+      snprintf(u->ident, sizeof(u->ident), "%s", ident);
+
+    XLogSinkDesc desc = { 0 };
+    desc.level = level;
+    desc.write = x_log_unix_sink_write;
+    desc.format = ident ? x_log_unix_sink_format : NULL;
+    desc.close = x_log_unix_sink_close;
+    desc.user = u;
+    XLogSink* sink = logger_add_sink(&desc);
+    if (!sink)
+      x_log_unix_sink_close(u);
+    return sink;
+  }
+#endif
+
+  // ---------------------------------------------------------------------------
+  // Flight recorder control and dump
+  // ---------------------------------------------------------------------------
+
+  static void x_log_flight_free(XLogFlight* flight)
+  {
+    XLogFlightRing* ring = flight->rings;
+    while (ring)
+    {
+      XLogFlightRing* next = ring->next;
+      free(ring->entries);
+      free(ring);
+      ring = next;
+    }
+    free(flight);
+  }
+
+  bool logger_flight_enable(XLogLevel level, size_t records)
+  {
+    XLogFlight* flight = calloc(1, sizeof(XLogFlight));
+    if (!flight)
+      return false;
+    size_t count = 2;
+    while (count < records)
+      count *= 2;
+    flight->mask = (int64_t) count - 1;
+    flight->level = (int32_t) level;
+    flight->generation = x_atomic_add_i32(&g_log_flight_generation, 1) + 1;
+
+    x_log_admin_lock();
+    XLogFlight* old = (XLogFlight*) x_atomic_exchange_ptr((void* volatile*) &g_log_flight, flight);
+    x_log_update_threshold();
+    x_log_admin_unlock();
+    if (old)
+    {
+      x_log_quiesce();
+      x_log_flight_free(old);
+    }
+    return true;
+  }
+
+  void logger_flight_disable(void)
+  {
+    x_log_admin_lock();
+    XLogFlight* old = (XLogFlight*) x_atomic_exchange_ptr((void* volatile*) &g_log_flight, NULL);
+    x_log_update_threshold();
+    x_log_admin_unlock();
+    if (old)
+    {
+      x_log_quiesce();
+      x_log_flight_free(old);
+    }
+  }
+
+  /* Decimal without stdio, which is not async-signal-safe */
+  static size_t x_log_flight_itoa(char* dst, int64_t value)
+  {
+    char digits[24];
+    size_t n = 0;
+    do
+    {
+      digits[n++] = (char) ('0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < n; ++i)
+      dst[i] = digits[n - 1 - i];
+    return n;
+  }
+
+  static size_t x_log_flight_dump_ring(int fd, const XLogFlight* flight, XLogFlightRing* ring, bool self)
+  {
+    char line[STDX_LOG_FLIGHT_RECORD_SIZE + 1];
+    static const char title[] = "--- flight recorder, thread ";
+    size_t n = sizeof(title) - 1;
+    memcpy(line, title, n);
+    n += x_log_flight_itoa(line + n, x_atomic_load_i32(&ring->thread));
+    if (self)
+    {
+      memcpy(line + n, " (this thread)", 14);
+      n += 14;
+    }
+    else if (!x_atomic_load_i32(&ring->in_use))
+    {
+      memcpy(line + n, " (exited)", 9);
+      n += 9;
+    }
+    memcpy(line + n, " ---\n", 5);
+    x_log_fd_write(fd, line, n + 5);
+
+    size_t dumped = 0;
+    int64_t head = x_atomic_load_i64(&ring->head);
+    int64_t first = head > flight->mask + 1 ? head - flight->mask - 1 : 0;
+    int64_t owner_first = x_atomic_load_i64(&ring->first);
+    if (first < owner_first)
+      first = owner_first;
+    for (int64_t i = first; i < head; ++i)
+    {
+      XLogFlightEntry* entry = &ring->entries[i & flight->mask];
+      if (x_atomic_load_i64(&entry->seq) != i + 1)
+        continue;
+      size_t length = (size_t) entry->length;
+      if (length > sizeof(entry->text))
+        length = sizeof(entry->text);
+      memcpy(line, entry->text, length);
+      // The owner may have moved on while we copied; the fence keeps the
+      // copy from being ordered after the check
+      x_atomic_fence();
+      if (x_atomic_load_i64(&entry->seq) != i + 1)
+        continue;
+      if (length == 0 || line[length - 1] != '\n')
+        line[length++] = '\n';
+      x_log_fd_write(fd, line, length);
+      dumped++;
+    }
+    return dumped;
+  }
+
+  size_t logger_flight_dump(int fd)
+  {
+    XLogFlight* flight = (XLogFlight*) x_atomic_load_ptr((void* volatile*) &g_log_flight);
+    if (!flight)
+      return 0;
+
+    // The calling thread goes last, next to whatever the caller prints about the crash
+    XLogFlightRing* self = x_log_tls_flight_generation == flight->generation ? x_log_tls_flight_ring : NULL;
+    size_t dumped = 0;
+    for (XLogFlightRing* ring = (XLogFlightRing*) x_atomic_load_ptr((void* volatile*) &flight->rings); ring; ring = ring->next)
+    {
+      if (ring != self)
+        dumped += x_log_flight_dump_ring(fd, flight, ring, false);
+    }
+    if (self)
+      dumped += x_log_flight_dump_ring(fd, flight, self, true);
+    return dumped;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Categories
+  // ---------------------------------------------------------------------------
+
+  // Levels set by name, kept so categories registering later pick them up
+  typedef struct XLogCategoryLevel_t
+  {
+    struct XLogCategoryLevel_t* next;
+    int32_t level;
+    char name[];
+  } XLogCategoryLevel;
+
+  static XLogCategoryLevel* g_log_category_levels = NULL;   // Under the admin lock
+
+  static XLogCategoryLevel* x_log_category_find_level(const char* name)
+  {
+    for (XLogCategoryLevel* entry = g_log_category_levels; entry; entry = entry->next)
+    {
+      if (strcmp(entry->name, name) == 0)
+        return entry;
+    }
+    return NULL;
+  }
+
+  static int32_t x_log_category_register(XLogCategory* category)
+  {
+    x_log_admin_lock();
+    if (x_atomic_load_i32(&category->threshold) == X_LOG_UNREGISTERED)
+    {
+      XLogCategoryLevel* entry = x_log_category_find_level(category->name);
+      if (entry)
+        x_atomic_store_i32(&category->level, entry->level);
+      category->next = g_log_categories;
+      g_log_categories = category;
+      x_atomic_store_i32(&category->threshold, x_log_threshold_for(category));
+    }
+    int32_t threshold = x_atomic_load_i32(&category->threshold);
+    x_log_admin_unlock();
+    return threshold;
+  }
+
+  void logger_log_category(XLogCategory* category, XLogLevel level, const char* file, int line, const char* func, const char* fmt, ...)
+  {
+    int32_t threshold = x_atomic_load_i32(&category->threshold);
+    if (threshold == X_LOG_UNREGISTERED)
+      threshold = x_log_category_register(category);
+    if ((int32_t) level < threshold)
+      return;
+
+    va_list args;
+    va_start(args, fmt);
+    x_log_vlog(category, level, x_log_level_color(level), level == XLOG_LEVEL_FATAL ? XLOG_COLOR_RED : XLOG_COLOR_BLACK,
+        XLOG_DEFAULT, file, line, func, fmt, args);
+    va_end(args);
+  }
+
+  void logger_category_set_level(const char* name, int level)
+  {
+    if (!name)
+      return;
+    x_log_admin_lock();
+    XLogCategoryLevel* entry = x_log_category_find_level(name);
+    if (!entry)
+    {
+      size_t len = strlen(name);
+      entry = malloc(sizeof(XLogCategoryLevel) + len + 1);
+      if (entry)
+      {
+        memcpy(entry->name, name, len + 1);
+        entry->next = g_log_category_levels;
+        g_log_category_levels = entry;
+      }
+    }
+    if (entry)
+      entry->level = (int32_t) level;
+
+    for (XLogCategory* category = g_log_categories; category; category = category->next)
+    {
+      if (strcmp(category->name, name) == 0)
+      {
+        x_atomic_store_i32(&category->level, (int32_t) level);
+        x_atomic_store_i32(&category->threshold, x_log_threshold_for(category));
+      }
+    }
+    x_log_admin_unlock();
+  }
+
+  XLogLevel logger_category_get_level(const char* name)
+  {
+    x_log_admin_lock();
+    XLogCategoryLevel* entry = name ? x_log_category_find_level(name) : NULL;
+    int32_t level = entry ? entry->level : X_LOG_LEVEL_INHERIT;
+    if (level == X_LOG_LEVEL_INHERIT)
+      level = x_atomic_load_i32(&g_log_output_level);
+    x_log_admin_unlock();
+    return (XLogLevel) level;
+  }
+
+#endif //STDX_IMPLEMENTATION_LOG
+
+#ifdef STDX_INTERNAL_THREAD_IMPLEMENTATION
+#undef STDX_IMPLEMENTATION_THREAD
+#undef STDX_INTERNAL_THREAD_IMPLEMENTATION
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,540 @@
+/*
+ * STDX - Safe Memory Reclamation
+ * Part of the STDX General Purpose C Library by marciovmf
+ * https://github.com/marciovmf/stdx
+ *
+ * Deferred freeing for lock-free data structures, where a node unlinked by
+ * one thread may still be read by another:
+ *   - Epoch-based reclamation (EBR): readers enter and leave cheap critical
+ *     sections; retired objects sit in per-thread limbo lists and are freed
+ *     in batches once every thread has moved past the epoch they were
+ *     retired in.
+ *   - Hazard pointers: readers publish the exact pointers they use, so a
+ *     stalled or long-running reader only holds back those objects instead
+ *     of every retirement, at the cost of a fence per protected load.
+ *
+ * Both schemes use per-thread records obtained by registering with a domain.
+ * A record must only be used by the thread that registered it.
+ *
+ * To compile the implementation, define:
+ *     #define STDX_IMPLEMENTATION_RECLAIM
+ * in **one** source file before including this header.
+ *
+ * Author: marciovmf
+ * License: MIT
+ * Dependencies: stdx_thread.h (atomics only)
+ * Usage: #include "stdx_reclaim.h"
+ */
+
+#ifndef STDX_RECLAIM_H
+#define STDX_RECLAIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STDX_RECLAIM_VERSION_MAJOR 1
+#define STDX_RECLAIM_VERSION_MINOR 0
+#define STDX_RECLAIM_VERSION_PATCH 0
+
+#define STDX_RECLAIM_VERSION (STDX_RECLAIM_VERSION_MAJOR * 10000 + STDX_RECLAIM_VERSION_MINOR * 100 + STDX_RECLAIM_VERSION_PATCH)
+
+#include <stdx_thread.h>
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef STDX_EBR_RECLAIM_BATCH
+#define STDX_EBR_RECLAIM_BATCH 64
+#endif
+
+#ifndef STDX_HAZARD_SLOTS
+#define STDX_HAZARD_SLOTS 4
+#endif
+
+  /// Called when a retired object is safe to free. A NULL function frees the
+  /// object with free().
+  typedef void (*XReclaim_fn)(void* ptr, void* ctx);
+
+  typedef struct XEbr_t XEbr;
+  typedef struct XEbrThread_t XEbrThread;
+  typedef struct XHazardDomain_t XHazardDomain;
+  typedef struct XHazardThread_t XHazardThread;
+
+  // ---------------------------------------------------------------------------
+  // Epoch-based reclamation
+  // ---------------------------------------------------------------------------
+
+  XEbr* x_ebr_create(void);
+
+  /// Frees every object still retired. No thread may be inside a critical
+  /// section or use its record afterwards.
+  void  x_ebr_destroy(XEbr* ebr);
+
+  /// Get a record for the calling thread. Records of unregistered threads
+  /// are reused, together with anything they still had retired.
+  XEbrThread* x_ebr_register(XEbr* ebr);
+  void  x_ebr_unregister(XEbrThread* thread);
+
+  /// Critical sections may nest. Pointers read from a shared structure are
+  /// valid until the outermost leave.
+  void  x_ebr_enter(XEbrThread* thread);
+  void  x_ebr_leave(XEbrThread* thread);
+
+  /// Defer reclaim(ptr, ctx) until no thread can still hold `ptr`. Call after
+  /// `ptr` was unlinked. Every STDX_EBR_RECLAIM_BATCH retirements trigger
+  /// x_ebr_reclaim on the calling thread. Returns false, leaving `ptr` to the
+  /// caller, if the limbo list could not grow.
+  bool  x_ebr_retire(XEbrThread* thread, void* ptr, XReclaim_fn reclaim, void* ctx);
+
+  /// Try to advance the global epoch and free this thread's retired objects
+  /// that became safe. Returns how many were freed.
+  size_t x_ebr_reclaim(XEbrThread* thread);
+
+  /// Objects retired by this thread and not freed yet.
+  size_t x_ebr_pending(XEbrThread* thread);
+
+  // ---------------------------------------------------------------------------
+  // Hazard pointers
+  // ---------------------------------------------------------------------------
+
+  XHazardDomain* x_hazard_create(void);
+
+  /// Frees every object still retired. No thread may use its record
+  /// afterwards.
+  void  x_hazard_destroy(XHazardDomain* domain);
+
+  XHazardThread* x_hazard_register(XHazardDomain* domain);
+
+  /// Clears the record's hazards. Retired objects stay with the record and
+  /// are scanned by its next owner or freed by x_hazard_destroy.
+  void  x_hazard_unregister(XHazardThread* thread);
+
+  /// Load `*source` and protect it in `slot` (0..STDX_HAZARD_SLOTS-1). The
+  /// returned pointer stays valid until the slot is cleared or reused.
+  void* x_hazard_protect(XHazardThread* thread, int slot, void* volatile* source);
+
+  /// Protect a pointer the caller already validated some other way.
+  void  x_hazard_set(XHazardThread* thread, int slot, void* ptr);
+  void  x_hazard_clear(XHazardThread* thread, int slot);
+
+  /// Defer reclaim(ptr, ctx) until no hazard points at `ptr`. A scan runs
+  /// once enough objects are retired to amortize it. Returns false, leaving
+  /// `ptr` to the caller, if the retired list could not grow.
+  bool  x_hazard_retire(XHazardThread* thread, void* ptr, XReclaim_fn reclaim, void* ctx);
+
+  /// Free this thread's retired objects that no hazard points at. Returns
+  /// how many were freed.
+  size_t x_hazard_scan(XHazardThread* thread);
+
+  size_t x_hazard_pending(XHazardThread* thread);
+
+#ifdef STDX_IMPLEMENTATION_RECLAIM
+
+#include <stdlib.h>
+#include <string.h>
+
+  typedef struct
+  {
+    void* ptr;
+    XReclaim_fn reclaim;
+    void* ctx;
+  } XRetired;
+
+  typedef struct
+  {
+    XRetired* items;
+    size_t count;
+    size_t capacity;
+  } XRetiredList;
+
+  static bool x_retired_push(XRetiredList* list, void* ptr, XReclaim_fn reclaim, void* ctx)
+  {
+    if (list->count == list->capacity)
+    {
+      size_t capacity = list->capacity ? list->capacity * 2 : 64;
+      XRetired* items = realloc(list->items, capacity * sizeof(XRetired));
+      if (!items)
+        return false;
+      list->items = items;
+      list->capacity = capacity;
+    }
+    list->items[list->count].ptr = ptr;
+    list->items[list->count].reclaim = reclaim;
+    list->items[list->count].ctx = ctx;
+    list->count++;
+    return true;
+  }
+
+  static inline void x_retired_free(XRetired* r)
+  {
+    if (r->reclaim)
+      r->reclaim(r->ptr, r->ctx);
+    else
+      free(r->ptr);
+  }
+
+  static size_t x_retired_free_all(XRetiredList* list)
+  {
+    size_t freed = list->count;
+    for (size_t i = 0; i < list->count; ++i)
+      x_retired_free(&list->items[i]);
+    list->count = 0;
+    return freed;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Epoch-based reclamation
+  // ---------------------------------------------------------------------------
+  //
+  // The global epoch only advances when every thread inside a critical
+  // section has observed the current one. An object retired in epoch e can
+  // therefore only be referenced by readers that entered in e or e - 1, and
+  // is safe once the global epoch reaches e + 2. Each thread keeps three
+  // limbo lists, one per epoch modulo 3.
+
+#define X_EBR_ACTIVE 1ll   // Low bit of XEbrThread::state, epoch in the rest
+
+  struct XEbrThread_t
+  {
+    volatile int64_t state;         // (epoch << 1) | active, 0 when outside
+    char pad0[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+
+    XEbr* ebr;
+    XEbrThread* next;
+    volatile int32_t in_use;
+    int32_t depth;
+    int64_t limbo_epoch[3];
+    XRetiredList limbo[3];
+    size_t since_reclaim;
+  };
+
+  struct XEbr_t
+  {
+    volatile int64_t epoch;
+    char pad0[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+    XEbrThread* volatile threads;   // Push-only list, records are reused
+  };
+
+  XEbr* x_ebr_create(void)
+  {
+    XEbr* ebr = calloc(1, sizeof(XEbr));
+    if (ebr)
+      ebr->epoch = 2; // Keeps e - 2 of the first epochs non-negative
+    return ebr;
+  }
+
+  void x_ebr_destroy(XEbr* ebr)
+  {
+    if (!ebr) return;
+    XEbrThread* t = ebr->threads;
+    while (t)
+    {
+      XEbrThread* next = t->next;
+      for (int i = 0; i < 3; ++i)
+      {
+        x_retired_free_all(&t->limbo[i]);
+        free(t->limbo[i].items);
+      }
+      free(t);
+      t = next;
+    }
+    free(ebr);
+  }
+
+  XEbrThread* x_ebr_register(XEbr* ebr)
+  {
+    if (!ebr) return NULL;
+
+    for (XEbrThread* t = (XEbrThread*) x_atomic_load_ptr((void* volatile*) &ebr->threads); t; t = t->next)
+    {
+      int32_t expected = 0;
+      if (x_atomic_load_i32(&t->in_use) == 0 && x_atomic_cas_i32(&t->in_use, &expected, 1))
+        return t;
+    }
+
+    XEbrThread* t = calloc(1, sizeof(XEbrThread));
+    if (!t) return NULL;
+    t->ebr = ebr;
+    t->in_use = 1;
+
+    void* head = x_atomic_load_ptr((void* volatile*) &ebr->threads);
+    do
+    {
+      t->next = (XEbrThread*) head;
+    } while (!x_atomic_cas_ptr((void* volatile*) &ebr->threads, &head, t));
+    return t;
+  }
+
+  void x_ebr_unregister(XEbrThread* thread)
+  {
+    if (!thread) return;
+    thread->depth = 0;
+    x_atomic_store_i64(&thread->state, 0);
+    x_ebr_reclaim(thread);
+    x_atomic_store_i32(&thread->in_use, 0);
+  }
+
+  void x_ebr_enter(XEbrThread* thread)
+  {
+    if (thread->depth++ > 0)
+      return;
+
+    int64_t epoch = x_atomic_load_i64(&thread->ebr->epoch);
+    x_atomic_store_i64(&thread->state, (epoch << 1) | X_EBR_ACTIVE);
+    // Announce before reading any shared pointer
+    x_atomic_fence();
+  }
+
+  void x_ebr_leave(XEbrThread* thread)
+  {
+    if (--thread->depth > 0)
+      return;
+    x_atomic_store_i64(&thread->state, 0);
+  }
+
+  static bool x_ebr_try_advance(XEbr* ebr, int64_t epoch)
+  {
+    x_atomic_fence();
+    for (XEbrThread* t = (XEbrThread*) x_atomic_load_ptr((void* volatile*) &ebr->threads); t; t = t->next)
+    {
+      int64_t state = x_atomic_load_i64(&t->state);
+      if ((state & X_EBR_ACTIVE) && (state >> 1) != epoch)
+        return false; // Someone is still reading in an older epoch
+    }
+    return x_atomic_cas_i64(&ebr->epoch, &epoch, epoch + 1);
+  }
+
+  size_t x_ebr_reclaim(XEbrThread* thread)
+  {
+    XEbr* ebr = thread->ebr;
+    int64_t epoch = x_atomic_load_i64(&ebr->epoch);
+    if (x_ebr_try_advance(ebr, epoch))
+      epoch++;
+
+    size_t freed = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+      if (thread->limbo[i].count && thread->limbo_epoch[i] <= epoch - 2)
+        freed += x_retired_free_all(&thread->limbo[i]);
+    }
+    thread->since_reclaim = 0;
+    return freed;
+  }
+
+  bool x_ebr_retire(XEbrThread* thread, void* ptr, XReclaim_fn reclaim, void* ctx)
+  {
+    if (!ptr) return true;
+
+    int64_t epoch = x_atomic_load_i64(&thread->ebr->epoch);
+    int slot = (int)(epoch % 3);
+
+    // The slot still holds objects from three epochs ago; those are safe now
+    if (thread->limbo[slot].count && thread->limbo_epoch[slot] != epoch)
+      x_retired_free_all(&thread->limbo[slot]);
+    thread->limbo_epoch[slot] = epoch;
+
+    if (!x_retired_push(&thread->limbo[slot], ptr, reclaim, ctx))
+      return false;
+
+    if (++thread->since_reclaim >= STDX_EBR_RECLAIM_BATCH)
+      x_ebr_reclaim(thread);
+    return true;
+  }
+
+  size_t x_ebr_pending(XEbrThread* thread)
+  {
+    return thread->limbo[0].count + thread->limbo[1].count + thread->limbo[2].count;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Hazard pointers
+  // ---------------------------------------------------------------------------
+
+  struct XHazardThread_t
+  {
+    void* volatile hazards[STDX_HAZARD_SLOTS];
+    char pad0[X_CACHE_LINE_SIZE];
+
+    XHazardDomain* domain;
+    XHazardThread* next;
+    volatile int32_t in_use;
+    XRetiredList retired;
+    void** scratch;
+    size_t scratch_capacity;
+  };
+
+  struct XHazardDomain_t
+  {
+    XHazardThread* volatile threads;  // Push-only list, records are reused
+    volatile int32_t num_threads;
+  };
+
+  XHazardDomain* x_hazard_create(void)
+  {
+    return calloc(1, sizeof(XHazardDomain));
+  }
+
+  void x_hazard_destroy(XHazardDomain* domain)
+  {
+    if (!domain) return;
+    XHazardThread* t = domain->threads;
+    while (t)
+    {
+      XHazardThread* next = t->next;
+      x_retired_free_all(&t->retired);
+      free(t->retired.items);
+      free(t->scratch);
+      free(t);
+      t = next;
+    }
+    free(domain);
+  }
+
+  XHazardThread* x_hazard_register(XHazardDomain* domain)
+  {
+    if (!domain) return NULL;
+
+    for (XHazardThread* t = (XHazardThread*) x_atomic_load_ptr((void* volatile*) &domain->threads); t; t = t->next)
+    {
+      int32_t expected = 0;
+      if (x_atomic_load_i32(&t->in_use) == 0 && x_atomic_cas_i32(&t->in_use, &expected, 1))
+        return t;
+    }
+
+    XHazardThread* t = calloc(1, sizeof(XHazardThread));
+    if (!t) return NULL;
+    t->domain = domain;
+    t->in_use = 1;
+
+    void* head = x_atomic_load_ptr((void* volatile*) &domain->threads);
+    do
+    {
+      t->next = (XHazardThread*) head;
+    } while (!x_atomic_cas_ptr((void* volatile*) &domain->threads, &head, t));
+    x_atomic_add_i32(&domain->num_threads, 1);
+    return t;
+  }
+
+  void x_hazard_unregister(XHazardThread* thread)
+  {
+    if (!thread) return;
+    for (int i = 0; i < STDX_HAZARD_SLOTS; ++i)
+      x_atomic_store_ptr(&thread->hazards[i], NULL);
+    x_hazard_scan(thread);
+    x_atomic_store_i32(&thread->in_use, 0);
+  }
+
+  void* x_hazard_protect(XHazardThread* thread, int slot, void* volatile* source)
+  {
+    void* ptr = x_atomic_load_ptr(source);
+    while (1)
+    {
+      x_atomic_store_ptr(&thread->hazards[slot], ptr);
+      // The hazard must be visible before we confirm the pointer is still
+      // published, or a concurrent scan could miss it.
+      x_atomic_fence();
+      void* again = x_atomic_load_ptr(source);
+      if (again == ptr)
+        return ptr;
+      ptr = again;
+    }
+  }
+
+  void x_hazard_set(XHazardThread* thread, int slot, void* ptr)
+  {
+    x_atomic_store_ptr(&thread->hazards[slot], ptr);
+    x_atomic_fence();
+  }
+
+  void x_hazard_clear(XHazardThread* thread, int slot)
+  {
+    x_atomic_store_ptr(&thread->hazards[slot], NULL);
+  }
+
+  static int x_hazard_compare(const void* a, const void* b)
+  {
+    uintptr_t pa = (uintptr_t) *(void* const*) a;
+    uintptr_t pb = (uintptr_t) *(void* const*) b;
+    return pa < pb ? -1 : pa > pb;
+  }
+
+  size_t x_hazard_scan(XHazardThread* thread)
+  {
+    if (thread->retired.count == 0)
+      return 0;
+
+    XHazardDomain* domain = thread->domain;
+
+    // Pairs with the fence in x_hazard_protect: objects were unlinked before
+    // this point, so any reader that still reaches one has published it.
+    x_atomic_fence();
+
+    size_t count = 0;
+    for (XHazardThread* t = (XHazardThread*) x_atomic_load_ptr((void* volatile*) &domain->threads); t; t = t->next)
+    {
+      if (count + STDX_HAZARD_SLOTS > thread->scratch_capacity)
+      {
+        size_t capacity = thread->scratch_capacity ? thread->scratch_capacity * 2 : 16 * STDX_HAZARD_SLOTS;
+        void** scratch = realloc(thread->scratch, capacity * sizeof(void*));
+        if (!scratch)
+          return 0; // Can't prove anything safe
+        thread->scratch = scratch;
+        thread->scratch_capacity = capacity;
+      }
+
+      for (int i = 0; i < STDX_HAZARD_SLOTS; ++i)
+      {
+        void* hazard = x_atomic_load_ptr(&t->hazards[i]);
+        if (hazard)
+          thread->scratch[count++] = hazard;
+      }
+    }
+    qsort(thread->scratch, count, sizeof(void*), x_hazard_compare);
+
+    size_t kept = 0;
+    size_t freed = 0;
+    for (size_t i = 0; i < thread->retired.count; ++i)
+    {
+      XRetired* r = &thread->retired.items[i];
+      if (count && bsearch(&r->ptr, thread->scratch, count, sizeof(void*), x_hazard_compare))
+      {
+        thread->retired.items[kept++] = *r;
+        continue;
+      }
+      x_retired_free(r);
+      freed++;
+    }
+    thread->retired.count = kept;
+    return freed;
+  }
+
+  bool x_hazard_retire(XHazardThread* thread, void* ptr, XReclaim_fn reclaim, void* ctx)
+  {
+    if (!ptr) return true;
+
+    if (!x_retired_push(&thread->retired, ptr, reclaim, ctx))
+      return false;
+
+    // Scanning costs O(H log H) for H hazards; doing it every 2H retirements
+    // keeps it constant per object while bounding the garbage to O(H).
+    size_t threshold = (size_t) x_atomic_load_i32(&thread->domain->num_threads) * STDX_HAZARD_SLOTS * 2;
+    if (threshold < STDX_EBR_RECLAIM_BATCH)
+      threshold = STDX_EBR_RECLAIM_BATCH;
+    if (thread->retired.count >= threshold)
+      x_hazard_scan(thread);
+    return true;
+  }
+
+  size_t x_hazard_pending(XHazardThread* thread)
+  {
+    return thread->retired.count;
+  }
+
+#endif // STDX_IMPLEMENTATION_RECLAIM
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STDX_RECLAIM_H
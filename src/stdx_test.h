@@ -7,7 +7,8 @@
  *   - Lightweight, self-contained C test runner
  *   - Colored PASS/FAIL output using x_log
  *   - Assertion macros for booleans, equality, floats
- *   - Signal handling for crash diagnostics (SIGSEGV, SIGABRT, etc.)
+ *   - Signal handling for crash diagnostics (SIGSEGV, SIGABRT, etc.), with a
+ *     dump of the log flight recorder when a test enabled it
  *
  * Usage:
  *   - Define your test functions to return int (0 for pass, 1 for fail)
@@ -116,11 +117,29 @@ typedef struct
 #ifdef STDX_IMPLEMENTATION_TEST
 
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
-static void x_test_internalOnSignal(int signal)
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Only write(2) is safe here; stdio and the logger may hold locks */
+static void x_test_internalWriteStderr(const char* text)
+{
+#ifdef _WIN32
+  _write(2, text, (unsigned int) strlen(text));
+#else
+  ssize_t ignored = write(2, text, strlen(text));
+  (void) ignored;
+#endif
+}
+
+static void x_test_internalOnSignal(int signum)
 {
   const char* signalName = "Unknown signal";
-  switch(signal)
+  switch(signum)
   {
     case SIGABRT: signalName = (const char*) "SIGABRT"; break;
     case SIGFPE:  signalName = (const char*) "SIGFPE"; break;
@@ -130,9 +149,15 @@ static void x_test_internalOnSignal(int signal)
     case SIGTERM: signalName = (const char*) "SIGTERM"; break;
   }
 
-  fflush(stderr);
-  fflush(stdout);
-  x_log_error("\n[!!!!]  Test Crashed! %s", signalName);
+  // The last records of every thread, if the test enabled the flight recorder
+  logger_flight_dump(2);
+  x_test_internalWriteStderr("\n[!!!!]  Test Crashed! ");
+  x_test_internalWriteStderr(signalName);
+  x_test_internalWriteStderr("\n");
+
+  // Let the default action end the process, instead of returning into the fault
+  signal(signum, SIG_DFL);
+  raise(signum);
 }
 
 int stdx_run_tests(STDXTestCase* tests, unsigned int num_tests)
@@ -4,10 +4,19 @@
  * https://github.com/marciovmf/stdx
  *
  * Provides a portable threading abstraction for C programs. Includes:
- *   - Thread creation and joining
+ *   - Thread creation and joining, with stack size, name, priority and
+ *     CPU affinity attributes
+ *   - CPU and NUMA node discovery
  *   - Mutexes and condition variables
+ *   - Semaphores, barriers, latches and auto-reset events
  *   - Sleep/yield utilities
- *   - A thread pool for concurrent task execution
+ *   - Bounded lock-free MPMC queue and wait-free SPSC ring
+ *   - A thread pool for concurrent task execution, with cancellation
+ *     tokens, task deadlines and graceful drain on shutdown
+ *   - Task groups whose waiter helps run pool tasks (nested parallelism)
+ *   - Delayed and periodic pool tasks driven by a timing wheel
+ *   - Task graphs with dependency edges executed on a thread pool
+ *   - Portable atomic operations
  *
  * Designed to abstract platform-specific APIs (e.g., pthreads, Win32)
  * behind a consistent and lightweight interface.
@@ -30,17 +39,34 @@ extern "C" {
 #endif
 
 #define STDX_THREADING_VERSION_MAJOR 1
-#define STDX_THREADING_VERSION_MINOR 0
+#define STDX_THREADING_VERSION_MINOR 1
 #define STDX_THREADING_VERSION_PATCH 0
 
 #define STDX_THREADING_VERSION (STDX_THREADING_VERSION_MAJOR * 10000 + STDX_THREADING_VERSION_MINOR * 100 + STDX_THREADING_VERSION_PATCH)
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
   typedef struct XXThread XThread;
   typedef struct XXMutex XMutex;
   typedef struct XXCondVar XCondVar;
+  typedef struct XXSemaphore XSemaphore;
+  typedef struct XXBarrier XBarrier;
+  typedef struct XXLatch XLatch;
+  typedef struct XXEvent XEvent;
   typedef struct XThreadPool_t XThreadPool;
   typedef struct XTask_t XTask;
+  typedef struct XTaskGraph_t XTaskGraph;
+  typedef struct XTaskGroup_t XTaskGroup;
+  typedef struct XCancelToken_t XCancelToken;
+  typedef struct XMpmcQueue_t XMpmcQueue;
+  typedef struct XSpscQueue_t XSpscQueue;
+  typedef uint64_t XTimerId;
   typedef void (*XThreadTask_fn)(void* arg);
   typedef void* (*x_thread_func_t)(void*);
 
@@ -52,6 +78,79 @@ extern "C" {
   void  x_thread_join(XThread* t);
   void  x_thread_destroy(XThread* t);
 
+  // ---------------------------------------------------------------------------
+  // Thread attributes and CPU topology
+  // ---------------------------------------------------------------------------
+
+#define X_THREAD_MAX_CPUS 1024
+
+  typedef struct
+  {
+    uint64_t bits[X_THREAD_MAX_CPUS / 64];
+  } XCpuSet;
+
+  typedef enum
+  {
+    X_THREAD_PRIORITY_LOWEST  = -2,
+    X_THREAD_PRIORITY_LOW     = -1,
+    X_THREAD_PRIORITY_NORMAL  =  0,
+    X_THREAD_PRIORITY_HIGH    =  1,
+    X_THREAD_PRIORITY_HIGHEST =  2
+  } XThreadPriority;
+
+  /// Attributes for x_thread_create_ex. Zero initialize and set what you need:
+  /// a zero stack size keeps the platform default, a NULL name leaves the
+  /// thread unnamed and an empty affinity set leaves it free to run anywhere.
+  typedef struct
+  {
+    size_t stack_size;
+    const char* name;           // Truncated to 15 characters on Linux
+    XThreadPriority priority;   // Raising it may need privileges; best effort
+    XCpuSet affinity;
+  } XThreadAttr;
+
+  int   x_thread_create_ex(XThread** t, const XThreadAttr* attr, x_thread_func_t func, void* arg);
+
+  /// Apply attributes to the calling thread. Return 0 on success, -1 if the
+  /// platform does not support it or refused.
+  int   x_thread_set_name(const char* name);
+  int   x_thread_set_priority(XThreadPriority priority);
+  int   x_thread_set_affinity(const XCpuSet* cpus);
+
+  /// CPUs the calling thread is allowed to run on, which may be fewer than
+  /// x_thread_cpu_count() under taskset or a cgroup cpuset. Return 0 on
+  /// success, -1 if the platform cannot tell.
+  int   x_thread_get_affinity(XCpuSet* cpus);
+
+  /// Number of online CPUs.
+  int   x_thread_cpu_count(void);
+
+  /// Fill `nodes` with the CPUs of each NUMA node that has any, up to
+  /// `max_nodes`. Returns the number of nodes found, 0 if the topology is
+  /// unknown on this platform.
+  int   x_thread_numa_nodes(XCpuSet* nodes, int max_nodes);
+
+  static inline void x_cpuset_zero(XCpuSet* set) { for (int i = 0; i < X_THREAD_MAX_CPUS / 64; ++i) set->bits[i] = 0; }
+  static inline void x_cpuset_add(XCpuSet* set, int cpu) { if (cpu >= 0 && cpu < X_THREAD_MAX_CPUS) set->bits[cpu / 64] |= 1ull << (cpu % 64); }
+  static inline bool x_cpuset_has(const XCpuSet* set, int cpu) { return cpu >= 0 && cpu < X_THREAD_MAX_CPUS && (set->bits[cpu / 64] >> (cpu % 64)) & 1; }
+
+  static inline int x_cpuset_count(const XCpuSet* set)
+  {
+    int count = 0;
+    for (int i = 0; i < X_THREAD_MAX_CPUS; ++i)
+      count += x_cpuset_has(set, i);
+    return count;
+  }
+
+  /// The n-th CPU (0 based) in the set, or -1.
+  static inline int x_cpuset_nth(const XCpuSet* set, int n)
+  {
+    for (int i = 0; i < X_THREAD_MAX_CPUS; ++i)
+      if (x_cpuset_has(set, i) && n-- == 0)
+        return i;
+    return -1;
+  }
+
   // ---------------------------------------------------------------------------
   // Thread Synchronization
   // ---------------------------------------------------------------------------
@@ -65,24 +164,401 @@ extern "C" {
   void  x_thread_condvar_signal(XCondVar* cv);
   void  x_thread_condvar_broadcast(XCondVar* cv);
   void  x_thread_condvar_destroy(XCondVar* cv);
+
+  /// Wait at most `ms` milliseconds. Returns false on timeout.
+  bool  x_thread_condvar_wait_timeout(XCondVar* cv, XMutex* m, int ms);
+
   void  x_thread_sleep_ms(int ms);
   void  x_thread_yield();
 
+  /// Monotonic clock in nanoseconds.
+  uint64_t x_thread_time_ns(void);
+
+  // ---------------------------------------------------------------------------
+  // Semaphores, barriers, latches and events
+  // ---------------------------------------------------------------------------
+  //
+  // All of them take an uncontended fast path on atomics, spin briefly, and
+  // only then park on a condition variable. Wakeups are targeted: a post or
+  // set wakes as many waiters as it can satisfy, never all of them.
+
+  /// Counting semaphore.
+  int   x_thread_semaphore_init(XSemaphore** s, int initial);
+  void  x_thread_semaphore_wait(XSemaphore* s);
+  bool  x_thread_semaphore_try_wait(XSemaphore* s);
+  bool  x_thread_semaphore_wait_timeout(XSemaphore* s, int ms);
+  void  x_thread_semaphore_post(XSemaphore* s, int count);
+  void  x_thread_semaphore_destroy(XSemaphore* s);
+
+  /// Reusable barrier for `count` threads. x_thread_barrier_wait returns true
+  /// in exactly one thread per phase.
+  int   x_thread_barrier_init(XBarrier** b, int count);
+  bool  x_thread_barrier_wait(XBarrier* b);
+  void  x_thread_barrier_destroy(XBarrier* b);
+
+  /// Single-use countdown latch. Waiters are released when it reaches zero.
+  int   x_thread_latch_init(XLatch** l, int count);
+  void  x_thread_latch_count_down(XLatch* l, int n);
+  bool  x_thread_latch_try_wait(XLatch* l);
+  void  x_thread_latch_wait(XLatch* l);
+  void  x_thread_latch_destroy(XLatch* l);
+
+  /// Auto-reset event: each set releases a single waiter, or the next thread
+  /// to wait if nobody is waiting yet.
+  int   x_thread_event_init(XEvent** e, bool signaled);
+  void  x_thread_event_set(XEvent* e);
+  void  x_thread_event_wait(XEvent* e);
+  bool  x_thread_event_wait_timeout(XEvent* e, int ms);
+  void  x_thread_event_destroy(XEvent* e);
+
+  // ---------------------------------------------------------------------------
+  // Bounded MPMC queue
+  // ---------------------------------------------------------------------------
+
+  /// Create a lock-free multi-producer/multi-consumer queue of fixed-size
+  /// elements. Capacity is rounded up to a power of two.
+  XMpmcQueue* x_mpmc_create(size_t element_size, size_t capacity);
+  void  x_mpmc_destroy(XMpmcQueue* q);
+
+  /// Copy `item` into the queue. Returns false if the queue is full.
+  bool  x_mpmc_try_push(XMpmcQueue* q, const void* item);
+
+  /// Copy the oldest element into `out`. Returns false if the queue is empty.
+  bool  x_mpmc_try_pop(XMpmcQueue* q, void* out);
+
+  /// Blocking variants. They spin briefly, then park on a condition variable.
+  void  x_mpmc_push(XMpmcQueue* q, const void* item);
+  void  x_mpmc_pop(XMpmcQueue* q, void* out);
+
+  /// Approximate number of queued elements.
+  size_t x_mpmc_count(XMpmcQueue* q);
+  size_t x_mpmc_capacity(XMpmcQueue* q);
+
+  // ---------------------------------------------------------------------------
+  // SPSC ring
+  // ---------------------------------------------------------------------------
+
+  /// Create a wait-free single-producer/single-consumer ring. Capacity is
+  /// rounded up to a power of two. Pass `blocking` to enable the wait
+  /// functions; a non-blocking ring never touches a lock.
+  XSpscQueue* x_spsc_create(size_t element_size, size_t capacity, bool blocking);
+  void  x_spsc_destroy(XSpscQueue* q);
+
+  bool  x_spsc_try_push(XSpscQueue* q, const void* item);
+  bool  x_spsc_try_pop(XSpscQueue* q, void* out);
+
+  /// Zero-copy batches. *_begin returns how many contiguous elements can be
+  /// written/read at *span (possibly 0), checking the other side's index
+  /// again when its cached copy would give a shorter span; *_commit
+  /// publishes the first `count`. try_push/try_pop only recheck when the
+  /// cached index leaves no room at all.
+  size_t x_spsc_write_begin(XSpscQueue* q, void** span);
+  void  x_spsc_write_commit(XSpscQueue* q, size_t count);
+  size_t x_spsc_read_begin(XSpscQueue* q, void** span);
+  void  x_spsc_read_commit(XSpscQueue* q, size_t count);
+
+  /// Blocking helpers, only valid on rings created with `blocking`.
+  void  x_spsc_wait_writable(XSpscQueue* q);
+  void  x_spsc_wait_readable(XSpscQueue* q);
+  void  x_spsc_push(XSpscQueue* q, const void* item);
+  void  x_spsc_pop(XSpscQueue* q, void* out);
 
   // ---------------------------------------------------------------------------
   // Thread pool
   // ---------------------------------------------------------------------------
 
+  typedef struct
+  {
+    int min_threads;            // Workers kept alive at all times, at least 1
+    int max_threads;            // Upper bound for extra workers, 0 means min_threads
+    uint32_t spawn_wait_us;     // Queue wait that triggers a new worker, 0 for the default
+    uint32_t idle_timeout_ms;   // Idle time before an extra worker retires, 0 for the default
+    size_t stack_size;          // Worker stack size, 0 for the platform default
+    const char* name;           // Workers are named "<name>-<slot>", NULL leaves them unnamed
+    bool pin_workers;           // Pin each worker to a single CPU
+    bool numa_aware;            // Group workers by NUMA node, each group with its own queue
+    int numa_nodes;             // Number of groups when numa_aware, 0 detects the NUMA nodes
+  } XThreadPoolConfig;
+
+  /// Fixed size pool, same as min_threads == max_threads == num_threads.
   XThreadPool* threadpool_create(int num_threads);
+
+  /// Elastic pool. Starts min_threads workers and adds more, up to
+  /// max_threads, when tasks wait longer than spawn_wait_us or every worker
+  /// is stuck in a task. Extra workers retire after idle_timeout_ms.
+  XThreadPool* threadpool_create_ex(const XThreadPoolConfig* config);
+
+  /// Queue fn(arg) on the pool. Each node's queue holds
+  /// STDX_THREADPOOL_QUEUE_CAPACITY (4096) tasks and spills into the next
+  /// node's. When all are full, a worker of the pool runs the task itself,
+  /// and any other thread blocks until a worker takes a task off its queue.
   int threadpool_enqueue(XThreadPool* pool, XThreadTask_fn fn, void* arg);
   void threadpool_destroy(XThreadPool* pool);
 
+  /// Shared cancellation flag. Tasks enqueued with a token are skipped if it
+  /// is cancelled before they start; running tasks may poll it to stop early.
+  /// The pool keeps its own reference while a task holds the token, so the
+  /// creator may destroy it at any time.
+  XCancelToken* x_cancel_token_create(void);
+  void  x_cancel_token_cancel(XCancelToken* token);
+  bool  x_cancel_token_is_cancelled(XCancelToken* token);
+  void  x_cancel_token_destroy(XCancelToken* token);
+
+  typedef struct
+  {
+    XCancelToken* token;        // NULL for none
+    uint64_t deadline_ns;       // x_thread_time_ns() after which a queued task is dropped, 0 for none
+    XThreadTask_fn cancel_fn;   // Called with the task's arg instead of fn when the task is dropped
+  } XTaskOptions;
+
+  /// Enqueue with a cancellation token and/or deadline. A task that is
+  /// cancelled, expired or discarded at shutdown before it starts never runs
+  /// fn; cancel_fn runs instead so the owner can release `arg`.
+  int threadpool_enqueue_ex(XThreadPool* pool, XThreadTask_fn fn, void* arg, const XTaskOptions* options);
+
+  /// Token of the task running on the calling thread, NULL if none.
+  XCancelToken* threadpool_current_token(void);
+
+  /// Stop the pool and free it. Queued tasks are run for up to
+  /// `drain_timeout_ms` (negative waits for all of them, 0 runs none); the
+  /// rest are dropped through their cancel_fn. Running tasks always finish.
+  /// Returns the number of tasks dropped. threadpool_destroy drains fully.
+  int threadpool_destroy_ex(XThreadPool* pool, int drain_timeout_ms);
+
+  /// Queue a task on a given node's queue, e.g. the node that holds the data
+  /// it works on. Idle workers of other nodes still steal it. Plain
+  /// threadpool_enqueue uses the calling worker's node, or spreads tasks
+  /// from outside threads across nodes.
+  int threadpool_enqueue_on_node(XThreadPool* pool, int node, XThreadTask_fn fn, void* arg);
+
+  /// Number of worker groups (1 unless numa_aware).
+  int threadpool_num_nodes(XThreadPool* pool);
+
+  /// Node of the calling pool worker, -1 outside of pool workers. Memory a
+  /// task allocates and touches first is placed on this node by the OS.
+  int threadpool_current_node(void);
+
+  /// Mark the calling task as about to block (I/O, sleeping, waiting on a
+  /// lock). The pool may start another worker so queued work keeps running.
+  /// Calls nest and must be paired with threadpool_blocking_end(). No-op
+  /// outside of pool workers.
+  void threadpool_blocking_begin(void);
+  void threadpool_blocking_end(void);
+
+#define X_THREADPOOL_LATENCY_BUCKETS 24
+
+  /// Counters of a single worker. Each worker only ever writes its own.
+  typedef struct
+  {
+    uint64_t tasks_executed;
+    uint64_t busy_ns;           // Time spent running tasks
+    uint64_t idle_ns;           // Time between tasks (spinning or parked)
+    uint64_t waits;             // Times the worker parked on an empty queue
+    uint64_t steals;            // Tasks taken from another node's queue
+    uint64_t tasks_cancelled;   // Dropped because their token was cancelled
+    uint64_t tasks_expired;     // Dropped because their deadline passed while queued
+    int node;
+    int cpu;                    // CPU the worker is pinned to, -1 if not pinned
+  } XThreadPoolWorkerStats;
+
+  /// Pool-wide snapshot. The latency histogram counts enqueue-to-start
+  /// delays: bucket 0 is under 1 us, bucket i covers [2^(i-1), 2^i) us and
+  /// the last bucket is open ended.
+  typedef struct
+  {
+    int num_workers;            // Live workers
+    int max_workers;
+    int blocked_workers;        // Live workers inside threadpool_blocking_begin/end
+    int num_nodes;
+    uint32_t queue_depth;       // Summed over all node queues
+    uint32_t queue_capacity;
+    uint64_t workers_spawned;   // Workers started beyond the initial ones
+    uint64_t workers_retired;
+    uint64_t tasks_executed;
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+    uint64_t waits;
+    uint64_t steals;
+    uint64_t tasks_cancelled;   // Including tasks dropped by helping threads
+    uint64_t tasks_expired;
+    uint64_t tasks_discarded;   // Dropped by threadpool_destroy_ex
+    uint64_t latency_histogram[X_THREADPOOL_LATENCY_BUCKETS];
+  } XThreadPoolStats;
+
+  /// Take a snapshot of the pool counters. Per worker counters are copied to
+  /// `workers` (if not NULL) up to `max_workers`, one entry per worker slot,
+  /// retired slots included. Returns the number of slots (the pool's
+  /// max_threads), or -1 on an invalid pool. Counters are read without
+  /// stopping the workers, so totals may be a few tasks apart from each other.
+  int threadpool_stats(XThreadPool* pool, XThreadPoolStats* stats, XThreadPoolWorkerStats* workers, int max_workers);
+
+  /// Upper bound, in nanoseconds, of the histogram bucket holding the given
+  /// percentile (0..100) of enqueue-to-start latencies. 0 if nothing ran yet.
+  uint64_t threadpool_stats_latency_percentile(const XThreadPoolStats* stats, double percentile);
+
+  /// Run fn(arg) on the pool after `delay_ms`. Returns a timer id, 0 on failure.
+  XTimerId threadpool_schedule_after(XThreadPool* pool, uint32_t delay_ms, XThreadTask_fn fn, void* arg);
+
+  /// Run fn(arg) after `delay_ms` and then every `period_ms` until cancelled.
+  XTimerId threadpool_schedule_every(XThreadPool* pool, uint32_t delay_ms, uint32_t period_ms, XThreadTask_fn fn, void* arg);
+
+  /// Cancel a pending timer. Returns false if it already fired (one-shot) or
+  /// is unknown. A firing already handed to the workers still runs.
+  bool threadpool_cancel_timer(XThreadPool* pool, XTimerId id);
+
+  // ---------------------------------------------------------------------------
+  // Task groups
+  // ---------------------------------------------------------------------------
+  //
+  // A batch of pool tasks the submitter can wait on. While waiting, the
+  // calling thread runs queued pool tasks itself instead of sleeping, so a
+  // pool task may fork a group and wait on it without tying up a worker or
+  // deadlocking a small pool.
+
+  XTaskGroup* x_taskgroup_create(XThreadPool* pool);
+
+  /// Queue fn(arg) on the group's pool as part of the group. Tasks of a group
+  /// may add more tasks to the same group.
+  int   x_taskgroup_run(XTaskGroup* group, XThreadTask_fn fn, void* arg);
+
+  /// Help run pool tasks until every task of the group finished. The group
+  /// can be reused afterwards. Since any queued task may end up running on
+  /// the waiting thread, do not wait while holding a lock other tasks need.
+  void  x_taskgroup_wait(XTaskGroup* group);
+
+  /// Number of group tasks not finished yet.
+  int   x_taskgroup_pending(XTaskGroup* group);
+
+  void  x_taskgroup_destroy(XTaskGroup* group);
+
+  // ---------------------------------------------------------------------------
+  // Task graph
+  // ---------------------------------------------------------------------------
+
+  /// Create an empty task graph.
+  XTaskGraph* x_taskgraph_create(void);
+
+  /// Add a node that runs fn(arg). Returns the node id or -1 on failure.
+  int   x_taskgraph_add_node(XTaskGraph* graph, XThreadTask_fn fn, void* arg);
+
+  /// Make node `after` wait for node `before`. Returns 0 on success.
+  int   x_taskgraph_add_edge(XTaskGraph* graph, int before, int after);
+
+  /// Run the graph on `pool`. Nodes are released as soon as all of their
+  /// predecessors finished. Returns -1 if the graph is already running or has
+  /// a cycle. A finished graph can be submitted again without reallocating.
+  int   x_taskgraph_submit(XTaskGraph* graph, XThreadPool* pool);
+
+  /// Block until every node of the current submission has run.
+  void  x_taskgraph_wait(XTaskGraph* graph);
+
+  void  x_taskgraph_destroy(XTaskGraph* graph);
+
+  // ---------------------------------------------------------------------------
+  // Atomic operations
+  // ---------------------------------------------------------------------------
+  //
+  // Loads have acquire semantics, stores have release semantics and every
+  // read-modify-write operation is sequentially consistent. add/exchange
+  // return the previous value. cas updates *expected on failure.
+
+#define X_CACHE_LINE_SIZE 64
+
+#if defined(_MSC_VER)
+#define X_THREAD_LOCAL __declspec(thread)
+#else
+#define X_THREAD_LOCAL __thread
+#endif
+
+#if defined(_MSC_VER)
+
+  static inline int32_t x_atomic_load_i32(volatile int32_t* p) { int32_t v = *p; _ReadWriteBarrier(); return v; }
+  static inline void    x_atomic_store_i32(volatile int32_t* p, int32_t v) { _InterlockedExchange((volatile long*)p, v); }
+  static inline int32_t x_atomic_add_i32(volatile int32_t* p, int32_t v) { return _InterlockedExchangeAdd((volatile long*)p, v); }
+  static inline int32_t x_atomic_exchange_i32(volatile int32_t* p, int32_t v) { return _InterlockedExchange((volatile long*)p, v); }
+  static inline bool    x_atomic_cas_i32(volatile int32_t* p, int32_t* expected, int32_t desired)
+  {
+    int32_t prev = _InterlockedCompareExchange((volatile long*)p, desired, *expected);
+    if (prev == *expected) return true;
+    *expected = prev;
+    return false;
+  }
+
+  static inline int64_t x_atomic_load_i64(volatile int64_t* p) { int64_t v = *p; _ReadWriteBarrier(); return v; }
+  static inline void    x_atomic_store_i64(volatile int64_t* p, int64_t v) { _InterlockedExchange64(p, v); }
+  static inline int64_t x_atomic_add_i64(volatile int64_t* p, int64_t v) { return _InterlockedExchangeAdd64(p, v); }
+  static inline int64_t x_atomic_exchange_i64(volatile int64_t* p, int64_t v) { return _InterlockedExchange64(p, v); }
+  static inline bool    x_atomic_cas_i64(volatile int64_t* p, int64_t* expected, int64_t desired)
+  {
+    int64_t prev = _InterlockedCompareExchange64(p, desired, *expected);
+    if (prev == *expected) return true;
+    *expected = prev;
+    return false;
+  }
+
+  static inline void*   x_atomic_load_ptr(void* volatile* p) { void* v = *p; _ReadWriteBarrier(); return v; }
+  static inline void    x_atomic_store_ptr(void* volatile* p, void* v) { _InterlockedExchangePointer(p, v); }
+  static inline void*   x_atomic_exchange_ptr(void* volatile* p, void* v) { return _InterlockedExchangePointer(p, v); }
+  static inline bool    x_atomic_cas_ptr(void* volatile* p, void** expected, void* desired)
+  {
+    void* prev = _InterlockedCompareExchangePointer(p, desired, *expected);
+    if (prev == *expected) return true;
+    *expected = prev;
+    return false;
+  }
+
+  static inline void    x_atomic_fence(void) { volatile long barrier = 0; _InterlockedOr(&barrier, 0); }
+#if defined(_M_ARM64) || defined(_M_ARM)
+  static inline void    x_cpu_relax(void) { __yield(); }
+#else
+  static inline void    x_cpu_relax(void) { _mm_pause(); }
+#endif
+
+#else // GCC / Clang
+
+  static inline int32_t x_atomic_load_i32(volatile int32_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+  static inline void    x_atomic_store_i32(volatile int32_t* p, int32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+  static inline int32_t x_atomic_add_i32(volatile int32_t* p, int32_t v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+  static inline int32_t x_atomic_exchange_i32(volatile int32_t* p, int32_t v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+  static inline bool    x_atomic_cas_i32(volatile int32_t* p, int32_t* expected, int32_t desired)
+  {
+    return __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  }
+
+  static inline int64_t x_atomic_load_i64(volatile int64_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+  static inline void    x_atomic_store_i64(volatile int64_t* p, int64_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+  static inline int64_t x_atomic_add_i64(volatile int64_t* p, int64_t v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+  static inline int64_t x_atomic_exchange_i64(volatile int64_t* p, int64_t v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+  static inline bool    x_atomic_cas_i64(volatile int64_t* p, int64_t* expected, int64_t desired)
+  {
+    return __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  }
+
+  static inline void*   x_atomic_load_ptr(void* volatile* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+  static inline void    x_atomic_store_ptr(void* volatile* p, void* v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+  static inline void*   x_atomic_exchange_ptr(void* volatile* p, void* v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+  static inline bool    x_atomic_cas_ptr(void* volatile* p, void** expected, void* desired)
+  {
+    return __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  }
+
+  static inline void    x_atomic_fence(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#if defined(__x86_64__) || defined(__i386__)
+  static inline void    x_cpu_relax(void) { __builtin_ia32_pause(); }
+#elif defined(__aarch64__) || defined(__arm__)
+  static inline void    x_cpu_relax(void) { __asm__ __volatile__("yield"); }
+#else
+  static inline void    x_cpu_relax(void) { }
+#endif
+
+#endif // _MSC_VER
+
 
 #ifdef STDX_IMPLEMENTATION_THREAD
 
-#include <stdbool.h>
-#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
 
@@ -96,25 +572,134 @@ extern "C" {
   {
     x_thread_func_t func;
     void* arg;
+    bool has_attr;
+    XThreadAttr attr;
+    char name[64];
   };
 
+  static void x_thread_apply_attr(struct XThreadWrapper* wrap)
+  {
+    if (!wrap->has_attr)
+      return;
+    if (wrap->name[0])
+      x_thread_set_name(wrap->name);
+    if (wrap->attr.priority != X_THREAD_PRIORITY_NORMAL)
+      x_thread_set_priority(wrap->attr.priority);
+    if (x_cpuset_count(&wrap->attr.affinity) > 0)
+      x_thread_set_affinity(&wrap->attr.affinity);
+  }
+
   static DWORD WINAPI x_thread_proc(LPVOID param)
   {
     struct XThreadWrapper* wrap = (struct XThreadWrapper*)param;
+    x_thread_apply_attr(wrap);
     void* result = wrap->func(wrap->arg);
     free(wrap);
     return (DWORD)(uintptr_t)result;
   }
 
-  int x_thread_create(XThread** t, x_thread_func_t func, void* arg)
+  int x_thread_create_ex(XThread** t, const XThreadAttr* attr, x_thread_func_t func, void* arg)
   {
     if (!t || !func) return -1;
     *t = malloc(sizeof(XThread));
-    struct XThreadWrapper* wrap = malloc(sizeof(struct XThreadWrapper));
+    struct XThreadWrapper* wrap = calloc(1, sizeof(struct XThreadWrapper));
     wrap->func = func;
     wrap->arg = arg;
-    (*t)->handle = CreateThread(NULL, 0, x_thread_proc, wrap, 0, NULL);
-    return (*t)->handle ? 0 : -1;
+    if (attr)
+    {
+      wrap->has_attr = true;
+      wrap->attr = *attr;
+      if (attr->name)
+        strncpy(wrap->name, attr->name, sizeof(wrap->name) - 1);
+    }
+
+    SIZE_T stack_size = attr ? (SIZE_T) attr->stack_size : 0;
+    (*t)->handle = CreateThread(NULL, stack_size, x_thread_proc, wrap, stack_size ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0, NULL);
+    if (!(*t)->handle)
+    {
+      free(wrap);
+      free(*t);
+      *t = NULL;
+      return -1;
+    }
+    return 0;
+  }
+
+  int x_thread_create(XThread** t, x_thread_func_t func, void* arg)
+  {
+    return x_thread_create_ex(t, NULL, func, arg);
+  }
+
+  int x_thread_set_name(const char* name)
+  {
+    // SetThreadDescription only exists on Windows 10 1607 and later
+    typedef HRESULT (WINAPI *SetThreadDescription_fn)(HANDLE, PCWSTR);
+    SetThreadDescription_fn set_description =
+      (SetThreadDescription_fn)(void*) GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetThreadDescription");
+    if (!set_description || !name)
+      return -1;
+
+    wchar_t wide[64];
+    if (MultiByteToWideChar(CP_UTF8, 0, name, -1, wide, 64) == 0)
+      return -1;
+    return SUCCEEDED(set_description(GetCurrentThread(), wide)) ? 0 : -1;
+  }
+
+  int x_thread_set_priority(XThreadPriority priority)
+  {
+    static const int map[] =
+    {
+      THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL,
+      THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_HIGHEST
+    };
+    int index = (int) priority + 2;
+    if (index < 0 || index > 4) return -1;
+    return SetThreadPriority(GetCurrentThread(), map[index]) ? 0 : -1;
+  }
+
+  int x_thread_set_affinity(const XCpuSet* cpus)
+  {
+    // Processor group 0 only
+    DWORD_PTR mask = (DWORD_PTR) cpus->bits[0];
+    if (!mask) return -1;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? 0 : -1;
+  }
+
+  int x_thread_get_affinity(XCpuSet* cpus)
+  {
+    // Processor group 0 only
+    DWORD_PTR process_mask, system_mask;
+    x_cpuset_zero(cpus);
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask) || !process_mask)
+      return -1;
+    cpus->bits[0] = (uint64_t) process_mask;
+    return 0;
+  }
+
+  int x_thread_cpu_count(void)
+  {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+  }
+
+  int x_thread_numa_nodes(XCpuSet* nodes, int max_nodes)
+  {
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest))
+      return 0;
+
+    int count = 0;
+    for (ULONG node = 0; node <= highest && count < max_nodes; ++node)
+    {
+      ULONGLONG mask = 0;
+      if (!GetNumaNodeProcessorMask((UCHAR) node, &mask) || mask == 0)
+        continue;
+      x_cpuset_zero(&nodes[count]);
+      nodes[count].bits[0] = (uint64_t) mask;
+      count++;
+    }
+    return count;
   }
 
   void x_thread_join(XThread* t)
@@ -180,6 +765,11 @@ extern "C" {
     free(cv);
   }
 
+  bool x_thread_condvar_wait_timeout(XCondVar* cv, XMutex* m, int ms)
+  {
+    return SleepConditionVariableCS(&cv->cv, &m->cs, ms < 0 ? 0 : (DWORD) ms) != 0;
+  }
+
   void x_thread_sleep_ms(int ms)
   {
     Sleep(ms);
@@ -190,28 +780,225 @@ extern "C" {
     Sleep(0);
   }
 
+  uint64_t x_thread_time_ns(void)
+  {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+      QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull
+      + (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / (uint64_t) frequency.QuadPart;
+  }
+
 #else // POSIX
 
 #include <pthread.h>
 #include <unistd.h>
 #include <sched.h>
 #include <time.h>
+#include <limits.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
 
-  struct XThread { pXThread id; };
-  struct mutex  { px_thread_XMutex m; };
-  struct condvar { px_thread_cond_t cv; };
+  struct XXThread { pthread_t id; };
+  struct XXMutex  { pthread_mutex_t m; };
+  struct XXCondVar { pthread_cond_t cv; };
 
-  int x_thread_create(XThread** t, x_thread_func_t func, void* arg)
+  struct XThreadWrapper
+  {
+    x_thread_func_t func;
+    void* arg;
+    XThreadAttr attr;
+    char name[64];
+  };
+
+  static void* x_thread_start(void* param)
+  {
+    struct XThreadWrapper* wrap = (struct XThreadWrapper*)param;
+    if (wrap->name[0])
+      x_thread_set_name(wrap->name);
+    if (wrap->attr.priority != X_THREAD_PRIORITY_NORMAL)
+      x_thread_set_priority(wrap->attr.priority);
+    if (x_cpuset_count(&wrap->attr.affinity) > 0)
+      x_thread_set_affinity(&wrap->attr.affinity);
+
+    x_thread_func_t func = wrap->func;
+    void* arg = wrap->arg;
+    free(wrap);
+    return func(arg);
+  }
+
+  int x_thread_create_ex(XThread** t, const XThreadAttr* attr, x_thread_func_t func, void* arg)
   {
     if (!t || !func) return -1;
     *t = malloc(sizeof(XThread));
-    return px_thread_create(&(*t)->id, NULL, func, arg);
+
+    if (!attr)
+      return pthread_create(&(*t)->id, NULL, func, arg);
+
+    struct XThreadWrapper* wrap = calloc(1, sizeof(struct XThreadWrapper));
+    wrap->func = func;
+    wrap->arg = arg;
+    wrap->attr = *attr;
+    if (attr->name)
+      strncpy(wrap->name, attr->name, sizeof(wrap->name) - 1);
+
+    pthread_attr_t pattr;
+    pthread_attr_init(&pattr);
+    if (attr->stack_size)
+    {
+      size_t stack_size = attr->stack_size;
+#ifdef PTHREAD_STACK_MIN
+      if (stack_size < (size_t) PTHREAD_STACK_MIN)
+        stack_size = (size_t) PTHREAD_STACK_MIN;
+#endif
+      pthread_attr_setstacksize(&pattr, stack_size);
+    }
+
+    int result = pthread_create(&(*t)->id, &pattr, x_thread_start, wrap);
+    pthread_attr_destroy(&pattr);
+    if (result != 0)
+    {
+      free(wrap);
+      free(*t);
+      *t = NULL;
+    }
+    return result;
+  }
+
+  int x_thread_create(XThread** t, x_thread_func_t func, void* arg)
+  {
+    return x_thread_create_ex(t, NULL, func, arg);
+  }
+
+  int x_thread_set_name(const char* name)
+  {
+    if (!name) return -1;
+#if defined(__linux__)
+    char truncated[16];
+    strncpy(truncated, name, sizeof(truncated) - 1);
+    truncated[sizeof(truncated) - 1] = 0;
+    return prctl(PR_SET_NAME, truncated, 0, 0, 0) == 0 ? 0 : -1;
+#elif defined(__APPLE__)
+    return pthread_setname_np(name) == 0 ? 0 : -1;
+#else
+    return -1;
+#endif
+  }
+
+  int x_thread_set_priority(XThreadPriority priority)
+  {
+#if defined(__linux__)
+    // Linux threads have their own nice value
+    static const int nice_values[] = { 10, 5, 0, -5, -10 };
+    int index = (int) priority + 2;
+    if (index < 0 || index > 4) return -1;
+    pid_t tid = (pid_t) syscall(SYS_gettid);
+    return setpriority(PRIO_PROCESS, (id_t) tid, nice_values[index]) == 0 ? 0 : -1;
+#else
+    int policy;
+    struct sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0)
+      return -1;
+    int lo = sched_get_priority_min(policy);
+    int hi = sched_get_priority_max(policy);
+    param.sched_priority = lo + (hi - lo) * ((int) priority + 2) / 4;
+    return pthread_setschedparam(pthread_self(), policy, &param) == 0 ? 0 : -1;
+#endif
+  }
+
+  int x_thread_set_affinity(const XCpuSet* cpus)
+  {
+#if defined(__linux__)
+    // The kernel takes an array of longs; on little endian that is the same
+    // bytes as our 64 bit words.
+    return syscall(SYS_sched_setaffinity, 0, sizeof(cpus->bits), cpus->bits) == 0 ? 0 : -1;
+#else
+    (void) cpus;
+    return -1;
+#endif
+  }
+
+  int x_thread_get_affinity(XCpuSet* cpus)
+  {
+    x_cpuset_zero(cpus);
+#if defined(__linux__)
+    // The raw syscall returns the number of bytes it filled; the rest stay zero
+    return syscall(SYS_sched_getaffinity, 0, sizeof(cpus->bits), cpus->bits) > 0 ? 0 : -1;
+#else
+    return -1;
+#endif
+  }
+
+  int x_thread_cpu_count(void)
+  {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+  }
+
+  // Parse a sysfs list such as "0-3,8,10-11" into a set
+  static bool x_thread_parse_cpulist(const char* text, XCpuSet* set)
+  {
+    x_cpuset_zero(set);
+    const char* p = text;
+    while (*p && *p != '\n')
+    {
+      char* end;
+      long first = strtol(p, &end, 10);
+      if (end == p) return false;
+      long last = first;
+      p = end;
+      if (*p == '-')
+      {
+        last = strtol(p + 1, &end, 10);
+        if (end == p + 1) return false;
+        p = end;
+      }
+      for (long cpu = first; cpu <= last; ++cpu)
+        x_cpuset_add(set, (int) cpu);
+      if (*p == ',') p++;
+    }
+    return true;
+  }
+
+  static bool x_thread_read_cpulist(const char* path, XCpuSet* set)
+  {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char text[4096];
+    bool ok = fgets(text, sizeof(text), f) != NULL && x_thread_parse_cpulist(text, set);
+    fclose(f);
+    return ok;
+  }
+
+  int x_thread_numa_nodes(XCpuSet* nodes, int max_nodes)
+  {
+    XCpuSet online;
+    if (!x_thread_read_cpulist("/sys/devices/system/node/online", &online))
+      return 0;
+
+    int count = 0;
+    for (int node = 0; node < X_THREAD_MAX_CPUS && count < max_nodes; ++node)
+    {
+      if (!x_cpuset_has(&online, node))
+        continue;
+
+      char path[128];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+      if (x_thread_read_cpulist(path, &nodes[count]) && x_cpuset_count(&nodes[count]) > 0)
+        count++; // Memory only nodes have no CPUs to run workers on
+    }
+    return count;
   }
 
   void x_thread_join(XThread* t)
   {
     if (t) {
-      px_thread_join(t->id, NULL);
+      pthread_join(t->id, NULL);
     }
   }
 
@@ -220,56 +1007,86 @@ extern "C" {
     if (t) free(t);
   }
 
-  int x_thread_mutexinit(XMutex** m) {
+  int x_thread_mutex_init(XMutex** m) {
     *m = malloc(sizeof(XMutex));
-    px_thread_x_thread_mutexinit(&(*m)->m, NULL);
+    pthread_mutex_init(&(*m)->m, NULL);
     return 0;
   }
 
   void x_thread_mutex_lock(XMutex* m)
   {
-    px_thread_x_thread_mutexlock(&m->m);
+    pthread_mutex_lock(&m->m);
   }
  
   void x_thread_mutex_unlock(XMutex* m)
   {
-    px_thread_x_thread_mutexunlock(&m->m);
+    pthread_mutex_unlock(&m->m);
   }
 
   void x_thread_mutex_destroy(XMutex* m)
   {
-    px_thread_x_thread_mutexdestroy(&m->m);
+    pthread_mutex_destroy(&m->m);
     free(m);
   }
 
   int x_thread_condvar_init(XCondVar** cv)
   {
     *cv = malloc(sizeof(XCondVar));
-    px_thread_cond_init(&(*cv)->cv, NULL);
+#if defined(__APPLE__)
+    pthread_cond_init(&(*cv)->cv, NULL);
+#else
+    // Timed waits are measured on the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&(*cv)->cv, &attr);
+    pthread_condattr_destroy(&attr);
+#endif
     return 0;
   }
 
   void x_thread_condvar_wait(XCondVar* cv, XMutex* m)
   {
-    px_thread_cond_wait(&cv->cv, &m->m);
+    pthread_cond_wait(&cv->cv, &m->m);
   }
 
   void x_thread_condvar_signal(XCondVar* cv)
   {
-    px_thread_cond_signal(&cv->cv);
+    pthread_cond_signal(&cv->cv);
   }
   
   void x_thread_condvar_broadcast(XCondVar* cv)
   {
-    px_thread_cond_broadcast(&cv->cv);
+    pthread_cond_broadcast(&cv->cv);
   }
 
   void x_thread_condvar_destroy(XCondVar* cv)
   {
-    px_thread_cond_destroy(&cv->cv);
+    pthread_cond_destroy(&cv->cv);
     free(cv);
   }
 
+  bool x_thread_condvar_wait_timeout(XCondVar* cv, XMutex* m, int ms)
+  {
+    if (ms < 0) ms = 0;
+    struct timespec ts;
+#if defined(__APPLE__)
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    return pthread_cond_timedwait_relative_np(&cv->cv, &m->m, &ts) == 0;
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(&cv->cv, &m->m, &ts) == 0;
+#endif
+  }
+
   void x_thread_sleep_ms(int ms)
   {
     struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
@@ -281,144 +1098,2311 @@ extern "C" {
     sched_yield();
   }
 
-#endif
-
+  uint64_t x_thread_time_ns(void)
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+  }
 
+#endif
 
+  // ---------------------------------------------------------------------------
+  // Semaphores, barriers, latches and events
+  // ---------------------------------------------------------------------------
 
-#define THREADPOOL_MAGIC 0xDEADBEEF
+#define X_SYNC_SPIN_COUNT 128
 
-  struct XTask_t
+  struct XXSemaphore
   {
-    XThreadTask_fn fn;
-    void* arg;
-    XTask* next;
+    volatile int32_t value;
+    volatile int32_t waiters;
+    XMutex* lock;
+    XCondVar* cv;
   };
 
-  struct XThreadPool_t
+  struct XXBarrier
   {
-    uint32_t magic;
-    XThread** threads;
-    int num_threads;
-
-    XTask* head;
-    XTask* tail;
+    int32_t count;
+    volatile int32_t arrived;
+    volatile int32_t generation;
+    volatile int32_t sleepers;
+    XMutex* lock;
+    XCondVar* cv;
+  };
 
+  struct XXLatch
+  {
+    volatile int32_t count;
+    volatile int32_t waiters;
     XMutex* lock;
     XCondVar* cv;
+  };
 
-    bool stop;
+  struct XXEvent
+  {
+    volatile int32_t signaled;
+    volatile int32_t waiters;
+    XMutex* lock;
+    XCondVar* cv;
   };
 
-  static void* thread_main(void* arg)
+  int x_thread_semaphore_init(XSemaphore** s, int initial)
   {
-    XThreadPool* pool = (XThreadPool*)arg;
+    *s = calloc(1, sizeof(XSemaphore));
+    if (!*s) return -1;
+    (*s)->value = initial;
+    x_thread_mutex_init(&(*s)->lock);
+    x_thread_condvar_init(&(*s)->cv);
+    return 0;
+  }
 
-    while (1)
+  bool x_thread_semaphore_try_wait(XSemaphore* s)
+  {
+    int32_t value = x_atomic_load_i32(&s->value);
+    while (value > 0)
     {
-      x_thread_mutex_lock(pool->lock);
-      while (!pool->head && !pool->stop)
-      {
-        x_thread_condvar_wait(pool->cv, pool->lock);
-      }
+      if (x_atomic_cas_i32(&s->value, &value, value - 1))
+        return true;
+    }
+    return false;
+  }
 
-      if (pool->stop && !pool->head)
-      {
-        x_thread_mutex_unlock(pool->lock);
-        break;
-      }
+  // ms < 0 waits forever
+  static bool x_thread_semaphore_wait_internal(XSemaphore* s, int ms)
+  {
+    for (int i = 0; i < X_SYNC_SPIN_COUNT; ++i)
+    {
+      if (x_thread_semaphore_try_wait(s))
+        return true;
+      x_cpu_relax();
+    }
 
-      XTask* task = pool->head;
-      if (task)
+    uint64_t deadline = ms > 0 ? x_thread_time_ns() + (uint64_t) ms * 1000000ull : 0;
+    bool acquired = true;
+    x_thread_mutex_lock(s->lock);
+    x_atomic_add_i32(&s->waiters, 1);
+    while (!x_thread_semaphore_try_wait(s))
+    {
+      if (ms < 0)
       {
-        pool->head = task->next;
-        if (!pool->head) pool->tail = NULL;
+        x_thread_condvar_wait(s->cv, s->lock);
+        continue;
       }
-      x_thread_mutex_unlock(pool->lock);
 
-      if (task)
+      uint64_t now = x_thread_time_ns();
+      if (ms == 0 || now >= deadline)
       {
-        task->fn(task->arg);
-        free(task);
+        acquired = false;
+        break;
       }
+      x_thread_condvar_wait_timeout(s->cv, s->lock, (int)((deadline - now + 999999) / 1000000));
     }
-    return NULL;
+    x_atomic_add_i32(&s->waiters, -1);
+    x_thread_mutex_unlock(s->lock);
+    return acquired;
   }
 
-  XThreadPool* threadpool_create(int num_threads)
+  void x_thread_semaphore_wait(XSemaphore* s)
   {
-    if (num_threads <= 0)
-      return NULL;
+    x_thread_semaphore_wait_internal(s, -1);
+  }
 
-    XThreadPool* pool = calloc(1, sizeof(XThreadPool));
-    pool->num_threads = num_threads;
-    pool->threads = calloc(num_threads, sizeof(XThread*));
-    x_thread_mutex_init(&pool->lock);
+  bool x_thread_semaphore_wait_timeout(XSemaphore* s, int ms)
+  {
+    return x_thread_semaphore_wait_internal(s, ms < 0 ? 0 : ms);
+  }
+
+  void x_thread_semaphore_post(XSemaphore* s, int count)
+  {
+    if (count <= 0) return;
+    x_atomic_add_i32(&s->value, count);
+
+    x_atomic_fence();
+    int32_t waiters = x_atomic_load_i32(&s->waiters);
+    if (waiters == 0)
+      return;
+
+    x_thread_mutex_lock(s->lock);
+    if (count >= waiters)
+      x_thread_condvar_broadcast(s->cv);
+    else
+      while (count-- > 0)
+        x_thread_condvar_signal(s->cv);
+    x_thread_mutex_unlock(s->lock);
+  }
+
+  void x_thread_semaphore_destroy(XSemaphore* s)
+  {
+    if (!s) return;
+    x_thread_mutex_destroy(s->lock);
+    x_thread_condvar_destroy(s->cv);
+    free(s);
+  }
+
+  int x_thread_barrier_init(XBarrier** b, int count)
+  {
+    if (count <= 0) return -1;
+    *b = calloc(1, sizeof(XBarrier));
+    if (!*b) return -1;
+    (*b)->count = count;
+    x_thread_mutex_init(&(*b)->lock);
+    x_thread_condvar_init(&(*b)->cv);
+    return 0;
+  }
+
+  bool x_thread_barrier_wait(XBarrier* b)
+  {
+    int32_t generation = x_atomic_load_i32(&b->generation);
+
+    if (x_atomic_add_i32(&b->arrived, 1) == b->count - 1)
+    {
+      // Last to arrive: reset for the next phase before releasing anyone
+      x_atomic_store_i32(&b->arrived, 0);
+      x_atomic_add_i32(&b->generation, 1);
+      x_atomic_fence();
+      if (x_atomic_load_i32(&b->sleepers) > 0)
+      {
+        x_thread_mutex_lock(b->lock);
+        x_thread_condvar_broadcast(b->cv);
+        x_thread_mutex_unlock(b->lock);
+      }
+      return true;
+    }
+
+    // Phases are usually short: spin before paying for a sleep
+    for (int i = 0; i < X_SYNC_SPIN_COUNT * 8; ++i)
+    {
+      if (x_atomic_load_i32(&b->generation) != generation)
+        return false;
+      x_cpu_relax();
+    }
+
+    x_thread_mutex_lock(b->lock);
+    x_atomic_add_i32(&b->sleepers, 1);
+    while (x_atomic_load_i32(&b->generation) == generation)
+      x_thread_condvar_wait(b->cv, b->lock);
+    x_atomic_add_i32(&b->sleepers, -1);
+    x_thread_mutex_unlock(b->lock);
+    return false;
+  }
+
+  void x_thread_barrier_destroy(XBarrier* b)
+  {
+    if (!b) return;
+    x_thread_mutex_destroy(b->lock);
+    x_thread_condvar_destroy(b->cv);
+    free(b);
+  }
+
+  int x_thread_latch_init(XLatch** l, int count)
+  {
+    *l = calloc(1, sizeof(XLatch));
+    if (!*l) return -1;
+    (*l)->count = count < 0 ? 0 : count;
+    x_thread_mutex_init(&(*l)->lock);
+    x_thread_condvar_init(&(*l)->cv);
+    return 0;
+  }
+
+  void x_thread_latch_count_down(XLatch* l, int n)
+  {
+    if (n <= 0) return;
+    int32_t before = x_atomic_add_i32(&l->count, -n);
+    if (before <= 0 || before > n)
+      return;
+
+    x_atomic_fence();
+    if (x_atomic_load_i32(&l->waiters) > 0)
+    {
+      x_thread_mutex_lock(l->lock);
+      x_thread_condvar_broadcast(l->cv);
+      x_thread_mutex_unlock(l->lock);
+    }
+  }
+
+  bool x_thread_latch_try_wait(XLatch* l)
+  {
+    return x_atomic_load_i32(&l->count) <= 0;
+  }
+
+  void x_thread_latch_wait(XLatch* l)
+  {
+    for (int i = 0; i < X_SYNC_SPIN_COUNT; ++i)
+    {
+      if (x_thread_latch_try_wait(l))
+        return;
+      x_cpu_relax();
+    }
+
+    x_thread_mutex_lock(l->lock);
+    x_atomic_add_i32(&l->waiters, 1);
+    while (!x_thread_latch_try_wait(l))
+      x_thread_condvar_wait(l->cv, l->lock);
+    x_atomic_add_i32(&l->waiters, -1);
+    x_thread_mutex_unlock(l->lock);
+  }
+
+  void x_thread_latch_destroy(XLatch* l)
+  {
+    if (!l) return;
+    x_thread_mutex_destroy(l->lock);
+    x_thread_condvar_destroy(l->cv);
+    free(l);
+  }
+
+  int x_thread_event_init(XEvent** e, bool signaled)
+  {
+    *e = calloc(1, sizeof(XEvent));
+    if (!*e) return -1;
+    (*e)->signaled = signaled ? 1 : 0;
+    x_thread_mutex_init(&(*e)->lock);
+    x_thread_condvar_init(&(*e)->cv);
+    return 0;
+  }
+
+  static inline bool x_thread_event_try_consume(XEvent* e)
+  {
+    int32_t expected = 1;
+    return x_atomic_cas_i32(&e->signaled, &expected, 0);
+  }
+
+  void x_thread_event_set(XEvent* e)
+  {
+    if (x_atomic_exchange_i32(&e->signaled, 1) == 1)
+      return; // Already set, nobody new to release
+
+    x_atomic_fence();
+    if (x_atomic_load_i32(&e->waiters) > 0)
+    {
+      x_thread_mutex_lock(e->lock);
+      x_thread_condvar_signal(e->cv);
+      x_thread_mutex_unlock(e->lock);
+    }
+  }
+
+  static bool x_thread_event_wait_internal(XEvent* e, int ms)
+  {
+    for (int i = 0; i < X_SYNC_SPIN_COUNT; ++i)
+    {
+      if (x_thread_event_try_consume(e))
+        return true;
+      x_cpu_relax();
+    }
+
+    uint64_t deadline = ms > 0 ? x_thread_time_ns() + (uint64_t) ms * 1000000ull : 0;
+    bool consumed = true;
+    x_thread_mutex_lock(e->lock);
+    x_atomic_add_i32(&e->waiters, 1);
+    while (!x_thread_event_try_consume(e))
+    {
+      if (ms < 0)
+      {
+        x_thread_condvar_wait(e->cv, e->lock);
+        continue;
+      }
+
+      uint64_t now = x_thread_time_ns();
+      if (ms == 0 || now >= deadline)
+      {
+        consumed = false;
+        break;
+      }
+      x_thread_condvar_wait_timeout(e->cv, e->lock, (int)((deadline - now + 999999) / 1000000));
+    }
+    x_atomic_add_i32(&e->waiters, -1);
+    x_thread_mutex_unlock(e->lock);
+    return consumed;
+  }
+
+  void x_thread_event_wait(XEvent* e)
+  {
+    x_thread_event_wait_internal(e, -1);
+  }
+
+  bool x_thread_event_wait_timeout(XEvent* e, int ms)
+  {
+    return x_thread_event_wait_internal(e, ms < 0 ? 0 : ms);
+  }
+
+  void x_thread_event_destroy(XEvent* e)
+  {
+    if (!e) return;
+    x_thread_mutex_destroy(e->lock);
+    x_thread_condvar_destroy(e->cv);
+    free(e);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Bounded MPMC queue
+  // ---------------------------------------------------------------------------
+  //
+  // Vyukov's bounded queue: every slot carries a sequence number telling
+  // producers and consumers whose turn it is, so a push or pop is one CAS on
+  // the shared position plus a release store on the slot.
+
+#define X_MPMC_SPIN_COUNT 64
+
+  typedef struct
+  {
+    volatile int64_t sequence;
+    // element bytes follow
+  } XMpmcCell;
+
+  struct XMpmcQueue_t
+  {
+    char pad0[X_CACHE_LINE_SIZE];
+    volatile int64_t enqueue_pos;
+    char pad1[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+    volatile int64_t dequeue_pos;
+    char pad2[X_CACHE_LINE_SIZE - sizeof(int64_t)];
+
+    unsigned char* cells;
+    size_t cell_size;
+    size_t element_size;
+    int64_t mask;
+
+    volatile int32_t waiting_producers;
+    volatile int32_t waiting_consumers;
+    XMutex* lock;
+    XCondVar* not_full;
+    XCondVar* not_empty;
+  };
+
+  static inline XMpmcCell* x_mpmc_cell(XMpmcQueue* q, int64_t pos)
+  {
+    return (XMpmcCell*) (q->cells + (size_t)(pos & q->mask) * q->cell_size);
+  }
+
+  XMpmcQueue* x_mpmc_create(size_t element_size, size_t capacity)
+  {
+    if (element_size == 0 || capacity == 0)
+      return NULL;
+
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    XMpmcQueue* q = calloc(1, sizeof(XMpmcQueue));
+    if (!q) return NULL;
+
+    q->element_size = element_size;
+    q->cell_size = (sizeof(XMpmcCell) + element_size + 7) & ~(size_t)7;
+    q->mask = (int64_t) size - 1;
+    q->cells = malloc(q->cell_size * size);
+    if (!q->cells)
+    {
+      free(q);
+      return NULL;
+    }
+
+    for (size_t i = 0; i < size; ++i)
+      x_mpmc_cell(q, (int64_t) i)->sequence = (int64_t) i;
+
+    x_thread_mutex_init(&q->lock);
+    x_thread_condvar_init(&q->not_full);
+    x_thread_condvar_init(&q->not_empty);
+    return q;
+  }
+
+  void x_mpmc_destroy(XMpmcQueue* q)
+  {
+    if (!q) return;
+    x_thread_mutex_destroy(q->lock);
+    x_thread_condvar_destroy(q->not_full);
+    x_thread_condvar_destroy(q->not_empty);
+    free(q->cells);
+    free(q);
+  }
+
+  static void x_mpmc_wake(XMpmcQueue* q, volatile int32_t* waiting, XCondVar* cv)
+  {
+    // Pairs with the increment in the parking path: either the waiter sees
+    // our update when it re-checks the queue, or we see it waiting here.
+    x_atomic_fence();
+    if (x_atomic_load_i32(waiting) > 0)
+    {
+      x_thread_mutex_lock(q->lock);
+      x_thread_condvar_signal(cv);
+      x_thread_mutex_unlock(q->lock);
+    }
+  }
+
+  static bool x_mpmc_push_nowake(XMpmcQueue* q, const void* item)
+  {
+    int64_t pos = x_atomic_load_i64(&q->enqueue_pos);
+    XMpmcCell* cell;
+    for (;;)
+    {
+      cell = x_mpmc_cell(q, pos);
+      int64_t diff = x_atomic_load_i64(&cell->sequence) - pos;
+      if (diff == 0)
+      {
+        if (x_atomic_cas_i64(&q->enqueue_pos, &pos, pos + 1))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = x_atomic_load_i64(&q->enqueue_pos);
+      }
+    }
+
+    memcpy(cell + 1, item, q->element_size);
+    x_atomic_store_i64(&cell->sequence, pos + 1);
+    return true;
+  }
+
+  static bool x_mpmc_pop_nowake(XMpmcQueue* q, void* out)
+  {
+    int64_t pos = x_atomic_load_i64(&q->dequeue_pos);
+    XMpmcCell* cell;
+    for (;;)
+    {
+      cell = x_mpmc_cell(q, pos);
+      int64_t diff = x_atomic_load_i64(&cell->sequence) - (pos + 1);
+      if (diff == 0)
+      {
+        if (x_atomic_cas_i64(&q->dequeue_pos, &pos, pos + 1))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = x_atomic_load_i64(&q->dequeue_pos);
+      }
+    }
+
+    memcpy(out, cell + 1, q->element_size);
+    x_atomic_store_i64(&cell->sequence, pos + q->mask + 1);
+    return true;
+  }
+
+  bool x_mpmc_try_push(XMpmcQueue* q, const void* item)
+  {
+    if (!x_mpmc_push_nowake(q, item))
+      return false;
+    x_mpmc_wake(q, &q->waiting_consumers, q->not_empty);
+    return true;
+  }
+
+  bool x_mpmc_try_pop(XMpmcQueue* q, void* out)
+  {
+    if (!x_mpmc_pop_nowake(q, out))
+      return false;
+    x_mpmc_wake(q, &q->waiting_producers, q->not_full);
+    return true;
+  }
+
+  void x_mpmc_push(XMpmcQueue* q, const void* item)
+  {
+    for (int i = 0; i < X_MPMC_SPIN_COUNT; ++i)
+    {
+      if (x_mpmc_try_push(q, item))
+        return;
+      x_cpu_relax();
+    }
+
+    x_thread_mutex_lock(q->lock);
+    x_atomic_add_i32(&q->waiting_producers, 1);
+    while (!x_mpmc_push_nowake(q, item))
+      x_thread_condvar_wait(q->not_full, q->lock);
+    x_atomic_add_i32(&q->waiting_producers, -1);
+    x_thread_mutex_unlock(q->lock);
+    x_mpmc_wake(q, &q->waiting_consumers, q->not_empty);
+  }
+
+  void x_mpmc_pop(XMpmcQueue* q, void* out)
+  {
+    for (int i = 0; i < X_MPMC_SPIN_COUNT; ++i)
+    {
+      if (x_mpmc_try_pop(q, out))
+        return;
+      x_cpu_relax();
+    }
+
+    x_thread_mutex_lock(q->lock);
+    x_atomic_add_i32(&q->waiting_consumers, 1);
+    while (!x_mpmc_pop_nowake(q, out))
+      x_thread_condvar_wait(q->not_empty, q->lock);
+    x_atomic_add_i32(&q->waiting_consumers, -1);
+    x_thread_mutex_unlock(q->lock);
+    x_mpmc_wake(q, &q->waiting_producers, q->not_full);
+  }
+
+  size_t x_mpmc_count(XMpmcQueue* q)
+  {
+    int64_t tail = x_atomic_load_i64(&q->dequeue_pos);
+    int64_t head = x_atomic_load_i64(&q->enqueue_pos);
+    return head > tail ? (size_t)(head - tail) : 0;
+  }
+
+  size_t x_mpmc_capacity(XMpmcQueue* q)
+  {
+    return (size_t) q->mask + 1;
+  }
+
+  // ---------------------------------------------------------------------------
+  // SPSC ring
+  // ---------------------------------------------------------------------------
+  //
+  // Each side owns one index and keeps a cached copy of the other side's
+  // index, so it only touches the shared cache line when the cached value
+  // says the ring looks full (producer) or empty (consumer).
+
+  struct XSpscQueue_t
+  {
+    char pad0[X_CACHE_LINE_SIZE];
+    volatile int64_t head;          // Next slot to write, owned by the producer
+    int64_t cached_tail;            // Producer's last view of tail
+    char pad1[X_CACHE_LINE_SIZE - 2 * sizeof(int64_t)];
+    volatile int64_t tail;          // Next slot to read, owned by the consumer
+    int64_t cached_head;            // Consumer's last view of head
+    char pad2[X_CACHE_LINE_SIZE - 2 * sizeof(int64_t)];
+
+    unsigned char* data;
+    size_t element_size;
+    int64_t capacity;
+    int64_t mask;
+
+    bool blocking;
+    volatile int32_t producer_waiting;
+    volatile int32_t consumer_waiting;
+    XMutex* lock;
+    XCondVar* cv;
+  };
+
+  XSpscQueue* x_spsc_create(size_t element_size, size_t capacity, bool blocking)
+  {
+    if (element_size == 0 || capacity == 0)
+      return NULL;
+
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    XSpscQueue* q = calloc(1, sizeof(XSpscQueue));
+    if (!q) return NULL;
+
+    q->data = malloc(size * element_size);
+    if (!q->data)
+    {
+      free(q);
+      return NULL;
+    }
+
+    q->element_size = element_size;
+    q->capacity = (int64_t) size;
+    q->mask = (int64_t) size - 1;
+    q->blocking = blocking;
+    if (blocking)
+    {
+      x_thread_mutex_init(&q->lock);
+      x_thread_condvar_init(&q->cv);
+    }
+    return q;
+  }
+
+  void x_spsc_destroy(XSpscQueue* q)
+  {
+    if (!q) return;
+    if (q->blocking)
+    {
+      x_thread_mutex_destroy(q->lock);
+      x_thread_condvar_destroy(q->cv);
+    }
+    free(q->data);
+    free(q);
+  }
+
+  static inline void x_spsc_notify(XSpscQueue* q, volatile int32_t* waiting)
+  {
+    if (!q->blocking)
+      return;
+
+    x_atomic_fence();
+    if (x_atomic_load_i32(waiting))
+    {
+      x_thread_mutex_lock(q->lock);
+      x_thread_condvar_signal(q->cv);
+      x_thread_mutex_unlock(q->lock);
+    }
+  }
+
+  /* Span for the producer. The cached tail is refreshed whenever it gives
+     fewer than `wanted` slots, so callers see what is really free. */
+  static size_t x_spsc_write_span(XSpscQueue* q, void** span, int64_t wanted)
+  {
+    int64_t head = q->head;
+    int64_t index = head & q->mask;
+    int64_t contiguous = q->capacity - index;
+    if (wanted > contiguous)
+      wanted = contiguous;
+
+    int64_t free_slots = q->capacity - (head - q->cached_tail);
+    if (free_slots < wanted)
+    {
+      q->cached_tail = x_atomic_load_i64(&q->tail);
+      free_slots = q->capacity - (head - q->cached_tail);
+    }
+
+    *span = q->data + (size_t) index * q->element_size;
+    return (size_t)(free_slots < contiguous ? free_slots : contiguous);
+  }
+
+  size_t x_spsc_write_begin(XSpscQueue* q, void** span)
+  {
+    return x_spsc_write_span(q, span, q->capacity);
+  }
+
+  void x_spsc_write_commit(XSpscQueue* q, size_t count)
+  {
+    if (count == 0) return;
+    x_atomic_store_i64(&q->head, q->head + (int64_t) count);
+    x_spsc_notify(q, &q->consumer_waiting);
+  }
+
+  static size_t x_spsc_read_span(XSpscQueue* q, void** span, int64_t wanted)
+  {
+    int64_t tail = q->tail;
+    int64_t index = tail & q->mask;
+    int64_t contiguous = q->capacity - index;
+    if (wanted > contiguous)
+      wanted = contiguous;
+
+    int64_t available = q->cached_head - tail;
+    if (available < wanted)
+    {
+      q->cached_head = x_atomic_load_i64(&q->head);
+      available = q->cached_head - tail;
+    }
+
+    *span = q->data + (size_t) index * q->element_size;
+    return (size_t)(available < contiguous ? available : contiguous);
+  }
+
+  size_t x_spsc_read_begin(XSpscQueue* q, void** span)
+  {
+    return x_spsc_read_span(q, span, q->capacity);
+  }
+
+  void x_spsc_read_commit(XSpscQueue* q, size_t count)
+  {
+    if (count == 0) return;
+    x_atomic_store_i64(&q->tail, q->tail + (int64_t) count);
+    x_spsc_notify(q, &q->producer_waiting);
+  }
+
+  bool x_spsc_try_push(XSpscQueue* q, const void* item)
+  {
+    void* span;
+    if (x_spsc_write_span(q, &span, 1) == 0)
+      return false;
+    memcpy(span, item, q->element_size);
+    x_spsc_write_commit(q, 1);
+    return true;
+  }
+
+  bool x_spsc_try_pop(XSpscQueue* q, void* out)
+  {
+    void* span;
+    if (x_spsc_read_span(q, &span, 1) == 0)
+      return false;
+    memcpy(out, span, q->element_size);
+    x_spsc_read_commit(q, 1);
+    return true;
+  }
+
+  void x_spsc_wait_writable(XSpscQueue* q)
+  {
+    if (q->head - q->cached_tail < q->capacity)
+      return;
+
+    x_thread_mutex_lock(q->lock);
+    x_atomic_exchange_i32(&q->producer_waiting, 1);
+    while ((q->cached_tail = x_atomic_load_i64(&q->tail)) + q->capacity == q->head)
+      x_thread_condvar_wait(q->cv, q->lock);
+    x_atomic_store_i32(&q->producer_waiting, 0);
+    x_thread_mutex_unlock(q->lock);
+  }
+
+  void x_spsc_wait_readable(XSpscQueue* q)
+  {
+    if (q->cached_head != q->tail)
+      return;
+
+    x_thread_mutex_lock(q->lock);
+    x_atomic_exchange_i32(&q->consumer_waiting, 1);
+    while ((q->cached_head = x_atomic_load_i64(&q->head)) == q->tail)
+      x_thread_condvar_wait(q->cv, q->lock);
+    x_atomic_store_i32(&q->consumer_waiting, 0);
+    x_thread_mutex_unlock(q->lock);
+  }
+
+  void x_spsc_push(XSpscQueue* q, const void* item)
+  {
+    while (!x_spsc_try_push(q, item))
+      x_spsc_wait_writable(q);
+  }
+
+  void x_spsc_pop(XSpscQueue* q, void* out)
+  {
+    while (!x_spsc_try_pop(q, out))
+      x_spsc_wait_readable(q);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Thread pool
+  // ---------------------------------------------------------------------------
+
+#define THREADPOOL_MAGIC 0xDEADBEEF
+
+#ifndef STDX_THREADPOOL_QUEUE_CAPACITY
+#define STDX_THREADPOOL_QUEUE_CAPACITY 4096
+#endif
+
+#ifndef STDX_THREADPOOL_SPAWN_WAIT_US
+#define STDX_THREADPOOL_SPAWN_WAIT_US 2000
+#endif
+
+#ifndef STDX_THREADPOOL_IDLE_TIMEOUT_MS
+#define STDX_THREADPOOL_IDLE_TIMEOUT_MS 5000
+#endif
+
+#define X_THREADPOOL_WORKER_FREE    0
+#define X_THREADPOOL_WORKER_RUNNING 1
+#define X_THREADPOOL_WORKER_EXITED  2   // Returned, waiting to be joined
+
+#define X_THREADPOOL_MAX_NODES 64
+
+  // A group of workers sharing a queue. Without numa_aware there is one
+  // node holding every worker.
+  typedef struct
+  {
+    XMpmcQueue* queue;
+    XCpuSet cpus;                   // Empty when the node's CPUs are unknown
+    int num_cpus;
+  } XThreadPoolNode;
+
+  struct XTask_t
+  {
+    XThreadTask_fn fn;
+    void* arg;
+    XThreadTask_fn cancel_fn;
+    XTaskGroup* group;
+    XCancelToken* token;
+    uint64_t enqueued_ns;
+    uint64_t deadline_ns;
+  };
+
+  static void x_taskgroup_done(XTaskGroup* group);
+
+  static inline void x_task_init(XTask* task, XThreadTask_fn fn, void* arg)
+  {
+    memset(task, 0, sizeof(*task));
+    task->fn = fn;
+    task->arg = arg;
+  }
+
+  struct XCancelToken_t
+  {
+    volatile int32_t cancelled;
+    volatile int32_t refs;
+  };
+
+  XCancelToken* x_cancel_token_create(void)
+  {
+    XCancelToken* token = calloc(1, sizeof(XCancelToken));
+    if (token)
+      token->refs = 1;
+    return token;
+  }
+
+  void x_cancel_token_cancel(XCancelToken* token)
+  {
+    if (token)
+      x_atomic_store_i32(&token->cancelled, 1);
+  }
+
+  bool x_cancel_token_is_cancelled(XCancelToken* token)
+  {
+    return token && x_atomic_load_i32(&token->cancelled) != 0;
+  }
+
+  static inline void x_cancel_token_retain(XCancelToken* token)
+  {
+    x_atomic_add_i32(&token->refs, 1);
+  }
+
+  void x_cancel_token_destroy(XCancelToken* token)
+  {
+    if (token && x_atomic_add_i32(&token->refs, -1) == 1)
+      free(token);
+  }
+
+  typedef struct XTimerWheel_t XTimerWheel;
+  static void x_threadpool_timers_stop(XThreadPool* pool);
+
+  // Worker counters are single-writer, so updates are plain load + store
+  // pairs; atomics only keep the readers of threadpool_stats() tear free.
+  typedef struct
+  {
+    XThreadPool* pool;
+    XThread* thread;
+    volatile int32_t state;         // X_THREADPOOL_WORKER_*, changed under pool->lock
+    int32_t blocking_depth;         // Only touched by the worker itself
+    int node;
+    int cpu;                        // Pinned CPU or -1
+    int slot;
+    volatile int64_t task_start_ns; // 0 while not running a task
+    volatile int64_t tasks_executed;
+    volatile int64_t busy_ns;
+    volatile int64_t idle_ns;
+    volatile int64_t waits;
+    volatile int64_t steals;
+    volatile int64_t cancelled;
+    volatile int64_t expired;
+    volatile int64_t latency[X_THREADPOOL_LATENCY_BUCKETS];
+    char pad[X_CACHE_LINE_SIZE];    // Keeps neighbouring workers off this line
+  } XThreadPoolWorker;
+
+  struct XThreadPool_t
+  {
+    uint32_t magic;
+    XThreadPoolWorker* workers;     // max_threads slots
+    int min_threads;
+    int max_threads;
+    volatile int32_t num_threads;   // Live workers, changed under lock
+    volatile int32_t blocked;       // Live workers inside a blocking section
+    uint64_t spawn_wait_ns;
+    uint32_t idle_timeout_ms;
+    volatile int64_t next_stall_check_ns;
+    volatile int64_t spawned;
+    volatile int64_t retired;
+    size_t stack_size;
+    char name[16];
+
+    XThreadPoolNode* nodes;
+    int num_nodes;
+
+    XMutex* lock;
+    XCondVar* cv;
+    volatile int32_t idle;          // Workers parked (or about to park) on cv
+    volatile int32_t stop;
+    volatile int32_t discard;       // Shutdown: drop queued tasks instead of running them
+    volatile int64_t discarded;
+    volatile int64_t cancelled;     // Drops by threads that are not workers of this pool
+    volatile int64_t expired;
+
+    XMutex* group_lock;             // Shared by every task group waiter
+    XCondVar* group_cv;
+
+    XTimerWheel* volatile timers;   // Created on the first scheduled timer
+  };
+
+  static X_THREAD_LOCAL XThreadPool* x_tls_current_pool = NULL;
+  static X_THREAD_LOCAL XThreadPoolWorker* x_tls_current_worker = NULL;
+  static X_THREAD_LOCAL XCancelToken* x_tls_current_token = NULL;
+
+  static inline void x_threadpool_counter_add(volatile int64_t* counter, int64_t value)
+  {
+    x_atomic_store_i64(counter, x_atomic_load_i64(counter) + value);
+  }
+
+  static inline int x_threadpool_latency_bucket(uint64_t ns)
+  {
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    if (us) bucket = 64 - __builtin_clzll(us);
+#else
+    while (us) { bucket++; us >>= 1; }
+#endif
+    return bucket < X_THREADPOOL_LATENCY_BUCKETS ? bucket : X_THREADPOOL_LATENCY_BUCKETS - 1;
+  }
+
+  static void* thread_main(void* arg);
+
+  // Run a dequeued task, or drop it if its token was cancelled, its deadline
+  // passed or the pool is shutting down without draining. Either way the
+  // task is finished on return. Returns true if fn ran.
+  static bool x_threadpool_execute(XThreadPool* pool, XThreadPoolWorker* worker, XTask* task, uint64_t now)
+  {
+    volatile int64_t* dropped = NULL;
+    if (x_atomic_load_i32(&pool->discard))
+      dropped = &pool->discarded;
+    else if (task->token && x_atomic_load_i32(&task->token->cancelled))
+      dropped = worker ? &worker->cancelled : &pool->cancelled;
+    else if (task->deadline_ns && now > task->deadline_ns)
+      dropped = worker ? &worker->expired : &pool->expired;
+
+    if (!dropped)
+    {
+      XCancelToken* previous = x_tls_current_token;
+      x_tls_current_token = task->token;
+      task->fn(task->arg);
+      x_tls_current_token = previous;
+    }
+    else
+    {
+      if (task->cancel_fn)
+        task->cancel_fn(task->arg);
+      if (worker && dropped != &pool->discarded)
+        x_threadpool_counter_add(dropped, 1);
+      else
+        x_atomic_add_i64(dropped, 1);
+    }
+
+    if (task->group)
+      x_taskgroup_done(task->group);
+    if (task->token)
+      x_cancel_token_destroy(task->token);
+    return dropped == NULL;
+  }
+
+  static int x_threadpool_start_worker(XThreadPool* pool, XThreadPoolWorker* w)
+  {
+    XThreadAttr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.stack_size = pool->stack_size;
+
+    char name[32];
+    if (pool->name[0])
+    {
+      snprintf(name, sizeof(name), "%s-%d", pool->name, w->slot);
+      attr.name = name;
+    }
+
+    XThreadPoolNode* node = &pool->nodes[w->node];
+    if (w->cpu >= 0)
+      x_cpuset_add(&attr.affinity, w->cpu);
+    else if (pool->num_nodes > 1)
+      attr.affinity = node->cpus;
+
+    return x_thread_create_ex(&w->thread, &attr, thread_main, w);
+  }
+
+  // Take from the worker's own node first, then steal from the others
+  static inline bool x_threadpool_pop(XThreadPool* pool, XThreadPoolWorker* worker, XTask* task)
+  {
+    if (x_mpmc_try_pop(pool->nodes[worker->node].queue, task))
+      return true;
+
+    for (int i = 1; i < pool->num_nodes; ++i)
+    {
+      if (x_mpmc_try_pop(pool->nodes[(worker->node + i) % pool->num_nodes].queue, task))
+      {
+        x_threadpool_counter_add(&worker->steals, 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Start one more worker if the pool is below max_threads. Slots of retired
+  // workers are reused; their threads are joined here, outside the lock.
+  static bool x_threadpool_grow(XThreadPool* pool)
+  {
+    if (x_atomic_load_i32(&pool->num_threads) >= pool->max_threads)
+      return false;
+
+    XThread* reap = NULL;
+    bool grown = false;
+
+    x_thread_mutex_lock(pool->lock);
+    if (!x_atomic_load_i32(&pool->stop) && pool->num_threads < pool->max_threads)
+    {
+      for (int i = 0; i < pool->max_threads; ++i)
+      {
+        XThreadPoolWorker* w = &pool->workers[i];
+        if (w->state == X_THREADPOOL_WORKER_RUNNING)
+          continue;
+
+        XThread* previous = w->thread;
+        x_atomic_store_i32(&w->state, X_THREADPOOL_WORKER_RUNNING);
+        if (x_threadpool_start_worker(pool, w) != 0)
+        {
+          w->thread = previous;
+          x_atomic_store_i32(&w->state, previous ? X_THREADPOOL_WORKER_EXITED : X_THREADPOOL_WORKER_FREE);
+          break;
+        }
+
+        reap = previous;
+        x_atomic_add_i32(&pool->num_threads, 1);
+        x_atomic_add_i64(&pool->spawned, 1);
+        grown = true;
+        break;
+      }
+    }
+    x_thread_mutex_unlock(pool->lock);
+
+    if (reap)
+    {
+      x_thread_join(reap);
+      x_thread_destroy(reap);
+    }
+    return grown;
+  }
+
+  // Enqueue side check for workers stuck in long tasks that never came back
+  // to the queue. Runs at most once per spawn_wait_ns and only while no
+  // worker is idle and the pool may still grow.
+  static void x_threadpool_check_stall(XThreadPool* pool)
+  {
+    if (x_atomic_load_i32(&pool->num_threads) >= pool->max_threads || x_atomic_load_i32(&pool->idle) > 0)
+      return;
+
+    int64_t now = (int64_t) x_thread_time_ns();
+    int64_t next = x_atomic_load_i64(&pool->next_stall_check_ns);
+    if (now < next || !x_atomic_cas_i64(&pool->next_stall_check_ns, &next, now + (int64_t) pool->spawn_wait_ns))
+      return;
+
+    for (int i = 0; i < pool->max_threads; ++i)
+    {
+      XThreadPoolWorker* w = &pool->workers[i];
+      if (x_atomic_load_i32(&w->state) != X_THREADPOOL_WORKER_RUNNING)
+        continue;
+      int64_t started = x_atomic_load_i64(&w->task_start_ns);
+      if (started == 0 || now - started < (int64_t) pool->spawn_wait_ns)
+        return; // Someone is making progress
+    }
+    x_threadpool_grow(pool);
+  }
+
+  static void* thread_main(void* arg)
+  {
+    XThreadPoolWorker* worker = (XThreadPoolWorker*)arg;
+    XThreadPool* pool = worker->pool;
+    x_tls_current_pool = pool;
+    x_tls_current_worker = worker;
+    XTask task;
+    uint64_t last_end = x_thread_time_ns();
+    bool retire = false;
+
+    while (1)
+    {
+      bool got = false;
+      for (int i = 0; i < X_MPMC_SPIN_COUNT && !got; ++i)
+      {
+        got = x_threadpool_pop(pool, worker, &task);
+        if (!got) x_cpu_relax();
+      }
+
+      if (!got)
+      {
+        x_thread_mutex_lock(pool->lock);
+        x_atomic_add_i32(&pool->idle, 1);
+        uint64_t parked_at = x_thread_time_ns();
+        while (!(got = x_threadpool_pop(pool, worker, &task)) && !x_atomic_load_i32(&pool->stop))
+        {
+          x_threadpool_counter_add(&worker->waits, 1);
+          if (pool->num_threads <= pool->min_threads)
+          {
+            x_thread_condvar_wait(pool->cv, pool->lock);
+            continue;
+          }
+
+          // Extra worker: retire once idle for long enough
+          uint64_t idle_ms = (x_thread_time_ns() - parked_at) / 1000000ull;
+          if (idle_ms >= pool->idle_timeout_ms)
+          {
+            retire = true;
+            break;
+          }
+          x_thread_condvar_wait_timeout(pool->cv, pool->lock, (int)(pool->idle_timeout_ms - idle_ms));
+        }
+        x_atomic_add_i32(&pool->idle, -1);
+        if (retire)
+        {
+          x_atomic_add_i32(&pool->num_threads, -1);
+          x_atomic_add_i64(&pool->retired, 1);
+          x_atomic_store_i32(&worker->state, X_THREADPOOL_WORKER_EXITED);
+        }
+        x_thread_mutex_unlock(pool->lock);
+      }
+
+      // Queued tasks are drained before the worker honors stop
+      if (!got)
+        break;
+
+      uint64_t start = x_thread_time_ns();
+      if (start > task.enqueued_ns + pool->spawn_wait_ns
+        && x_atomic_load_i32(&pool->idle) == 0
+        && x_atomic_load_i32(&pool->num_threads) < pool->max_threads)
+        x_threadpool_grow(pool);
+
+      x_atomic_store_i64(&worker->task_start_ns, (int64_t) start);
+      bool ran = x_threadpool_execute(pool, worker, &task, start);
+      uint64_t end = x_thread_time_ns();
+      x_atomic_store_i64(&worker->task_start_ns, 0);
+      if (!ran)
+        continue;
+
+      x_threadpool_counter_add(&worker->tasks_executed, 1);
+      x_threadpool_counter_add(&worker->busy_ns, (int64_t)(end - start));
+      x_threadpool_counter_add(&worker->idle_ns, (int64_t)(start - last_end));
+      if (start > task.enqueued_ns)
+        x_threadpool_counter_add(&worker->latency[x_threadpool_latency_bucket(start - task.enqueued_ns)], 1);
+      else
+        x_threadpool_counter_add(&worker->latency[0], 1);
+      last_end = end;
+    }
+
+    // A retired worker must not touch its slot past this point: it may
+    // already have been handed to a new thread.
+    x_tls_current_worker = NULL;
+    x_tls_current_pool = NULL;
+    return NULL;
+  }
+
+  // Build the worker groups. Real NUMA nodes come from the OS; asking for a
+  // different number of groups splits the CPUs into contiguous chunks instead.
+  // Only CPUs in the process affinity mask are used, so pinned workers never
+  // land on a CPU that taskset or a cgroup took away.
+  static int x_threadpool_layout(const XThreadPoolConfig* config, XThreadPoolNode* nodes)
+  {
+    XCpuSet allowed;
+    if (x_thread_get_affinity(&allowed) != 0 || x_cpuset_count(&allowed) == 0)
+    {
+      int cpus = x_thread_cpu_count();
+      for (int i = 0; i < cpus; ++i)
+        x_cpuset_add(&allowed, i);
+    }
+
+    XCpuSet all;
+    x_cpuset_zero(&all);
+
+    if (config->numa_aware)
+    {
+      XCpuSet detected[X_THREADPOOL_MAX_NODES];
+      int count = x_thread_numa_nodes(detected, X_THREADPOOL_MAX_NODES);
+      int usable = 0;
+      for (int i = 0; i < count; ++i)
+      {
+        for (int w = 0; w < X_THREAD_MAX_CPUS / 64; ++w)
+          detected[i].bits[w] &= allowed.bits[w];
+        if (x_cpuset_count(&detected[i]) > 0)
+          detected[usable++] = detected[i];
+      }
+
+      if (usable > 0 && (config->numa_nodes <= 0 || config->numa_nodes == usable))
+      {
+        for (int i = 0; i < usable; ++i)
+          nodes[i].cpus = detected[i];
+        return usable;
+      }
+
+      for (int i = 0; i < usable; ++i)
+        for (int w = 0; w < X_THREAD_MAX_CPUS / 64; ++w)
+          all.bits[w] |= detected[i].bits[w];
+    }
+
+    if (x_cpuset_count(&all) == 0)
+      all = allowed;
+
+    int groups = 1;
+    if (config->numa_aware && config->numa_nodes > 0)
+      groups = config->numa_nodes < X_THREADPOOL_MAX_NODES ? config->numa_nodes : X_THREADPOOL_MAX_NODES;
+
+    int total = x_cpuset_count(&all);
+    for (int g = 0; g < groups; ++g)
+    {
+      x_cpuset_zero(&nodes[g].cpus);
+      for (int i = g * total / groups; i < (g + 1) * total / groups; ++i)
+        x_cpuset_add(&nodes[g].cpus, x_cpuset_nth(&all, i));
+    }
+    return groups;
+  }
+
+  // Runs pinned to a node so the queue's pages are first touched, and thus
+  // placed, on that node.
+  static void* x_threadpool_node_init(void* arg)
+  {
+    XThreadPoolNode* node = (XThreadPoolNode*) arg;
+    node->queue = x_mpmc_create(sizeof(XTask), STDX_THREADPOOL_QUEUE_CAPACITY);
+    return NULL;
+  }
+
+  static void x_threadpool_free(XThreadPool* pool)
+  {
+    for (int i = 0; i < pool->num_nodes; ++i)
+      x_mpmc_destroy(pool->nodes[i].queue);
+    free(pool->nodes);
+    free(pool->workers);
+    if (pool->lock) x_thread_mutex_destroy(pool->lock);
+    if (pool->cv) x_thread_condvar_destroy(pool->cv);
+    if (pool->group_lock) x_thread_mutex_destroy(pool->group_lock);
+    if (pool->group_cv) x_thread_condvar_destroy(pool->group_cv);
+    free(pool);
+  }
+
+  XThreadPool* threadpool_create_ex(const XThreadPoolConfig* config)
+  {
+    if (!config || config->min_threads <= 0)
+      return NULL;
+
+    int max_threads = config->max_threads > config->min_threads ? config->max_threads : config->min_threads;
+
+    XThreadPool* pool = calloc(1, sizeof(XThreadPool));
+    pool->nodes = calloc(X_THREADPOOL_MAX_NODES, sizeof(XThreadPoolNode));
+    pool->num_nodes = x_threadpool_layout(config, pool->nodes);
+
+    for (int i = 0; i < pool->num_nodes; ++i)
+    {
+      XThreadPoolNode* node = &pool->nodes[i];
+      node->num_cpus = x_cpuset_count(&node->cpus);
+
+      XThread* init = NULL;
+      XThreadAttr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.affinity = node->cpus;
+      if (pool->num_nodes > 1 && node->num_cpus > 0 && x_thread_create_ex(&init, &attr, x_threadpool_node_init, node) == 0)
+      {
+        x_thread_join(init);
+        x_thread_destroy(init);
+      }
+      else
+      {
+        x_threadpool_node_init(node);
+      }
+
+      if (!node->queue)
+      {
+        x_threadpool_free(pool);
+        return NULL;
+      }
+    }
+
+    pool->min_threads = config->min_threads;
+    pool->max_threads = max_threads;
+    pool->spawn_wait_ns = (uint64_t)(config->spawn_wait_us ? config->spawn_wait_us : STDX_THREADPOOL_SPAWN_WAIT_US) * 1000ull;
+    pool->idle_timeout_ms = config->idle_timeout_ms ? config->idle_timeout_ms : STDX_THREADPOOL_IDLE_TIMEOUT_MS;
+    pool->stack_size = config->stack_size;
+    if (config->name)
+      strncpy(pool->name, config->name, sizeof(pool->name) - 1);
+    pool->workers = calloc(max_threads, sizeof(XThreadPoolWorker));
+    x_thread_mutex_init(&pool->lock);
     x_thread_condvar_init(&pool->cv);
+    x_thread_mutex_init(&pool->group_lock);
+    x_thread_condvar_init(&pool->group_cv);
+
+    // Slots are dealt round robin over the nodes, and over each node's CPUs
+    for (int i = 0; i < max_threads; ++i)
+    {
+      XThreadPoolWorker* w = &pool->workers[i];
+      w->pool = pool;
+      w->slot = i;
+      w->node = i % pool->num_nodes;
+      XThreadPoolNode* node = &pool->nodes[w->node];
+      w->cpu = config->pin_workers && node->num_cpus > 0
+        ? x_cpuset_nth(&node->cpus, (i / pool->num_nodes) % node->num_cpus)
+        : -1;
+    }
+
+    x_thread_mutex_lock(pool->lock);
+    for (int i = 0; i < config->min_threads; ++i)
+    {
+      pool->workers[i].state = X_THREADPOOL_WORKER_RUNNING;
+      x_threadpool_start_worker(pool, &pool->workers[i]);
+    }
+    pool->num_threads = config->min_threads;
+    x_thread_mutex_unlock(pool->lock);
+
+    pool->magic = THREADPOOL_MAGIC;
+    return pool;
+  }
+
+  XThreadPool* threadpool_create(int num_threads)
+  {
+    XThreadPoolConfig config = { 0 };
+    config.min_threads = num_threads;
+    config.max_threads = num_threads;
+    return threadpool_create_ex(&config);
+  }
+
+  void threadpool_blocking_begin(void)
+  {
+    XThreadPoolWorker* worker = x_tls_current_worker;
+    if (!worker || worker->blocking_depth++ > 0)
+      return;
+
+    XThreadPool* pool = worker->pool;
+    x_atomic_add_i32(&pool->blocked, 1);
+    x_atomic_fence();
+    if (x_atomic_load_i32(&pool->idle) == 0)
+      x_threadpool_grow(pool);
+  }
+
+  void threadpool_blocking_end(void)
+  {
+    XThreadPoolWorker* worker = x_tls_current_worker;
+    if (!worker || worker->blocking_depth == 0 || --worker->blocking_depth > 0)
+      return;
+
+    // The pool may now run more workers than it needs; the extra ones retire
+    // after idle_timeout_ms.
+    x_atomic_add_i32(&worker->pool->blocked, -1);
+  }
+
+  int threadpool_num_nodes(XThreadPool* pool)
+  {
+    return pool ? pool->num_nodes : 0;
+  }
+
+  int threadpool_current_node(void)
+  {
+    return x_tls_current_worker ? x_tls_current_worker->node : -1;
+  }
+
+  static X_THREAD_LOCAL uint32_t x_tls_submit_node = 0;
+
+  static void x_threadpool_wake(XThreadPool* pool, int count);
+
+  // node < 0 picks the calling worker's node, or rotates for outside threads
+  static void x_threadpool_push(XThreadPool* pool, XTask* task, int node)
+  {
+    task->enqueued_ns = x_thread_time_ns();
+    if (node < 0 || node >= pool->num_nodes)
+    {
+      if (pool->num_nodes == 1)
+        node = 0;
+      else if (x_tls_current_pool == pool)
+        node = x_tls_current_worker->node;
+      else
+        node = (int)(x_tls_submit_node++ % (uint32_t) pool->num_nodes);
+    }
+
+    // A full node queue spills into the next node's
+    for (int i = 0; i < pool->num_nodes; ++i)
+      if (x_mpmc_push_nowake(pool->nodes[(node + i) % pool->num_nodes].queue, task))
+        return;
+
+    // Every queue is full. A worker of this pool must not wait for space
+    // that only the workers can make, so it runs the task itself.
+    if (x_tls_current_pool == pool)
+    {
+      x_threadpool_execute(pool, x_tls_current_worker, task, task->enqueued_ns);
+      return;
+    }
+
+    // Anyone else parks on its node's queue until a worker pops from it.
+    // Callers may push a batch before waking anyone, so wake them first.
+    x_threadpool_wake(pool, pool->max_threads);
+    x_mpmc_push(pool->nodes[node].queue, task);
+  }
+
+  static void x_threadpool_wake(XThreadPool* pool, int count)
+  {
+    x_atomic_fence();
+    int idle = x_atomic_load_i32(&pool->idle);
+    if (idle <= 0)
+      return;
+
+    x_thread_mutex_lock(pool->lock);
+    if (count >= idle)
+      x_thread_condvar_broadcast(pool->cv);
+    else
+      while (count-- > 0)
+        x_thread_condvar_signal(pool->cv);
+    x_thread_mutex_unlock(pool->lock);
+  }
+
+  static int x_threadpool_submit(XThreadPool* pool, XTask* task, int node)
+  {
+    x_threadpool_push(pool, task, node);
+    x_threadpool_wake(pool, 1);
+    if (pool->max_threads > pool->min_threads)
+      x_threadpool_check_stall(pool);
+    return 0;
+  }
+
+  int threadpool_enqueue_on_node(XThreadPool* pool, int node, XThreadTask_fn fn, void* arg)
+  {
+    if (!fn || !pool || pool->magic != THREADPOOL_MAGIC) return -1;
+
+    XTask task;
+    x_task_init(&task, fn, arg);
+    return x_threadpool_submit(pool, &task, node);
+  }
+
+  int threadpool_enqueue(XThreadPool* pool, XThreadTask_fn fn, void* arg)
+  {
+    return threadpool_enqueue_on_node(pool, -1, fn, arg);
+  }
+
+  int threadpool_enqueue_ex(XThreadPool* pool, XThreadTask_fn fn, void* arg, const XTaskOptions* options)
+  {
+    if (!fn || !pool || pool->magic != THREADPOOL_MAGIC) return -1;
 
-    for (int i = 0; i < num_threads; ++i)
+    XTask task;
+    x_task_init(&task, fn, arg);
+    if (options)
     {
-      x_thread_create(&pool->threads[i], thread_main, pool);
+      task.cancel_fn = options->cancel_fn;
+      task.deadline_ns = options->deadline_ns;
+      task.token = options->token;
+      if (task.token)
+        x_cancel_token_retain(task.token);
     }
-    pool->magic = THREADPOOL_MAGIC;
-    return pool;
+    return x_threadpool_submit(pool, &task, -1);
   }
 
-  int threadpool_enqueue(XThreadPool* pool, XThreadTask_fn fn, void* arg)
+  XCancelToken* threadpool_current_token(void)
   {
-    if (!fn || !pool || pool->magic != THREADPOOL_MAGIC) return -1;
+    return x_tls_current_token;
+  }
 
-    XTask* task = malloc(sizeof(XTask));
-    task->fn = fn;
-    task->arg = arg;
-    task->next = NULL;
+  static uint32_t x_threadpool_queued(XThreadPool* pool)
+  {
+    uint32_t queued = 0;
+    for (int i = 0; i < pool->num_nodes; ++i)
+      queued += (uint32_t) x_mpmc_count(pool->nodes[i].queue);
+    return queued;
+  }
+
+  void threadpool_destroy(XThreadPool* pool)
+  {
+    threadpool_destroy_ex(pool, -1);
+  }
+
+  int threadpool_destroy_ex(XThreadPool* pool, int drain_timeout_ms)
+  {
+    if (!pool) return 0;
+
+    x_threadpool_timers_stop(pool);
+
+    if (drain_timeout_ms == 0)
+      x_atomic_store_i32(&pool->discard, 1);
 
     x_thread_mutex_lock(pool->lock);
-    if (pool->tail)
+    x_atomic_store_i32(&pool->stop, 1);
+    pool->magic = 0;
+    x_thread_condvar_broadcast(pool->cv);
+    x_thread_mutex_unlock(pool->lock);
+
+    // Workers drain the queues before exiting; past the timeout they switch
+    // to dropping whatever is left.
+    if (drain_timeout_ms > 0)
+    {
+      uint64_t deadline = x_thread_time_ns() + (uint64_t) drain_timeout_ms * 1000000ull;
+      while (x_threadpool_queued(pool) > 0 && x_thread_time_ns() < deadline)
+        x_thread_sleep_ms(1);
+      x_atomic_store_i32(&pool->discard, 1);
+    }
+
+    // No worker can be started once stop is set, so every slot is final
+    for (int i = 0; i < pool->max_threads; ++i)
     {
-      pool->tail->next = task;
-      pool->tail = task;
-    } else
+      if (!pool->workers[i].thread)
+        continue;
+      x_thread_join(pool->workers[i].thread);
+      x_thread_destroy(pool->workers[i].thread);
+    }
+
+    int discarded = (int) x_atomic_load_i64(&pool->discarded);
+    x_threadpool_free(pool);
+    return discarded;
+  }
+
+  int threadpool_stats(XThreadPool* pool, XThreadPoolStats* stats, XThreadPoolWorkerStats* workers, int max_workers)
+  {
+    if (!pool || !stats || pool->magic != THREADPOOL_MAGIC) return -1;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->num_workers = x_atomic_load_i32(&pool->num_threads);
+    stats->max_workers = pool->max_threads;
+    stats->blocked_workers = x_atomic_load_i32(&pool->blocked);
+    stats->num_nodes = pool->num_nodes;
+    for (int i = 0; i < pool->num_nodes; ++i)
     {
-      pool->head = pool->tail = task;
+      stats->queue_depth += (uint32_t) x_mpmc_count(pool->nodes[i].queue);
+      stats->queue_capacity += (uint32_t) x_mpmc_capacity(pool->nodes[i].queue);
     }
-    x_thread_condvar_signal(pool->cv);
-    x_thread_mutex_unlock(pool->lock);
+    stats->workers_spawned = (uint64_t) x_atomic_load_i64(&pool->spawned);
+    stats->workers_retired = (uint64_t) x_atomic_load_i64(&pool->retired);
+    stats->tasks_cancelled = (uint64_t) x_atomic_load_i64(&pool->cancelled);
+    stats->tasks_expired = (uint64_t) x_atomic_load_i64(&pool->expired);
+    stats->tasks_discarded = (uint64_t) x_atomic_load_i64(&pool->discarded);
+
+    for (int i = 0; i < pool->max_threads; ++i)
+    {
+      XThreadPoolWorker* w = &pool->workers[i];
+      XThreadPoolWorkerStats ws;
+      ws.tasks_executed = (uint64_t) x_atomic_load_i64(&w->tasks_executed);
+      ws.busy_ns = (uint64_t) x_atomic_load_i64(&w->busy_ns);
+      ws.idle_ns = (uint64_t) x_atomic_load_i64(&w->idle_ns);
+      ws.waits = (uint64_t) x_atomic_load_i64(&w->waits);
+      ws.steals = (uint64_t) x_atomic_load_i64(&w->steals);
+      ws.tasks_cancelled = (uint64_t) x_atomic_load_i64(&w->cancelled);
+      ws.tasks_expired = (uint64_t) x_atomic_load_i64(&w->expired);
+      ws.node = w->node;
+      ws.cpu = w->cpu;
+
+      stats->tasks_executed += ws.tasks_executed;
+      stats->busy_ns += ws.busy_ns;
+      stats->idle_ns += ws.idle_ns;
+      stats->waits += ws.waits;
+      stats->steals += ws.steals;
+      stats->tasks_cancelled += ws.tasks_cancelled;
+      stats->tasks_expired += ws.tasks_expired;
+      for (int b = 0; b < X_THREADPOOL_LATENCY_BUCKETS; ++b)
+        stats->latency_histogram[b] += (uint64_t) x_atomic_load_i64(&w->latency[b]);
+
+      if (workers && i < max_workers)
+        workers[i] = ws;
+    }
+    return pool->max_threads;
+  }
+
+  uint64_t threadpool_stats_latency_percentile(const XThreadPoolStats* stats, double percentile)
+  {
+    uint64_t total = 0;
+    for (int b = 0; b < X_THREADPOOL_LATENCY_BUCKETS; ++b)
+      total += stats->latency_histogram[b];
+    if (total == 0)
+      return 0;
+
+    if (percentile < 0.0) percentile = 0.0;
+    if (percentile > 100.0) percentile = 100.0;
+    uint64_t rank = (uint64_t)((double) total * percentile / 100.0);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    int b = 0;
+    for (; b < X_THREADPOOL_LATENCY_BUCKETS - 1; ++b)
+    {
+      seen += stats->latency_histogram[b];
+      if (seen >= rank)
+        break;
+    }
+    return (1ull << b) * 1000ull;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Task groups
+  // ---------------------------------------------------------------------------
+
+  struct XTaskGroup_t
+  {
+    XThreadPool* pool;
+    volatile int32_t pending;       // Tasks queued or running
+    volatile int32_t completing;    // Finishers that may still touch the group
+    volatile int32_t waiters;       // Threads parked on pool->group_cv
+  };
+
+  // The last finisher wakes parked waiters. `completing` brackets every
+  // access a finisher makes, so a waiter that saw pending reach zero knows
+  // when it may return and let the group be destroyed.
+  static void x_taskgroup_done(XTaskGroup* group)
+  {
+    x_atomic_add_i32(&group->completing, 1);
+    if (x_atomic_add_i32(&group->pending, -1) == 1)
+    {
+      x_atomic_fence();
+      if (x_atomic_load_i32(&group->waiters) > 0)
+      {
+        XThreadPool* pool = group->pool;
+        x_thread_mutex_lock(pool->group_lock);
+        x_thread_condvar_broadcast(pool->group_cv);
+        x_thread_mutex_unlock(pool->group_lock);
+      }
+    }
+    x_atomic_add_i32(&group->completing, -1);
+  }
+
+  XTaskGroup* x_taskgroup_create(XThreadPool* pool)
+  {
+    if (!pool || pool->magic != THREADPOOL_MAGIC) return NULL;
+    XTaskGroup* group = calloc(1, sizeof(XTaskGroup));
+    if (group)
+      group->pool = pool;
+    return group;
+  }
 
+  int x_taskgroup_run(XTaskGroup* group, XThreadTask_fn fn, void* arg)
+  {
+    if (!group || !fn || group->pool->magic != THREADPOOL_MAGIC) return -1;
+
+    XTask task;
+    x_task_init(&task, fn, arg);
+    task.group = group;
+    x_atomic_add_i32(&group->pending, 1);
+    x_threadpool_push(group->pool, &task, -1);
+    x_threadpool_wake(group->pool, 1);
     return 0;
   }
 
-  void threadpool_destroy(XThreadPool* pool)
+  int x_taskgroup_pending(XTaskGroup* group)
+  {
+    return group ? x_atomic_load_i32(&group->pending) : 0;
+  }
+
+  // Pop any pool task for a helping thread. Workers keep their node order.
+  static bool x_threadpool_try_pop(XThreadPool* pool, XThreadPoolWorker* worker, XTask* task)
+  {
+    if (worker)
+      return x_threadpool_pop(pool, worker, task);
+    for (int i = 0; i < pool->num_nodes; ++i)
+      if (x_mpmc_try_pop(pool->nodes[i].queue, task))
+        return true;
+    return false;
+  }
+
+  void x_taskgroup_wait(XTaskGroup* group)
+  {
+    if (!group) return;
+
+    XThreadPool* pool = group->pool;
+    XThreadPoolWorker* worker = x_tls_current_pool == pool ? x_tls_current_worker : NULL;
+    XTask task;
+
+    while (x_atomic_load_i32(&group->pending) > 0)
+    {
+      // Help first: run whatever the pool has queued, ours or not
+      bool got = false;
+      for (int i = 0; i < X_MPMC_SPIN_COUNT && !got; ++i)
+      {
+        got = x_threadpool_try_pop(pool, worker, &task);
+        if (!got)
+        {
+          if (x_atomic_load_i32(&group->pending) == 0)
+            break;
+          x_cpu_relax();
+        }
+      }
+
+      if (got)
+      {
+        uint64_t start = x_thread_time_ns();
+        if (!x_threadpool_execute(pool, worker, &task, start))
+          continue;
+        if (worker)
+        {
+          x_threadpool_counter_add(&worker->tasks_executed, 1);
+          x_threadpool_counter_add(&worker->latency[x_threadpool_latency_bucket(start > task.enqueued_ns ? start - task.enqueued_ns : 0)], 1);
+        }
+        continue;
+      }
+
+      if (x_atomic_load_i32(&group->pending) == 0)
+        break;
+
+      // Our remaining tasks are running elsewhere. Park, but look at the
+      // queue again every millisecond in case they fork more work. An
+      // elastic pool may start a worker to cover for us meanwhile.
+      if (worker)
+        threadpool_blocking_begin();
+      x_thread_mutex_lock(pool->group_lock);
+      x_atomic_add_i32(&group->waiters, 1);
+      if (x_atomic_load_i32(&group->pending) > 0)
+        x_thread_condvar_wait_timeout(pool->group_cv, pool->group_lock, 1);
+      x_atomic_add_i32(&group->waiters, -1);
+      x_thread_mutex_unlock(pool->group_lock);
+      if (worker)
+        threadpool_blocking_end();
+    }
+
+    while (x_atomic_load_i32(&group->completing) > 0)
+      x_cpu_relax();
+  }
+
+  void x_taskgroup_destroy(XTaskGroup* group)
+  {
+    if (!group) return;
+    x_taskgroup_wait(group);
+    free(group);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Thread pool timers
+  // ---------------------------------------------------------------------------
+  //
+  // Hierarchical timing wheel with 1 ms ticks: level 0 holds the next 64
+  // ticks, each higher level covers 64 times the span of the one below.
+  // Entries are moved down a level when the wheel below wraps around, so
+  // scheduling, cancelling and firing are all O(1).
+
+#define X_TIMER_WHEEL_BITS    6
+#define X_TIMER_WHEEL_SIZE    (1 << X_TIMER_WHEEL_BITS)
+#define X_TIMER_WHEEL_MASK    (X_TIMER_WHEEL_SIZE - 1)
+#define X_TIMER_WHEEL_LEVELS  5
+#define X_TIMER_NONE          -1
+
+  typedef struct
+  {
+    XThreadTask_fn fn;
+    void* arg;
+    uint64_t expires;               // Tick this timer is due
+    uint32_t period;                // Ticks between firings, 0 for one-shot
+    uint32_t generation;            // Bumped on release so stale ids don't match
+    int32_t prev;
+    int32_t next;                   // Next entry in the slot, or in the free list
+    int8_t level;                   // X_TIMER_NONE when not in the wheel
+    uint8_t slot;
+  } XTimerEntry;
+
+  struct XTimerWheel_t
+  {
+    XMutex* lock;
+    XCondVar* cv;
+    XThread* thread;
+    XThreadPool* pool;
+    bool stop;
+
+    uint64_t base_ns;
+    uint64_t current;               // Last processed tick
+    int32_t slots[X_TIMER_WHEEL_LEVELS][X_TIMER_WHEEL_SIZE];
+    int32_t pending;                // Timers in the wheel
+    int32_t level_pending[X_TIMER_WHEEL_LEVELS];
+
+    XTimerEntry* entries;
+    int32_t capacity;
+    int32_t free_list;
+
+    XTask* batch;
+    int batch_count;
+    int batch_capacity;
+  };
+
+  static void x_timer_link(XTimerWheel* w, int32_t index)
+  {
+    XTimerEntry* e = &w->entries[index];
+    uint64_t delta = e->expires > w->current ? e->expires - w->current : 1;
+    uint64_t expires = w->current + delta;
+
+    int level = 0;
+    while (level < X_TIMER_WHEEL_LEVELS - 1 && delta >= ((uint64_t) 1 << (X_TIMER_WHEEL_BITS * (level + 1))))
+      level++;
+
+    // Beyond the top level's range the entry parks in the farthest slot and
+    // is re-linked when that slot cascades.
+    uint64_t range = (uint64_t) 1 << (X_TIMER_WHEEL_BITS * X_TIMER_WHEEL_LEVELS);
+    if (delta >= range)
+      expires = w->current + range - 1;
+
+    int slot = (int)((expires >> (X_TIMER_WHEEL_BITS * level)) & X_TIMER_WHEEL_MASK);
+    e->level = (int8_t) level;
+    e->slot = (uint8_t) slot;
+    e->prev = X_TIMER_NONE;
+    e->next = w->slots[level][slot];
+    if (e->next != X_TIMER_NONE)
+      w->entries[e->next].prev = index;
+    w->slots[level][slot] = index;
+    w->pending++;
+    w->level_pending[level]++;
+  }
+
+  static void x_timer_unlink(XTimerWheel* w, int32_t index)
+  {
+    XTimerEntry* e = &w->entries[index];
+    if (e->prev != X_TIMER_NONE)
+      w->entries[e->prev].next = e->next;
+    else
+      w->slots[e->level][e->slot] = e->next;
+    if (e->next != X_TIMER_NONE)
+      w->entries[e->next].prev = e->prev;
+    w->level_pending[e->level]--;
+    e->level = X_TIMER_NONE;
+    w->pending--;
+  }
+
+  static void x_timer_release(XTimerWheel* w, int32_t index)
+  {
+    XTimerEntry* e = &w->entries[index];
+    e->generation++;
+    e->level = X_TIMER_NONE;
+    e->next = w->free_list;
+    w->free_list = index;
+  }
+
+  static void x_timer_fire(XTimerWheel* w, int32_t index)
+  {
+    XTimerEntry* e = &w->entries[index];
+    if (w->batch_count == w->batch_capacity)
+    {
+      int capacity = w->batch_capacity ? w->batch_capacity * 2 : 64;
+      XTask* batch = realloc(w->batch, capacity * sizeof(XTask));
+      if (!batch)
+      {
+        // Try again on the next tick rather than losing the timer
+        e->expires = w->current + 1;
+        x_timer_link(w, index);
+        return;
+      }
+      w->batch = batch;
+      w->batch_capacity = capacity;
+    }
+    x_task_init(&w->batch[w->batch_count], e->fn, e->arg);
+    w->batch_count++;
+
+    if (e->period)
+    {
+      // Periodic timers keep their phase; if we fell behind, skip the
+      // missed firings instead of bursting to catch up.
+      e->expires += e->period;
+      if (e->expires <= w->current)
+        e->expires = w->current + e->period;
+      x_timer_link(w, index);
+    }
+    else
+    {
+      x_timer_release(w, index);
+    }
+  }
+
+  // Move every entry of a higher-level slot to where it belongs now
+  static void x_timer_cascade(XTimerWheel* w, int level, int slot)
+  {
+    int32_t index = w->slots[level][slot];
+    w->slots[level][slot] = X_TIMER_NONE;
+    while (index != X_TIMER_NONE)
+    {
+      int32_t next = w->entries[index].next;
+      w->pending--;
+      w->level_pending[level]--;
+      if (w->entries[index].expires <= w->current)
+        x_timer_fire(w, index);
+      else
+        x_timer_link(w, index);
+      index = next;
+    }
+  }
+
+  static void x_timer_advance(XTimerWheel* w, uint64_t now)
+  {
+    while (w->current < now)
+    {
+      if (w->pending == 0)
+      {
+        // Nothing to cascade or fire: catch up in one step after idling
+        w->current = now;
+        break;
+      }
+      if (w->level_pending[0] == 0)
+      {
+        // The ticks before the next level 0 wrap have nothing to fire
+        uint64_t last = w->current | X_TIMER_WHEEL_MASK;
+        w->current = last < now ? last : now;
+        if (w->current == now)
+          break;
+      }
+
+      w->current++;
+
+      // Cascade from the highest wrapping level down
+      int wrapped = 0;
+      while (wrapped < X_TIMER_WHEEL_LEVELS - 1
+          && ((w->current >> (X_TIMER_WHEEL_BITS * (wrapped + 1))) << (X_TIMER_WHEEL_BITS * (wrapped + 1))) == w->current)
+        wrapped++;
+      for (int level = wrapped; level >= 1; --level)
+        x_timer_cascade(w, level, (int)((w->current >> (X_TIMER_WHEEL_BITS * level)) & X_TIMER_WHEEL_MASK));
+
+      x_timer_cascade(w, 0, (int)(w->current & X_TIMER_WHEEL_MASK));
+    }
+  }
+
+  static uint64_t x_timer_now(XTimerWheel* w)
+  {
+    return (x_thread_time_ns() - w->base_ns) / 1000000ull;
+  }
+
+  // Ticks until something may need processing, or -1 when idle
+  static int x_timer_next_wait(XTimerWheel* w)
+  {
+    if (w->pending == 0)
+      return -1;
+
+    for (int i = 1; i < X_TIMER_WHEEL_SIZE; ++i)
+    {
+      if (w->slots[0][(w->current + i) & X_TIMER_WHEEL_MASK] != X_TIMER_NONE)
+        return i;
+    }
+    return (int)(X_TIMER_WHEEL_SIZE - (w->current & X_TIMER_WHEEL_MASK));
+  }
+
+  static void* x_timer_thread(void* arg)
+  {
+    XTimerWheel* w = (XTimerWheel*) arg;
+    x_thread_mutex_lock(w->lock);
+    while (!w->stop)
+    {
+      x_timer_advance(w, x_timer_now(w));
+
+      if (w->batch_count > 0)
+      {
+        // Hand the whole batch to the pool outside the wheel lock
+        XTask* batch = w->batch;
+        int count = w->batch_count;
+        w->batch = NULL;
+        w->batch_count = 0;
+        w->batch_capacity = 0;
+        x_thread_mutex_unlock(w->lock);
+
+        for (int i = 0; i < count; ++i)
+          x_threadpool_push(w->pool, &batch[i], -1);
+        x_threadpool_wake(w->pool, count);
+
+        x_thread_mutex_lock(w->lock);
+        if (!w->batch)
+        {
+          w->batch = batch;
+          w->batch_capacity = count;
+        }
+        else
+        {
+          free(batch);
+        }
+        continue;
+      }
+
+      int wait = x_timer_next_wait(w);
+      if (wait < 0)
+        x_thread_condvar_wait(w->cv, w->lock);
+      else
+      {
+        uint64_t target = w->current + (uint64_t) wait;
+        uint64_t now = x_timer_now(w);
+        if (target > now)
+          x_thread_condvar_wait_timeout(w->cv, w->lock, (int)(target - now));
+      }
+    }
+    x_thread_mutex_unlock(w->lock);
+    return NULL;
+  }
+
+  static XTimerWheel* x_threadpool_timers(XThreadPool* pool)
   {
-    if (!pool) return;
+    XTimerWheel* w = (XTimerWheel*) x_atomic_load_ptr((void* volatile*) &pool->timers);
+    if (w)
+      return w;
 
     x_thread_mutex_lock(pool->lock);
-    pool->stop = true;
-    pool->magic = 0;
-    x_thread_condvar_broadcast(pool->cv);
+    w = pool->timers;
+    if (!w && (w = calloc(1, sizeof(XTimerWheel))) != NULL)
+    {
+      for (int level = 0; level < X_TIMER_WHEEL_LEVELS; ++level)
+        for (int slot = 0; slot < X_TIMER_WHEEL_SIZE; ++slot)
+          w->slots[level][slot] = X_TIMER_NONE;
+      w->free_list = X_TIMER_NONE;
+      w->pool = pool;
+      w->base_ns = x_thread_time_ns();
+      x_thread_mutex_init(&w->lock);
+      x_thread_condvar_init(&w->cv);
+      x_thread_create(&w->thread, x_timer_thread, w);
+      x_atomic_store_ptr((void* volatile*) &pool->timers, w);
+    }
     x_thread_mutex_unlock(pool->lock);
+    return w;
+  }
+
+  static void x_threadpool_timers_stop(XThreadPool* pool)
+  {
+    XTimerWheel* w = pool->timers;
+    if (!w)
+      return;
+
+    x_thread_mutex_lock(w->lock);
+    w->stop = true;
+    x_thread_condvar_signal(w->cv);
+    x_thread_mutex_unlock(w->lock);
+    x_thread_join(w->thread);
+    x_thread_destroy(w->thread);
+
+    x_thread_mutex_destroy(w->lock);
+    x_thread_condvar_destroy(w->cv);
+    free(w->entries);
+    free(w->batch);
+    free(w);
+    pool->timers = NULL;
+  }
+
+  XTimerId threadpool_schedule_every(XThreadPool* pool, uint32_t delay_ms, uint32_t period_ms, XThreadTask_fn fn, void* arg)
+  {
+    if (!fn || !pool || pool->magic != THREADPOOL_MAGIC) return 0;
 
-    for (int i = 0; i < pool->num_threads; ++i)
+    XTimerWheel* w = x_threadpool_timers(pool);
+    if (!w) return 0;
+
+    x_thread_mutex_lock(w->lock);
+    if (w->free_list == X_TIMER_NONE)
     {
-      x_thread_join(pool->threads[i]);
-      x_thread_destroy(pool->threads[i]);
+      int32_t capacity = w->capacity ? w->capacity * 2 : 64;
+      XTimerEntry* entries = realloc(w->entries, capacity * sizeof(XTimerEntry));
+      if (!entries)
+      {
+        x_thread_mutex_unlock(w->lock);
+        return 0;
+      }
+      for (int32_t i = capacity - 1; i >= w->capacity; --i)
+      {
+        entries[i].generation = 0;
+        entries[i].level = X_TIMER_NONE;
+        entries[i].next = w->free_list;
+        w->free_list = i;
+      }
+      w->entries = entries;
+      w->capacity = capacity;
     }
 
-    free(pool->threads);
-    x_thread_mutex_destroy(pool->lock);
-    x_thread_condvar_destroy(pool->cv);
+    // Catch the wheel up first so the delay counts from now
+    x_timer_advance(w, x_timer_now(w));
+
+    int32_t index = w->free_list;
+    XTimerEntry* e = &w->entries[index];
+    w->free_list = e->next;
+    e->fn = fn;
+    e->arg = arg;
+    e->period = period_ms;
+    e->expires = w->current + (delay_ms ? delay_ms : 1);
+    x_timer_link(w, index);
+    x_thread_condvar_signal(w->cv);
+    XTimerId id = ((uint64_t) e->generation << 32) | (uint32_t)(index + 1);
+    x_thread_mutex_unlock(w->lock);
+    return id;
+  }
+
+  XTimerId threadpool_schedule_after(XThreadPool* pool, uint32_t delay_ms, XThreadTask_fn fn, void* arg)
+  {
+    return threadpool_schedule_every(pool, delay_ms, 0, fn, arg);
+  }
+
+  bool threadpool_cancel_timer(XThreadPool* pool, XTimerId id)
+  {
+    if (!pool || pool->magic != THREADPOOL_MAGIC || id == 0) return false;
+
+    XTimerWheel* w = (XTimerWheel*) x_atomic_load_ptr((void* volatile*) &pool->timers);
+    if (!w) return false;
 
-    // Clean up remaining tasks
-    while (pool->head)
+    int32_t index = (int32_t)(id & 0xFFFFFFFFu) - 1;
+    uint32_t generation = (uint32_t)(id >> 32);
+    bool cancelled = false;
+
+    x_thread_mutex_lock(w->lock);
+    if (index >= 0 && index < w->capacity)
     {
-      XTask* tmp = pool->head;
-      pool->head = tmp->next;
-      free(tmp);
+      XTimerEntry* e = &w->entries[index];
+      if (e->generation == generation && e->level != X_TIMER_NONE)
+      {
+        x_timer_unlink(w, index);
+        x_timer_release(w, index);
+        cancelled = true;
+      }
     }
+    x_thread_mutex_unlock(w->lock);
+    return cancelled;
+  }
 
-    free(pool);
+  // ---------------------------------------------------------------------------
+  // Task graph
+  // ---------------------------------------------------------------------------
+
+  typedef struct XTaskGraphNode_t
+  {
+    XThreadTask_fn fn;
+    void* arg;
+    XTaskGraph* graph;
+    int* successors;
+    int num_successors;
+    int cap_successors;
+    int num_predecessors;           // Static in-degree, restored on every submit
+    volatile int32_t pending;       // Predecessors still running in the current submission
+  } XTaskGraphNode;
+
+  struct XTaskGraph_t
+  {
+    XTaskGraphNode* nodes;
+    int num_nodes;
+    int cap_nodes;
+    int* scratch;                   // Work list for the cycle check, sized like nodes
+    bool validated;
+
+    XThreadPool* pool;
+    volatile int32_t remaining;     // Nodes not yet finished in the current submission
+    bool running;
+    XMutex* lock;
+    XCondVar* done;
+  };
+
+  static void x_taskgraph_run_node(void* arg)
+  {
+    XTaskGraphNode* node = (XTaskGraphNode*) arg;
+    XTaskGraph* graph = node->graph;
+
+    while (node)
+    {
+      node->fn(node->arg);
+
+      // Release successors. The last one that becomes ready runs on this
+      // thread instead of going through the pool queue.
+      XTaskGraphNode* next = NULL;
+      for (int i = 0; i < node->num_successors; ++i)
+      {
+        XTaskGraphNode* succ = &graph->nodes[node->successors[i]];
+        if (x_atomic_add_i32(&succ->pending, -1) != 1)
+          continue;
+
+        if (next && threadpool_enqueue(graph->pool, x_taskgraph_run_node, next) != 0)
+          x_taskgraph_run_node(next);
+        next = succ;
+      }
+
+      if (x_atomic_add_i32(&graph->remaining, -1) == 1)
+      {
+        x_thread_mutex_lock(graph->lock);
+        graph->running = false;
+        x_thread_condvar_broadcast(graph->done);
+        x_thread_mutex_unlock(graph->lock);
+      }
+      node = next;
+    }
+  }
+
+  static bool x_taskgraph_is_acyclic(XTaskGraph* graph)
+  {
+    int count = 0;
+    for (int i = 0; i < graph->num_nodes; ++i)
+    {
+      graph->nodes[i].pending = graph->nodes[i].num_predecessors;
+      if (graph->nodes[i].num_predecessors == 0)
+        graph->scratch[count++] = i;
+    }
+
+    for (int visited = 0; visited < count; ++visited)
+    {
+      XTaskGraphNode* node = &graph->nodes[graph->scratch[visited]];
+      for (int i = 0; i < node->num_successors; ++i)
+      {
+        if (--graph->nodes[node->successors[i]].pending == 0)
+          graph->scratch[count++] = node->successors[i];
+      }
+    }
+    return count == graph->num_nodes;
+  }
+
+  XTaskGraph* x_taskgraph_create(void)
+  {
+    XTaskGraph* graph = calloc(1, sizeof(XTaskGraph));
+    if (!graph) return NULL;
+    x_thread_mutex_init(&graph->lock);
+    x_thread_condvar_init(&graph->done);
+    graph->validated = true;
+    return graph;
+  }
+
+  int x_taskgraph_add_node(XTaskGraph* graph, XThreadTask_fn fn, void* arg)
+  {
+    if (!graph || !fn || graph->running) return -1;
+
+    if (graph->num_nodes == graph->cap_nodes)
+    {
+      int cap = graph->cap_nodes ? graph->cap_nodes * 2 : 16;
+      XTaskGraphNode* nodes = realloc(graph->nodes, cap * sizeof(XTaskGraphNode));
+      if (!nodes) return -1;
+      graph->nodes = nodes;
+      int* scratch = realloc(graph->scratch, cap * sizeof(int));
+      if (!scratch) return -1;
+      graph->scratch = scratch;
+      graph->cap_nodes = cap;
+    }
+
+    XTaskGraphNode* node = &graph->nodes[graph->num_nodes];
+    memset(node, 0, sizeof(*node));
+    node->fn = fn;
+    node->arg = arg;
+    node->graph = graph;
+    return graph->num_nodes++;
+  }
+
+  int x_taskgraph_add_edge(XTaskGraph* graph, int before, int after)
+  {
+    if (!graph || graph->running) return -1;
+    if (before < 0 || before >= graph->num_nodes || after < 0 || after >= graph->num_nodes)
+      return -1;
+
+    XTaskGraphNode* node = &graph->nodes[before];
+    if (node->num_successors == node->cap_successors)
+    {
+      int cap = node->cap_successors ? node->cap_successors * 2 : 4;
+      int* successors = realloc(node->successors, cap * sizeof(int));
+      if (!successors) return -1;
+      node->successors = successors;
+      node->cap_successors = cap;
+    }
+
+    node->successors[node->num_successors++] = after;
+    graph->nodes[after].num_predecessors++;
+    graph->validated = false;
+    return 0;
+  }
+
+  int x_taskgraph_submit(XTaskGraph* graph, XThreadPool* pool)
+  {
+    if (!graph || !pool || pool->magic != THREADPOOL_MAGIC)
+      return -1;
+
+    x_thread_mutex_lock(graph->lock);
+    bool busy = graph->running;
+    if (!busy && !graph->validated && x_taskgraph_is_acyclic(graph))
+      graph->validated = true;
+
+    if (busy || !graph->validated)
+    {
+      x_thread_mutex_unlock(graph->lock);
+      return -1;
+    }
+
+    if (graph->num_nodes == 0)
+    {
+      x_thread_mutex_unlock(graph->lock);
+      return 0;
+    }
+
+    for (int i = 0; i < graph->num_nodes; ++i)
+      graph->nodes[i].pending = graph->nodes[i].num_predecessors;
+
+    graph->pool = pool;
+    graph->remaining = graph->num_nodes;
+    graph->running = true;
+    x_thread_mutex_unlock(graph->lock);
+
+    for (int i = 0; i < graph->num_nodes; ++i)
+    {
+      if (graph->nodes[i].num_predecessors != 0)
+        continue;
+
+      if (threadpool_enqueue(pool, x_taskgraph_run_node, &graph->nodes[i]) != 0)
+        x_taskgraph_run_node(&graph->nodes[i]);
+    }
+    return 0;
+  }
+
+  void x_taskgraph_wait(XTaskGraph* graph)
+  {
+    if (!graph) return;
+    x_thread_mutex_lock(graph->lock);
+    while (graph->running)
+      x_thread_condvar_wait(graph->done, graph->lock);
+    x_thread_mutex_unlock(graph->lock);
   }
 
+  void x_taskgraph_destroy(XTaskGraph* graph)
+  {
+    if (!graph) return;
+    x_taskgraph_wait(graph);
+    for (int i = 0; i < graph->num_nodes; ++i)
+      free(graph->nodes[i].successors);
+    free(graph->nodes);
+    free(graph->scratch);
+    x_thread_mutex_destroy(graph->lock);
+    x_thread_condvar_destroy(graph->done);
+    free(graph);
+  }
 
 #endif  // STDX_IMPLEMENTATION_THREAD
 
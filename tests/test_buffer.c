@@ -0,0 +1,178 @@
+#define STDX_IMPLEMENTATION_TEST
+#include <stdx_test.h>
+#define STDX_IMPLEMENTATION_THREAD
+#include <stdx_thread.h>
+#define STDX_IMPLEMENTATION_BUFFER
+#include <stdx_buffer.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+  XAllocator base;
+  volatile int32_t live;
+  volatile int32_t allocs;
+} CountingAllocator;
+
+static void* counting_alloc(XAllocator* self, size_t size)
+{
+  CountingAllocator* a = (CountingAllocator*) self;
+  x_atomic_add_i32(&a->live, 1);
+  x_atomic_add_i32(&a->allocs, 1);
+  return malloc(size);
+}
+
+static void counting_free(XAllocator* self, void* ptr)
+{
+  CountingAllocator* a = (CountingAllocator*) self;
+  x_atomic_add_i32(&a->live, -1);
+  free(ptr);
+}
+
+static void counting_init(CountingAllocator* a)
+{
+  a->base.alloc = counting_alloc;
+  a->base.free = counting_free;
+  a->base.userdata = NULL;
+  a->live = 0;
+  a->allocs = 0;
+}
+
+int test_buffer_retain_release(void)
+{
+  CountingAllocator a;
+  counting_init(&a);
+
+  XBuffer* buf = x_buffer_from("hello", 5, &a.base);
+  ASSERT_TRUE(buf != NULL);
+  ASSERT_TRUE(x_buffer_size(buf) == 5);
+  ASSERT_TRUE(memcmp(x_buffer_data(buf), "hello", 5) == 0);
+  ASSERT_TRUE(x_buffer_is_unique(buf));
+
+  ASSERT_TRUE(x_buffer_retain(buf) == buf);
+  ASSERT_FALSE(x_buffer_is_unique(buf));
+  x_buffer_release(buf);
+  ASSERT_TRUE(a.live == 1);
+  x_buffer_release(buf);
+  ASSERT_TRUE(a.live == 0);
+
+  // Default allocator
+  buf = x_buffer_create(16, NULL);
+  ASSERT_TRUE(buf != NULL && x_buffer_size(buf) == 16);
+  x_buffer_release(buf);
+  return 0;
+}
+
+int test_buffer_slices(void)
+{
+  CountingAllocator a;
+  counting_init(&a);
+
+  XBuffer* buf = x_buffer_from("GET /index.html", 15, &a.base);
+  XBuffer* path = x_buffer_slice(buf, 4, 11);
+  XBuffer* name = x_buffer_slice(path, 1, 5);
+  ASSERT_TRUE(x_buffer_slice(buf, 10, 6) == NULL);
+  ASSERT_TRUE(x_buffer_slice(buf, 16, 0) == NULL);
+
+  // Views, not copies
+  ASSERT_TRUE(x_buffer_data(path) == x_buffer_data(buf) + 4);
+  ASSERT_TRUE(x_buffer_data(name) == x_buffer_data(buf) + 5);
+  ASSERT_TRUE(memcmp(x_buffer_data(name), "index", 5) == 0);
+
+  // The store outlives the original reference
+  x_buffer_release(buf);
+  ASSERT_TRUE(memcmp(x_buffer_data(path), "/index.html", 11) == 0);
+  x_buffer_release(path);
+  ASSERT_TRUE(a.live == 1 + 1); // Store plus the remaining slice header
+  ASSERT_TRUE(x_buffer_is_unique(name));
+  x_buffer_release(name);
+  ASSERT_TRUE(a.live == 0);
+  return 0;
+}
+
+int test_buffer_copy_on_write(void)
+{
+  CountingAllocator a;
+  counting_init(&a);
+
+  XBuffer* buf = x_buffer_from("abc", 3, &a.base);
+  ASSERT_TRUE(x_buffer_make_writable(buf) == buf);
+
+  XBuffer* shared = x_buffer_retain(buf);
+  XBuffer* mine = x_buffer_make_writable(buf);
+  ASSERT_TRUE(mine != shared);
+  x_buffer_data(mine)[0] = 'X';
+  ASSERT_TRUE(memcmp(x_buffer_data(shared), "abc", 3) == 0);
+  ASSERT_TRUE(memcmp(x_buffer_data(mine), "Xbc", 3) == 0);
+  ASSERT_TRUE(x_buffer_is_unique(shared));
+
+  // A slice is only writable in place when nothing else uses the store
+  XBuffer* slice = x_buffer_slice(shared, 1, 2);
+  ASSERT_FALSE(x_buffer_is_unique(slice));
+  x_buffer_release(shared);
+  ASSERT_TRUE(x_buffer_make_writable(slice) == slice);
+
+  x_buffer_release(slice);
+  x_buffer_release(mine);
+  ASSERT_TRUE(a.live == 0);
+  return 0;
+}
+
+#define BUFFER_STAGES 1000
+
+typedef struct
+{
+  XBuffer* slice;
+  volatile int32_t* sum;
+} StageArgs;
+
+static void consume_slice(void* arg)
+{
+  StageArgs* args = (StageArgs*) arg;
+  int32_t value = 0;
+  memcpy(&value, x_buffer_data(args->slice), sizeof(value));
+  x_atomic_add_i32(args->sum, value);
+  x_buffer_release(args->slice);
+}
+
+int test_buffer_across_pool(void)
+{
+  CountingAllocator a;
+  counting_init(&a);
+
+  XBuffer* buf = x_buffer_create(BUFFER_STAGES * sizeof(int32_t), &a.base);
+  for (int32_t i = 0; i < BUFFER_STAGES; ++i)
+    memcpy(x_buffer_data(buf) + i * sizeof(int32_t), &i, sizeof(i));
+
+  volatile int32_t sum = 0;
+  StageArgs* args = malloc(sizeof(StageArgs) * BUFFER_STAGES);
+  XThreadPool* pool = threadpool_create(4);
+  for (int i = 0; i < BUFFER_STAGES; ++i)
+  {
+    args[i].slice = x_buffer_slice(buf, i * sizeof(int32_t), sizeof(int32_t));
+    args[i].sum = &sum;
+    threadpool_enqueue(pool, consume_slice, &args[i]);
+  }
+  x_buffer_release(buf);
+  threadpool_destroy(pool);
+  free(args);
+
+  ASSERT_TRUE(sum == BUFFER_STAGES * (BUFFER_STAGES - 1) / 2);
+  ASSERT_TRUE(a.live == 0);
+  ASSERT_TRUE(a.allocs == BUFFER_STAGES + 1);
+  return 0;
+}
+
+int main()
+{
+  STDXTestCase tests[] =
+  {
+    TEST_CASE(test_buffer_retain_release),
+    TEST_CASE(test_buffer_slices),
+    TEST_CASE(test_buffer_copy_on_write),
+    TEST_CASE(test_buffer_across_pool),
+  };
+
+  return stdx_run_tests(tests, sizeof(tests)/sizeof(tests[0]));
+}
@@ -0,0 +1,169 @@
+#define STDX_IMPLEMENTATION_TEST
+#include <stdx_test.h>
+#define STDX_IMPLEMENTATION_CHANNEL
+#include <stdx_channel.h>
+
+int test_channel_buffered(void)
+{
+  XChannel* ch = x_channel_create(sizeof(int), 4);
+  ASSERT_TRUE(ch != NULL);
+
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(x_channel_try_send(ch, &i) == X_CHANNEL_OK);
+
+  int value = 4;
+  ASSERT_TRUE(x_channel_try_send(ch, &value) == X_CHANNEL_WOULD_BLOCK);
+
+  for (int i = 0; i < 4; ++i)
+  {
+    ASSERT_TRUE(x_channel_recv(ch, &value) == X_CHANNEL_OK);
+    ASSERT_TRUE(value == i);
+  }
+  ASSERT_TRUE(x_channel_try_recv(ch, &value) == X_CHANNEL_WOULD_BLOCK);
+
+  x_channel_destroy(ch);
+  return 0;
+}
+
+int test_channel_close_drains(void)
+{
+  XChannel* ch = x_channel_create(sizeof(int), 4);
+  int value = 7;
+  x_channel_send(ch, &value);
+  x_channel_close(ch);
+
+  ASSERT_TRUE(x_channel_send(ch, &value) == X_CHANNEL_CLOSED);
+  value = 0;
+  ASSERT_TRUE(x_channel_recv(ch, &value) == X_CHANNEL_OK);
+  ASSERT_TRUE(value == 7);
+  ASSERT_TRUE(x_channel_recv(ch, &value) == X_CHANNEL_CLOSED);
+
+  x_channel_destroy(ch);
+  return 0;
+}
+
+#define CHANNEL_ITEMS 20000
+
+static void* channel_sender(void* arg)
+{
+  XChannel* ch = (XChannel*) arg;
+  for (int i = 1; i <= CHANNEL_ITEMS; ++i)
+    x_channel_send(ch, &i);
+  x_channel_close(ch);
+  return NULL;
+}
+
+int test_channel_unbuffered(void)
+{
+  XChannel* ch = x_channel_create(sizeof(int), 0);
+  int value = 1;
+  ASSERT_TRUE(x_channel_try_send(ch, &value) == X_CHANNEL_WOULD_BLOCK);
+
+  XThread* t;
+  x_thread_create(&t, channel_sender, ch);
+
+  int expected = 1;
+  bool in_order = true;
+  while (x_channel_recv(ch, &value) == X_CHANNEL_OK)
+  {
+    if (value != expected++)
+      in_order = false;
+  }
+
+  x_thread_join(t);
+  x_thread_destroy(t);
+  x_channel_destroy(ch);
+
+  ASSERT_TRUE(in_order);
+  ASSERT_TRUE(expected == CHANNEL_ITEMS + 1);
+  return 0;
+}
+
+int test_channel_select_timeout(void)
+{
+  XChannel* a = x_channel_create(sizeof(int), 0);
+  XChannel* b = x_channel_create(sizeof(int), 1);
+  int in = 0;
+  int out = 0;
+
+  XChannelCase cases[2] =
+  {
+    { a, X_CHANNEL_RECV, &in, X_CHANNEL_OK },
+    { b, X_CHANNEL_RECV, &in, X_CHANNEL_OK },
+  };
+
+  ASSERT_TRUE(x_channel_select(cases, 2, 0) == X_CHANNEL_TIMEOUT);
+
+  uint64_t start = x_thread_time_ns();
+  ASSERT_TRUE(x_channel_select(cases, 2, 20) == X_CHANNEL_TIMEOUT);
+  ASSERT_TRUE(x_thread_time_ns() - start >= 15000000ull);
+
+  // Nothing may be left registered after the timeout
+  out = 5;
+  ASSERT_TRUE(x_channel_try_send(a, &out) == X_CHANNEL_WOULD_BLOCK);
+  ASSERT_TRUE(x_channel_try_send(b, &out) == X_CHANNEL_OK);
+  ASSERT_TRUE(x_channel_select(cases, 2, -1) == 1);
+  ASSERT_TRUE(cases[1].result == X_CHANNEL_OK);
+  ASSERT_TRUE(in == 5);
+
+  x_channel_destroy(a);
+  x_channel_destroy(b);
+  return 0;
+}
+
+int test_channel_select_many(void)
+{
+  XChannel* a = x_channel_create(sizeof(int), 0);
+  XChannel* b = x_channel_create(sizeof(int), 8);
+  XThread* ta;
+  XThread* tb;
+  x_thread_create(&ta, channel_sender, a);
+  x_thread_create(&tb, channel_sender, b);
+
+  int64_t sum = 0;
+  int value = 0;
+  int open = 2;
+  XChannelCase cases[2] =
+  {
+    { a, X_CHANNEL_RECV, &value, X_CHANNEL_OK },
+    { b, X_CHANNEL_RECV, &value, X_CHANNEL_OK },
+  };
+
+  while (open > 0)
+  {
+    int i = x_channel_select(cases, open, -1);
+    ASSERT_TRUE(i >= 0);
+    if (cases[i].result == X_CHANNEL_CLOSED)
+    {
+      // Drop the closed case
+      cases[i] = cases[open - 1];
+      open--;
+      continue;
+    }
+    sum += value;
+  }
+
+  x_thread_join(ta);
+  x_thread_join(tb);
+  x_thread_destroy(ta);
+  x_thread_destroy(tb);
+  x_channel_destroy(a);
+  x_channel_destroy(b);
+
+  ASSERT_TRUE(sum == 2 * (int64_t) CHANNEL_ITEMS * (CHANNEL_ITEMS + 1) / 2);
+  return 0;
+}
+
+int main()
+{
+  STDXTestCase tests[] =
+  {
+    TEST_CASE(test_channel_buffered),
+    TEST_CASE(test_channel_close_drains),
+    TEST_CASE(test_channel_unbuffered),
+    TEST_CASE(test_channel_select_timeout),
+    TEST_CASE(test_channel_select_many),
+  };
+
+  return stdx_run_tests(tests, sizeof(tests)/sizeof(tests[0]));
+}
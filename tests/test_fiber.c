@@ -0,0 +1,109 @@
+#define STDX_IMPLEMENTATION_TEST
+#include <stdx_test.h>
+#define STDX_IMPLEMENTATION_FIBER
+#include <stdx_fiber.h>
+
+#define NUM_FIBERS 200
+#define NUM_YIELDS 50
+
+static volatile int32_t steps = 0;
+
+static void yielding_fiber(void* arg)
+{
+  int* progress = (int*) arg;
+  for (int i = 0; i < NUM_YIELDS; ++i)
+  {
+    // Locals must survive the switch, possibly onto another worker
+    *progress = i + 1;
+    x_atomic_add_i32(&steps, 1);
+    x_fiber_yield();
+  }
+}
+
+int test_fiber_yield(void)
+{
+  XThreadPool* pool = threadpool_create(4);
+  XFiberScheduler* sched = x_fiber_scheduler_create(pool, 0);
+  ASSERT_TRUE(sched != NULL);
+
+  int progress[NUM_FIBERS] = { 0 };
+  steps = 0;
+  for (int i = 0; i < NUM_FIBERS; ++i)
+    ASSERT_TRUE(x_fiber_spawn(sched, yielding_fiber, &progress[i]) == 0);
+
+  x_fiber_scheduler_wait(sched);
+  ASSERT_TRUE(x_atomic_load_i32(&steps) == NUM_FIBERS * NUM_YIELDS);
+  for (int i = 0; i < NUM_FIBERS; ++i)
+    ASSERT_TRUE(progress[i] == NUM_YIELDS);
+
+  // A second round reuses the cached stacks
+  for (int i = 0; i < NUM_FIBERS; ++i)
+    ASSERT_TRUE(x_fiber_spawn(sched, yielding_fiber, &progress[i]) == 0);
+  x_fiber_scheduler_wait(sched);
+  ASSERT_TRUE(x_atomic_load_i32(&steps) == 2 * NUM_FIBERS * NUM_YIELDS);
+
+  x_fiber_scheduler_destroy(sched);
+  threadpool_destroy(pool);
+  return 0;
+}
+
+typedef struct
+{
+  XFiber* volatile waiting;
+  volatile int32_t stage;
+  double value;
+} SuspendProbe;
+
+static void suspending_fiber(void* arg)
+{
+  SuspendProbe* probe = (SuspendProbe*) arg;
+  double local = 1.5;
+  x_atomic_store_ptr((void* volatile*) &probe->waiting, x_fiber_current());
+  x_atomic_store_i32(&probe->stage, 1);
+  x_fiber_suspend();
+  probe->value = local * 2.0;
+  x_atomic_store_i32(&probe->stage, 2);
+}
+
+static void* resumer(void* arg)
+{
+  SuspendProbe* probe = (SuspendProbe*) arg;
+  while (x_atomic_load_i32(&probe->stage) != 1)
+    x_thread_yield();
+  x_thread_sleep_ms(10);
+  x_fiber_resume((XFiber*) x_atomic_load_ptr((void* volatile*) &probe->waiting));
+  return NULL;
+}
+
+int test_fiber_suspend_resume(void)
+{
+  XThreadPool* pool = threadpool_create(2);
+  XFiberScheduler* sched = x_fiber_scheduler_create(pool, 32 * 1024);
+  SuspendProbe probe = { NULL, 0, 0.0 };
+
+  XThread* t;
+  x_thread_create(&t, resumer, &probe);
+  ASSERT_TRUE(x_fiber_spawn(sched, suspending_fiber, &probe) == 0);
+  x_fiber_scheduler_wait(sched);
+  x_thread_join(t);
+  x_thread_destroy(t);
+
+  ASSERT_TRUE(probe.stage == 2);
+  ASSERT_FLOAT_EQ(probe.value, 3.0);
+  ASSERT_TRUE(x_fiber_current() == NULL);
+
+  x_fiber_scheduler_destroy(sched);
+  threadpool_destroy(pool);
+  return 0;
+}
+
+int main()
+{
+  STDXTestCase tests[] =
+  {
+    TEST_CASE(test_fiber_yield),
+    TEST_CASE(test_fiber_suspend_resume),
+  };
+
+  return stdx_run_tests(tests, sizeof(tests)/sizeof(tests[0]));
+}
@@ -0,0 +1,1183 @@
+#define STDX_IMPLEMENTATION_TEST
+#include <stdx_test.h>
+#include <stdx_log.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include <signal.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define LOG_FILE "test_tmp_log_file.txt"
+#define LOG_BIN_FILE "test_tmp_log_file.bin"
+#define LOG_DUMP_FILE "test_tmp_log_dump.txt"
+#define LOG_THREADS 4
+#define LOG_RECORDS 5000
+
+static void log_restore_console(void)
+{
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_CONSOLE;
+  config.level = XLOG_LEVEL_DEBUG;
+  logger_init_ex(&config);
+}
+
+static int log_count_lines(const char* path, const char* needle)
+{
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return -1;
+
+  char line[2048];
+  int count = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    size_t len = strlen(line);
+    // Every record must come out whole, on its own line
+    if (len == 0 || line[len - 1] != '\n')
+      count = -1000000;
+    if (strstr(line, needle))
+      count++;
+  }
+  fclose(f);
+  return count;
+}
+
+static void* log_producer(void* arg)
+{
+  int id = (int)(intptr_t) arg;
+  for (int i = 0; i < LOG_RECORDS; ++i)
+    x_log_info("producer %d record %d", id, i);
+  return NULL;
+}
+
+static void log_run_producers(void)
+{
+  XThread* threads[LOG_THREADS];
+  for (int i = 0; i < LOG_THREADS; ++i)
+    x_thread_create(&threads[i], log_producer, (void*)(intptr_t) i);
+  for (int i = 0; i < LOG_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+}
+
+int test_log_async_block(void)
+{
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  config.async = true;
+  config.queue_capacity = 64;
+  config.overflow = XLOG_OVERFLOW_BLOCK;
+  logger_init_ex(&config);
+
+  log_run_producers();
+  logger_flush();
+
+  XLogStats stats;
+  logger_stats(&stats);
+  logger_close();
+  log_restore_console();
+
+  ASSERT_TRUE(stats.records_dropped == 0);
+  ASSERT_TRUE(stats.records_written == LOG_THREADS * LOG_RECORDS);
+  // Records are gathered into batches
+  ASSERT_TRUE(stats.writes < stats.records_written);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "producer") == LOG_THREADS * LOG_RECORDS);
+  remove(LOG_FILE);
+  return 0;
+}
+
+int test_log_async_overflow(void)
+{
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  config.async = true;
+  config.queue_capacity = 8;
+  config.overflow = XLOG_OVERFLOW_COUNT;
+  logger_init_ex(&config);
+
+  log_run_producers();
+  logger_close();
+
+  XLogStats stats;
+  logger_stats(&stats);
+  log_restore_console();
+
+  // Nothing is lost without being accounted for
+  ASSERT_TRUE(stats.records_written + stats.records_dropped == LOG_THREADS * LOG_RECORDS);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "producer") == (int) stats.records_written);
+  if (stats.records_dropped)
+    ASSERT_TRUE(log_count_lines(LOG_FILE, "records dropped") > 0);
+  remove(LOG_FILE);
+  return 0;
+}
+
+int test_log_long_record(void)
+{
+  remove(LOG_FILE);
+  char big[5000];
+  memset(big, 'x', sizeof(big) - 1);
+  big[sizeof(big) - 1] = 0;
+
+  for (int async = 0; async < 2; ++async)
+  {
+    XLogConfig config = { 0 };
+    config.outputs = XLOG_OUTPUT_FILE;
+    config.level = XLOG_LEVEL_DEBUG;
+    config.filename = LOG_FILE;
+    config.async = async != 0;
+    logger_init_ex(&config);
+    x_log_raw(XLOG_LEVEL_INFO, XLOG_COLOR_WHITE, XLOG_COLOR_BLACK, 0, "%s\n", big);
+    logger_close();
+  }
+  log_restore_console();
+
+  FILE* f = fopen(LOG_FILE, "r");
+  ASSERT_TRUE(f != NULL);
+  char line[8192];
+  int lines = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    // Not truncated
+    ASSERT_TRUE(strlen(line) == sizeof(big));
+    lines++;
+  }
+  fclose(f);
+  ASSERT_TRUE(lines == 2);
+  remove(LOG_FILE);
+  return 0;
+}
+
+typedef struct
+{
+  volatile int32_t stop;
+  volatile int32_t logged;
+} ChurnArgs;
+
+static void* log_churn_producer(void* arg)
+{
+  ChurnArgs* args = (ChurnArgs*) arg;
+  while (!x_atomic_load_i32(&args->stop))
+  {
+    x_log_warning("churn record %d", x_atomic_add_i32(&args->logged, 1));
+  }
+  return NULL;
+}
+
+int test_log_reinit_while_logging(void)
+{
+  remove(LOG_FILE);
+  ChurnArgs args = { 0, 0 };
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+
+  XThread* threads[LOG_THREADS];
+  for (int i = 0; i < LOG_THREADS; ++i)
+    x_thread_create(&threads[i], log_churn_producer, &args);
+
+  // Switch between sync and async, and change levels, under load
+  for (int i = 0; i < 20; ++i)
+  {
+    config.async = (i & 1) != 0;
+    logger_init_ex(&config);
+    logger_set_level((i & 2) ? XLOG_LEVEL_ERROR : XLOG_LEVEL_DEBUG);
+    x_thread_sleep_ms(2);
+  }
+  logger_set_level(XLOG_LEVEL_DEBUG);
+  x_thread_sleep_ms(2);
+
+  // Producers stop before the logger goes, or they would log to the console
+  x_atomic_store_i32(&args.stop, 1);
+  for (int i = 0; i < LOG_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+  logger_close();
+  log_restore_console();
+
+  ASSERT_TRUE(logger_get_level() == XLOG_LEVEL_DEBUG);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "churn record") > 0);
+  remove(LOG_FILE);
+  return 0;
+}
+
+#define LOG_BUSY_THREADS 48
+
+static void* log_quiesce_main(void* arg)
+{
+  (void) arg;
+  x_log_quiesce();
+  return NULL;
+}
+
+int test_log_reinit_many_threads(void)
+{
+  remove(LOG_FILE);
+  ChurnArgs args = { 0, 0 };
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  config.async = true;
+  logger_init_ex(&config);
+
+  // More threads than in-flight stripes, so some stripe is nearly always
+  // busy; retiring a logger must still only wait for the calls it raced
+  XThread* threads[LOG_BUSY_THREADS];
+  for (int i = 0; i < LOG_BUSY_THREADS; ++i)
+    x_thread_create(&threads[i], log_churn_producer, &args);
+  x_thread_sleep_ms(5);
+
+  for (int i = 0; i < 10; ++i)
+  {
+    config.async = (i & 1) == 0;
+    logger_init_ex(&config);
+  }
+
+  x_atomic_store_i32(&args.stop, 1);
+  for (int i = 0; i < LOG_BUSY_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+  logger_close();
+  log_restore_console();
+  // Records that raced a re-init waited for the new logger, none went elsewhere
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "churn record") == x_atomic_load_i32(&args.logged));
+
+  // A quiesce waits for the call it raced, but not for one that came after
+  // the flip, even on the same stripe
+  XLogStripe* raced = x_log_enter();
+  XThread* quiesce;
+  x_thread_create(&quiesce, log_quiesce_main, NULL);
+  int32_t epoch = raced == &g_log_inflight[0][x_log_tls_stripe] ? 0 : 1;
+  while (x_atomic_load_i32(&g_log_epoch) == epoch)
+    x_thread_yield();
+  XLogStripe* late = x_log_enter();
+  ASSERT_TRUE(late != raced);
+  x_thread_sleep_ms(20);
+  ASSERT_TRUE(x_atomic_load_i32(&g_log_quiescing) == 1);
+  x_log_leave(raced);
+  x_thread_join(quiesce);
+  x_thread_destroy(quiesce);
+  ASSERT_TRUE(x_atomic_load_i32(&late->count) > 0);
+  x_log_leave(late);
+  remove(LOG_FILE);
+  return 0;
+}
+
+static void* log_bin_producer(void* arg)
+{
+  int id = (int)(intptr_t) arg;
+  for (int i = 0; i < LOG_RECORDS; ++i)
+    x_log_bin(XLOG_LEVEL_INFO, "binary %d record %d", id, i);
+  return NULL;
+}
+
+int test_log_binary_decode(void)
+{
+  remove(LOG_BIN_FILE);
+  remove(LOG_FILE);
+  XLogBinConfig config = { LOG_BIN_FILE, 0 };
+  ASSERT_TRUE(logger_bin_open(&config));
+
+  x_log_bin(XLOG_LEVEL_WARNING, "int %d str '%s' double %.3f width [%*d] size %zu 100%%", -7, "text", 2.5, 4, 42, (size_t) 9);
+  XThread* threads[LOG_THREADS];
+  for (int i = 0; i < LOG_THREADS; ++i)
+    x_thread_create(&threads[i], log_bin_producer, (void*)(intptr_t) i);
+  for (int i = 0; i < LOG_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+  logger_bin_close();
+
+  XLogStats stats;
+  logger_stats(&stats);
+  FILE* out = fopen(LOG_FILE, "w");
+  int records = logger_bin_decode(LOG_BIN_FILE, out);
+  fclose(out);
+
+  // Rings may drop under pressure, but never silently
+  ASSERT_TRUE(records + (int) stats.records_dropped == LOG_THREADS * LOG_RECORDS + 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "binary") == records - 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "int -7 str 'text' double 2.500 width [  42] size 9 100%") == 1);
+  ASSERT_TRUE(logger_bin_decode("missing_" LOG_BIN_FILE, stdout) == -1);
+  remove(LOG_BIN_FILE);
+  remove(LOG_FILE);
+  return 0;
+}
+
+static void* log_bin_once(void* arg)
+{
+  x_log_bin(XLOG_LEVEL_INFO, "short lived %d", (int)(intptr_t) arg);
+  return NULL;
+}
+
+int test_log_binary_thread_churn(void)
+{
+  remove(LOG_BIN_FILE);
+  remove(LOG_FILE);
+  XLogBinConfig config = { LOG_BIN_FILE, 0 };
+  ASSERT_TRUE(logger_bin_open(&config));
+
+  // One thread at a time: each exited thread's ring is taken by the next
+  for (int i = 0; i < 200; ++i)
+  {
+    XThread* t;
+    ASSERT_TRUE(x_thread_create(&t, log_bin_once, (void*)(intptr_t) i) == 0);
+    x_thread_join(t);
+    x_thread_destroy(t);
+  }
+  int rings = 0;
+  for (XLogBinRing* ring = g_log_bin->rings; ring; ring = ring->next)
+    rings++;
+  logger_bin_close();
+
+  FILE* out = fopen(LOG_FILE, "w");
+  int records = logger_bin_decode(LOG_BIN_FILE, out);
+  fclose(out);
+  ASSERT_TRUE(rings == 1);
+  ASSERT_TRUE(records == 200);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "short lived 199\n") == 1);
+  remove(LOG_BIN_FILE);
+  remove(LOG_FILE);
+  return 0;
+}
+
+static void log_write_bytes(const char* path, const uint8_t* data, size_t len)
+{
+  FILE* f = fopen(path, "wb");
+  fwrite(data, 1, len, f);
+  fclose(f);
+}
+
+int test_log_binary_corrupt(void)
+{
+  remove(LOG_BIN_FILE);
+  XLogBinConfig config = { LOG_BIN_FILE, 0 };
+  ASSERT_TRUE(logger_bin_open(&config));
+  x_log_bin(XLOG_LEVEL_INFO, "corrupt %d", 1);
+  logger_bin_close();
+
+  uint8_t data[1024];
+  FILE* f = fopen(LOG_BIN_FILE, "rb");
+  ASSERT_TRUE(f != NULL);
+  size_t len = fread(data, 1, sizeof(data), f);
+  fclose(f);
+  ASSERT_TRUE(len > 16 + 28 && len < sizeof(data));
+
+  FILE* out = fopen(LOG_FILE, "w");
+  ASSERT_TRUE(logger_bin_decode(LOG_BIN_FILE, out) == 1);
+
+  // The site definition comes first: size, id, time, level, line, file length
+  uint8_t bad[1024];
+  memcpy(bad, data, len);
+  log_write_bytes(LOG_BIN_FILE, bad, len - 1);
+  ASSERT_TRUE(logger_bin_decode(LOG_BIN_FILE, out) == -1);
+
+  uint32_t huge = 0xfffffff0u;
+  memcpy(bad + 16 + 24, &huge, 4);
+  log_write_bytes(LOG_BIN_FILE, bad, len);
+  ASSERT_TRUE(logger_bin_decode(LOG_BIN_FILE, out) == -1);
+
+  int32_t level = 42;
+  memcpy(bad, data, len);
+  memcpy(bad + 16 + 16, &level, 4);
+  log_write_bytes(LOG_BIN_FILE, bad, len);
+  ASSERT_TRUE(logger_bin_decode(LOG_BIN_FILE, out) == -1);
+  fclose(out);
+
+  remove(LOG_BIN_FILE);
+  remove(LOG_FILE);
+  return 0;
+}
+
+int test_log_binary_background(void)
+{
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+
+  // Not running: logged as text right away
+  x_log_bin(XLOG_LEVEL_INFO, "before %s", "open");
+  ASSERT_TRUE(logger_bin_open(NULL));
+  ASSERT_FALSE(logger_bin_open(NULL));
+  for (int i = 0; i < 100; ++i)
+    x_log_bin(XLOG_LEVEL_INFO, "background %d", i);
+  // Formats binary mode can't store fall back to text too
+  x_log_bin(XLOG_LEVEL_INFO, "wide %ls", L"background");
+  logger_bin_flush();
+  int decoded = log_count_lines(LOG_FILE, "background");
+  logger_bin_close();
+  logger_close();
+  log_restore_console();
+
+  ASSERT_TRUE(decoded == 101);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "before open") == 1);
+  remove(LOG_FILE);
+  return 0;
+}
+
+static bool log_read_first_line(const char* path, char* line, size_t size)
+{
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return false;
+  bool ok = fgets(line, (int) size, f) != NULL;
+  fclose(f);
+  return ok;
+}
+
+int test_log_timestamps(void)
+{
+  char line[512];
+  int y, mo, d, h, mi, s;
+  char frac[16], tail[16];
+
+  // Default: local time, whole seconds, as before
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+  x_log_info("seconds");
+  logger_close();
+  ASSERT_TRUE(log_read_first_line(LOG_FILE, line, sizeof(line)));
+  ASSERT_TRUE(sscanf(line, "INFO [%d-%d-%d %d:%d:%d%15[^ ]", &y, &mo, &d, &h, &mi, &s, tail) == 7);
+  ASSERT_TRUE(strcmp(tail, "]") == 0);
+
+  // ISO-8601 UTC with microseconds
+  remove(LOG_FILE);
+  config.time_format = XLOG_TIME_MICROS | XLOG_TIME_UTC | XLOG_TIME_ISO8601;
+  logger_init_ex(&config);
+  x_log_info("micros");
+  x_log_info("micros again");
+  logger_close();
+  ASSERT_TRUE(log_read_first_line(LOG_FILE, line, sizeof(line)));
+  ASSERT_TRUE(sscanf(line, "INFO [%d-%d-%dT%d:%d:%d.%15[0-9]%15[^ ]", &y, &mo, &d, &h, &mi, &s, frac, tail) == 8);
+  ASSERT_TRUE(strlen(frac) == 6);
+  ASSERT_TRUE(strcmp(tail, "Z]") == 0);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "micros") == 2);
+
+  // Local ISO-8601 carries the offset
+  remove(LOG_FILE);
+  config.time_format = XLOG_TIME_MILLIS | XLOG_TIME_ISO8601;
+  logger_init_ex(&config);
+  x_log_info("millis");
+  logger_close();
+  log_restore_console();
+  ASSERT_TRUE(log_read_first_line(LOG_FILE, line, sizeof(line)));
+  ASSERT_TRUE(sscanf(line, "INFO [%d-%d-%dT%d:%d:%d.%15[0-9]%15[^ ]", &y, &mo, &d, &h, &mi, &s, frac, tail) == 8);
+  ASSERT_TRUE(strlen(frac) == 3);
+  ASSERT_TRUE(strlen(tail) == 7 && (tail[0] == '+' || tail[0] == '-') && tail[3] == ':');
+  remove(LOG_FILE);
+  return 0;
+}
+
+int test_log_flush_policy(void)
+{
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  config.flush = XLOG_FLUSH_EVERY_N;
+  config.flush_every = 4;
+  logger_init_ex(&config);
+
+  for (int i = 0; i < 10; ++i)
+    x_log_info("buffered %d", i);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "buffered") == 8);
+
+  // Errors go out right away
+  x_log_error("buffered error");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "buffered") == 11);
+
+  x_log_info("buffered tail");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "buffered") == 11);
+  logger_flush();
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "buffered") == 12);
+
+  XLogStats stats;
+  logger_stats(&stats);
+  ASSERT_TRUE(stats.writes == 4);
+  logger_close();
+
+  // Async batches go through the same buffer
+  remove(LOG_FILE);
+  config.async = true;
+  config.flush = XLOG_FLUSH_ON_ERROR;
+  logger_init_ex(&config);
+  log_run_producers();
+  logger_close();
+  log_restore_console();
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "producer") == LOG_THREADS * LOG_RECORDS);
+  remove(LOG_FILE);
+  return 0;
+}
+
+#define LOG_MAX_ROTATED 64
+
+typedef struct
+{
+  volatile int32_t count;
+  char paths[LOG_MAX_ROTATED][256];
+} RotatedFiles;
+
+static void log_on_rotate(const char* path, void* user)
+{
+  RotatedFiles* rotated = (RotatedFiles*) user;
+  int32_t i = x_atomic_add_i32(&rotated->count, 1);
+  if (i < LOG_MAX_ROTATED)
+    snprintf(rotated->paths[i], sizeof(rotated->paths[i]), "%s", path);
+}
+
+int test_log_rotation(void)
+{
+  remove(LOG_FILE);
+  static RotatedFiles rotated;
+  rotated.count = 0;
+
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  config.flush = XLOG_FLUSH_INTERVAL;
+  config.flush_interval_ms = 5;
+  config.rotate_size = 64 * 1024;
+  config.on_rotate = log_on_rotate;
+  config.rotate_user = &rotated;
+  logger_init_ex(&config);
+  log_run_producers();
+  logger_close();
+  log_restore_console();
+
+  int count = x_atomic_load_i32(&rotated.count);
+  ASSERT_TRUE(count > 0 && count <= LOG_MAX_ROTATED);
+  int total = log_count_lines(LOG_FILE, "producer");
+  for (int i = 0; i < count; ++i)
+  {
+    FILE* f = fopen(rotated.paths[i], "rb");
+    ASSERT_TRUE(f != NULL);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    ASSERT_TRUE(size > 0 && size <= 64 * 1024);
+    total += log_count_lines(rotated.paths[i], "producer");
+    remove(rotated.paths[i]);
+  }
+  // Nothing lost or split across files
+  ASSERT_TRUE(total == LOG_THREADS * LOG_RECORDS);
+  remove(LOG_FILE);
+  return 0;
+}
+
+static int log_side_effect(int* calls)
+{
+  return ++*calls;
+}
+
+int test_log_lazy_arguments(void)
+{
+  int calls = 0;
+  logger_set_level(XLOG_LEVEL_WARNING);
+  for (int i = 0; i < 100; ++i)
+  {
+    x_log_debug("debug %d", log_side_effect(&calls));
+    x_log_info("info %d", log_side_effect(&calls));
+  }
+  ASSERT_TRUE(calls == 0);
+
+  logger_set_level(XLOG_LEVEL_FATAL);
+  x_log_error("error %d", log_side_effect(&calls));
+  x_log_bin(XLOG_LEVEL_ERROR, "binary %d", log_side_effect(&calls));
+  ASSERT_TRUE(calls == 0);
+
+  logger_set_level(XLOG_LEVEL_ERROR);
+  ASSERT_TRUE(x_log_enabled(XLOG_LEVEL_ERROR));
+  ASSERT_FALSE(x_log_enabled(XLOG_LEVEL_WARNING));
+  logger_set_level(XLOG_LEVEL_DEBUG);
+  return 0;
+}
+
+int test_log_kv(void)
+{
+  static char big[5000];
+  memset(big, 'y', sizeof(big) - 1);
+  big[sizeof(big) - 1] = 0;
+
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+  x_log_kv(XLOG_LEVEL_INFO, "request \"done\"", X_KV_INT("latency_us", -42), X_KV_STR("path", "/a b\n"),
+      X_KV_DOUBLE("ratio", 0.25), X_KV_BOOL("ok", 1), X_KV_UINT("bytes", 18446744073709551615ULL));
+  x_log_kv(XLOG_LEVEL_WARNING, "no fields");
+  logger_close();
+
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "\"level\":\"INFO\",\"msg\":\"request \\\"done\\\"\"") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "\"latency_us\":-42,\"path\":\"/a b\\n\",\"ratio\":0.25,\"ok\":true,\"bytes\":18446744073709551615}") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "\"msg\":\"no fields\",\"file\":") == 1);
+
+  // Shortest digits that read back the same value, with a '.' in any locale
+  remove(LOG_FILE);
+  logger_init_ex(&config);
+  bool comma_locale = setlocale(LC_NUMERIC, "de_DE.UTF-8") != NULL;
+  x_log_kv(XLOG_LEVEL_INFO, "doubles", X_KV_DOUBLE("tenth", 0.1), X_KV_DOUBLE("third", 1.0 / 3.0), X_KV_DOUBLE("big", 1e300));
+  if (comma_locale)
+    setlocale(LC_NUMERIC, "C");
+  logger_close();
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "\"tenth\":0.1,\"third\":0.3333333333333333,\"big\":1e+300}") == 1);
+
+  // Not truncated: the whole payload and the closing brace are there
+  remove(LOG_FILE);
+  logger_init_ex(&config);
+  x_log_kv(XLOG_LEVEL_INFO, "long", X_KV_STR("payload", big));
+  logger_close();
+  FILE* f = fopen(LOG_FILE, "r");
+  ASSERT_TRUE(f != NULL);
+  char line[8192];
+  int long_lines = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    if (strstr(line, big) && strstr(line, "}\n"))
+      long_lines++;
+  }
+  fclose(f);
+  ASSERT_TRUE(long_lines == 1);
+
+  remove(LOG_FILE);
+  config.kv_format = XLOG_KV_LOGFMT;
+  config.async = true;
+  logger_init_ex(&config);
+  x_log_kv(XLOG_LEVEL_ERROR, "disk full", X_KV_STR("mount", "/var"), X_KV_STR("note", "two words"), X_KV_INT("free", 0));
+  logger_close();
+  log_restore_console();
+  ASSERT_TRUE(log_count_lines(LOG_FILE, " level=ERROR msg=\"disk full\" file=") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, " mount=/var note=\"two words\" free=0\n") == 1);
+  remove(LOG_FILE);
+  return 0;
+}
+
+static void log_storm(int calls)
+{
+  for (int i = 0; i < calls; ++i)
+    x_log_error_ratelimited(10, "storm %d", i);
+}
+
+int test_log_ratelimit(void)
+{
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+
+  // A burst of up to one second's worth goes through, the rest is counted
+  log_storm(1000);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, ": storm") == 10);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "suppressed") == 0);
+
+  x_thread_sleep_ms(150);
+  log_storm(1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, ": storm") == 11);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "990 similar messages suppressed") == 1);
+
+  // The tail of a burst is reported on flush even if the site goes quiet
+  log_storm(200);
+  int storms = log_count_lines(LOG_FILE, ": storm");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "similar messages suppressed") == 1);
+  logger_flush();
+  char tail[64];
+  snprintf(tail, sizeof(tail), ": %d similar messages suppressed", 200 - (storms - 11));
+  ASSERT_TRUE(log_count_lines(LOG_FILE, tail) == 1);
+  logger_flush();
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "similar messages suppressed") == 2);
+
+  for (int i = 0; i < 100; ++i)
+    x_log_info_sampled(10, "sampled %d", i);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, ": sampled") == 10);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "sampled 0\n") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "sampled 90\n") == 1);
+
+  // Never more than the bucket holds, and a zero rate blocks everything
+  XLogLimiter limiter = { 0 };
+  int32_t suppressed;
+  int passed = 0;
+  for (int i = 0; i < 1000; ++i)
+    passed += logger_ratelimit(&limiter, 100, &suppressed) ? 1 : 0;
+  ASSERT_TRUE(passed >= 100 && passed <= 101);
+  ASSERT_FALSE(logger_ratelimit(&limiter, 0, &suppressed));
+
+  logger_close();
+  log_restore_console();
+  remove(LOG_FILE);
+  return 0;
+}
+
+typedef struct
+{
+  volatile int32_t records;
+  volatile int32_t calls;
+  volatile int32_t below_level;
+  volatile int32_t unformatted;
+  volatile int32_t closed;
+} SinkCounters;
+
+static void log_sink_write(void* user, const XLogRecord* records, size_t count)
+{
+  SinkCounters* c = (SinkCounters*) user;
+  x_atomic_add_i32(&c->calls, 1);
+  for (size_t i = 0; i < count; ++i)
+  {
+    x_atomic_add_i32(&c->records, 1);
+    if (records[i].level < XLOG_LEVEL_INFO)
+      x_atomic_add_i32(&c->below_level, 1);
+    if (records[i].length < 3 || memcmp(records[i].text, ">> ", 3) != 0)
+      x_atomic_add_i32(&c->unformatted, 1);
+  }
+}
+
+static size_t log_sink_format(void* user, const XLogRecord* record, char* dst, size_t cap)
+{
+  (void) user;
+  if (record->length + 3 <= cap)
+  {
+    memcpy(dst, ">> ", 3);
+    memcpy(dst + 3, record->text, record->length);
+  }
+  return record->length + 3;
+}
+
+static void log_sink_close(void* user)
+{
+  x_atomic_add_i32(&((SinkCounters*) user)->closed, 1);
+}
+
+// Logs from inside the callback and counts the async writer's drop notes
+static void log_sink_reenter(void* user, const XLogRecord* records, size_t count)
+{
+  SinkCounters* c = (SinkCounters*) user;
+  for (size_t i = 0; i < count; ++i)
+  {
+    x_atomic_add_i32(&c->records, 1);
+    if (records[i].length > 15 && strstr(records[i].text, "records dropped"))
+      x_atomic_add_i32(&c->calls, 1);
+  }
+  x_log_error("from inside a sink");
+}
+
+int test_log_sinks(void)
+{
+  remove(LOG_FILE);
+  SinkCounters counters = { 0 };
+  XLogSinkDesc desc = { 0 };
+  desc.level = XLOG_LEVEL_INFO;
+  desc.write = log_sink_write;
+  desc.format = log_sink_format;
+  desc.close = log_sink_close;
+  desc.user = &counters;
+  XLogSink* sink = logger_add_sink(&desc);
+  XLogSink* memory = logger_add_memory_sink(XLOG_LEVEL_WARNING, 256);
+  ASSERT_TRUE(sink != NULL && memory != NULL);
+
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_DEBUG;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+
+  // Synchronous: one record per call, filtered by the sink's own level
+  x_log_debug("not for the sink");
+  x_log_info("for the sink");
+  ASSERT_TRUE(counters.records == 1 && counters.calls == 1);
+  for (int i = 0; i < 20; ++i)
+    x_log_warning("memory %d", i);
+  char text[512];
+  size_t held = logger_memory_sink_read(memory, text, sizeof(text));
+  // Only the most recent whole lines fit
+  ASSERT_TRUE(held > 0 && held <= 256 && held == strlen(text));
+  ASSERT_TRUE(strstr(text, "memory 19\n") != NULL);
+  ASSERT_TRUE(strstr(text, "memory 0\n") == NULL);
+  ASSERT_TRUE(text[held - 1] == '\n' && strncmp(text, "WARNING", 7) == 0);
+  logger_close();
+
+  // Asynchronous: records arrive in batches from the writer thread
+  memset((void*) &counters, 0, sizeof(counters));
+  config.async = true;
+  config.queue_capacity = 4096;
+  config.overflow = XLOG_OVERFLOW_BLOCK;
+  logger_init_ex(&config);
+  log_run_producers();
+  x_log_debug("not for the sink");
+  logger_flush();
+  logger_close();
+  ASSERT_TRUE(counters.records == LOG_THREADS * LOG_RECORDS);
+  ASSERT_TRUE(counters.calls < counters.records);
+  ASSERT_TRUE(counters.below_level == 0);
+  ASSERT_TRUE(counters.unformatted == 0);
+
+#ifndef _WIN32
+  // A datagram sink with syslog framing
+  const char* path = "test_tmp_log_socket";
+  remove(path);
+  int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  struct sockaddr_un addr = { 0 };
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  ASSERT_TRUE(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+  XLogSink* unix_sink = logger_add_unix_sink(XLOG_LEVEL_INFO, path, "stdx");
+  ASSERT_TRUE(unix_sink != NULL);
+  config.async = false;
+  logger_init_ex(&config);
+  x_log_error("over the socket");
+  char datagram[512];
+  ssize_t n = recv(fd, datagram, sizeof(datagram) - 1, MSG_DONTWAIT);
+  ASSERT_TRUE(n > 0);
+  datagram[n] = 0;
+  ASSERT_TRUE(strncmp(datagram, "<11>stdx: ERROR", 15) == 0);
+  ASSERT_TRUE(strstr(datagram, "over the socket") != NULL && datagram[n - 1] != '\n');
+  logger_remove_sink(unix_sink);
+  close(fd);
+  remove(path);
+#endif
+
+  int32_t delivered = counters.records;
+  logger_remove_sink(sink);
+  logger_remove_sink(memory);
+  ASSERT_TRUE(counters.closed == 1);
+  x_log_info("after removal");
+  ASSERT_TRUE(counters.records == delivered);
+
+  // A sink that logs neither deadlocks nor feeds itself; its records are
+  // dropped and counted
+  SinkCounters reentry = { 0 };
+  XLogSinkDesc reenter = { 0 };
+  reenter.level = XLOG_LEVEL_DEBUG;
+  reenter.write = log_sink_reenter;
+  reenter.user = &reentry;
+  XLogSink* looping = logger_add_sink(&reenter);
+  ASSERT_TRUE(looping != NULL);
+  x_log_info("into the looping sink");
+  XLogStats stats;
+  logger_stats(&stats);
+  ASSERT_TRUE(reentry.records == 1 && stats.records_dropped == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "from inside a sink") == 0);
+
+  // The async writer's drop notes reach the sinks too
+  config.async = true;
+  config.queue_capacity = 8;
+  config.overflow = XLOG_OVERFLOW_COUNT;
+  logger_init_ex(&config);
+  log_run_producers();
+  logger_close();
+  logger_stats(&stats);
+  logger_remove_sink(looping);
+  if (stats.records_dropped > (uint64_t) reentry.records)
+    ASSERT_TRUE(reentry.calls > 0);
+
+  logger_close();
+  log_restore_console();
+  remove(LOG_FILE);
+  return 0;
+}
+
+#define FLIGHT_THREADS 3
+#define FLIGHT_RECORDS 16
+
+static volatile int32_t s_flight_done = 0;
+
+static void* log_flight_producer(void* arg)
+{
+  int id = (int)(intptr_t) arg;
+  for (int i = 0; i < 100; ++i)
+    x_log_debug("flight %d %d", id, i);
+  // Stay alive until every producer recorded, so none takes over another's ring
+  x_atomic_add_i32(&s_flight_done, 1);
+  while (x_atomic_load_i32(&s_flight_done) < FLIGHT_THREADS)
+    x_thread_yield();
+  return NULL;
+}
+
+static void* log_flight_once(void* arg)
+{
+  x_log_debug("churn %d", (int)(intptr_t) arg);
+  return NULL;
+}
+
+#ifndef _WIN32
+static int s_crash_fd = -1;
+
+static void log_on_crash(int sig)
+{
+  (void) sig;
+  logger_flight_dump(s_crash_fd);
+  _exit(0);
+}
+#endif
+
+int test_log_flight_recorder(void)
+{
+  remove(LOG_FILE);
+  remove(LOG_DUMP_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_INFO;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+  ASSERT_FALSE(x_log_enabled(XLOG_LEVEL_DEBUG));
+  ASSERT_TRUE(logger_flight_enable(XLOG_LEVEL_DEBUG, FLIGHT_RECORDS));
+  ASSERT_TRUE(x_log_enabled(XLOG_LEVEL_DEBUG));
+  ASSERT_TRUE(logger_get_level() == XLOG_LEVEL_INFO);
+
+  // Record here first, so this thread does not take over a producer's ring
+  x_log_debug("flight start");
+  XThread* threads[FLIGHT_THREADS];
+  x_atomic_store_i32(&s_flight_done, 0);
+  for (int i = 0; i < FLIGHT_THREADS; ++i)
+    x_thread_create(&threads[i], log_flight_producer, (void*)(intptr_t) i);
+  for (int i = 0; i < FLIGHT_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+  x_log_info("flight output");
+
+  // Debug records reach the recorder but not the outputs
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "DEBUG") == 0);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, ": flight output") == 1);
+
+  FILE* f = fopen(LOG_DUMP_FILE, "w");
+  ASSERT_TRUE(f != NULL);
+  size_t dumped = logger_flight_dump(fileno(f));
+  fclose(f);
+  ASSERT_TRUE(dumped == FLIGHT_THREADS * FLIGHT_RECORDS + 2);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, "--- flight recorder, thread ") == FLIGHT_THREADS + 1);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, "(this thread)") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, "DEBUG") == FLIGHT_THREADS * FLIGHT_RECORDS + 1);
+  // Only the newest records of each thread are kept
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, ": flight 1 99\n") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, ": flight 1 84\n") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, ": flight 1 83\n") == 0);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, "(exited)") == FLIGHT_THREADS);
+
+  // Threads that come and go take over the rings of exited ones
+  for (int i = 0; i < 50; ++i)
+  {
+    XThread* t;
+    x_thread_create(&t, log_flight_once, (void*)(intptr_t) i);
+    x_thread_join(t);
+    x_thread_destroy(t);
+  }
+  int rings = 0;
+  for (XLogFlightRing* ring = g_log_flight->rings; ring; ring = ring->next)
+    rings++;
+  ASSERT_TRUE(rings == FLIGHT_THREADS + 1);
+  f = fopen(LOG_DUMP_FILE, "w");
+  ASSERT_TRUE(f != NULL);
+  logger_flight_dump(fileno(f));
+  fclose(f);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, ": churn 49\n") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_DUMP_FILE, ": churn 48\n") == 0);
+
+  // Long records are cut but stay one line
+  char big[1000];
+  memset(big, 'x', sizeof(big) - 1);
+  big[sizeof(big) - 1] = 0;
+  x_log_debug("%s", big);
+
+#ifndef _WIN32
+  // Dump from a real crash, in a child so the test survives it
+  int fds[2];
+  ASSERT_TRUE(pipe(fds) == 0);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    close(fds[0]);
+    s_crash_fd = fds[1];
+    signal(SIGSEGV, log_on_crash);
+    x_log_debug("about to crash");
+    raise(SIGSEGV);
+    _exit(1);
+  }
+  close(fds[1]);
+  char dump[16384];
+  size_t len = 0;
+  ssize_t n;
+  while (len < sizeof(dump) - 1 && (n = read(fds[0], dump + len, sizeof(dump) - 1 - len)) > 0)
+    len += (size_t) n;
+  dump[len] = 0;
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  ASSERT_TRUE(strstr(dump, "(this thread)") != NULL);
+  char* last = strstr(dump, ": about to crash\n");
+  ASSERT_TRUE(last != NULL && last[strlen(": about to crash\n")] == 0);
+  ASSERT_TRUE(strstr(dump, "xxxxxxxxxx\n") != NULL);
+#endif
+
+  logger_flight_disable();
+  ASSERT_FALSE(x_log_enabled(XLOG_LEVEL_DEBUG));
+  ASSERT_TRUE(logger_flight_dump(2) == 0);
+
+  logger_close();
+  log_restore_console();
+  remove(LOG_FILE);
+  remove(LOG_DUMP_FILE);
+  return 0;
+}
+
+X_LOG_CATEGORY_DEFINE(log_net, "net");
+X_LOG_CATEGORY_DEFINE(log_fs, "fs");
+X_LOG_CATEGORY_DEFINE(log_pool, "pool");
+
+#define LOG_CATEGORY_RECORDS 2000
+
+static void* log_category_producer(void* arg)
+{
+  const char* what = (const char*) arg;
+  for (int i = 0; i < LOG_CATEGORY_RECORDS; ++i)
+    x_log_cat_debug(log_pool, "pool %s %d", what, i);
+  return NULL;
+}
+
+static void log_category_run(const char* what)
+{
+  XThread* threads[LOG_THREADS];
+  for (int i = 0; i < LOG_THREADS; ++i)
+    x_thread_create(&threads[i], log_category_producer, (void*) what);
+  for (int i = 0; i < LOG_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+}
+
+int test_log_categories(void)
+{
+  remove(LOG_FILE);
+  XLogConfig config = { 0 };
+  config.outputs = XLOG_OUTPUT_FILE;
+  config.level = XLOG_LEVEL_INFO;
+  config.filename = LOG_FILE;
+  logger_init_ex(&config);
+
+  // Set by name before the category was ever used
+  logger_category_set_level("net", XLOG_LEVEL_DEBUG);
+  ASSERT_TRUE(log_net.threshold == X_LOG_UNREGISTERED);
+  ASSERT_TRUE(logger_category_get_level("net") == XLOG_LEVEL_DEBUG);
+  ASSERT_TRUE(logger_category_get_level("fs") == XLOG_LEVEL_INFO);
+
+  x_log_cat_debug(log_net, "net verbose");
+  x_log_cat_debug(log_fs, "fs verbose");
+  x_log_cat_info(log_fs, "fs normal");
+  x_log_debug("global verbose");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "[net] net verbose\n") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "fs verbose") == 0);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "[fs] fs normal\n") == 1);
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "global verbose") == 0);
+  ASSERT_TRUE(x_log_category_enabled(log_net, XLOG_LEVEL_DEBUG));
+  ASSERT_FALSE(x_log_category_enabled(log_fs, XLOG_LEVEL_DEBUG));
+
+  // Runtime changes, as from a config reload
+  logger_category_set_level("fs", XLOG_LEVEL_ERROR);
+  x_log_cat_warning(log_fs, "fs warning");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "fs warning") == 0);
+  logger_category_set_level("net", X_LOG_LEVEL_INHERIT);
+  ASSERT_FALSE(x_log_category_enabled(log_net, XLOG_LEVEL_DEBUG));
+  logger_set_level(XLOG_LEVEL_DEBUG);
+  ASSERT_TRUE(x_log_category_enabled(log_net, XLOG_LEVEL_DEBUG));
+  ASSERT_FALSE(x_log_category_enabled(log_fs, XLOG_LEVEL_WARNING));
+
+  // The flight recorder lowers what the check lets through, not what is written
+  logger_set_level(XLOG_LEVEL_INFO);
+  ASSERT_TRUE(logger_flight_enable(XLOG_LEVEL_DEBUG, 8));
+  ASSERT_TRUE(x_log_category_enabled(log_fs, XLOG_LEVEL_DEBUG));
+  x_log_cat_debug(log_fs, "fs recorded");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "fs recorded") == 0);
+  logger_flight_disable();
+  ASSERT_FALSE(x_log_category_enabled(log_fs, XLOG_LEVEL_WARNING));
+
+  // Levels change while other threads log in the category
+  XThread* threads[LOG_THREADS];
+  for (int i = 0; i < LOG_THREADS; ++i)
+    x_thread_create(&threads[i], log_category_producer, (void*) "churn");
+  for (int i = 0; i < 100; ++i)
+    logger_category_set_level("pool", (i & 1) ? XLOG_LEVEL_DEBUG : XLOG_LEVEL_ERROR);
+  for (int i = 0; i < LOG_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+  int churned = log_count_lines(LOG_FILE, "[pool] pool churn");
+  ASSERT_TRUE(churned >= 0 && churned <= LOG_THREADS * LOG_CATEGORY_RECORDS);
+
+  // Once the level settles, every thread sees it
+  logger_category_set_level("pool", XLOG_LEVEL_DEBUG);
+  log_category_run("record");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "[pool] pool record") == LOG_THREADS * LOG_CATEGORY_RECORDS);
+  logger_category_set_level("pool", XLOG_LEVEL_ERROR);
+  log_category_run("quiet");
+  ASSERT_TRUE(log_count_lines(LOG_FILE, "[pool] pool quiet") == 0);
+
+  logger_category_set_level("net", X_LOG_LEVEL_INHERIT);
+  logger_category_set_level("fs", X_LOG_LEVEL_INHERIT);
+  logger_category_set_level("pool", X_LOG_LEVEL_INHERIT);
+  logger_close();
+  log_restore_console();
+  remove(LOG_FILE);
+  return 0;
+}
+
+int main()
+{
+  STDXTestCase tests[] =
+  {
+    TEST_CASE(test_log_async_block),
+    TEST_CASE(test_log_async_overflow),
+    TEST_CASE(test_log_long_record),
+    TEST_CASE(test_log_reinit_while_logging),
+    TEST_CASE(test_log_reinit_many_threads),
+    TEST_CASE(test_log_binary_decode),
+    TEST_CASE(test_log_binary_corrupt),
+    TEST_CASE(test_log_binary_thread_churn),
+    TEST_CASE(test_log_binary_background),
+    TEST_CASE(test_log_timestamps),
+    TEST_CASE(test_log_flush_policy),
+    TEST_CASE(test_log_rotation),
+    TEST_CASE(test_log_lazy_arguments),
+    TEST_CASE(test_log_kv),
+    TEST_CASE(test_log_ratelimit),
+    TEST_CASE(test_log_sinks),
+    TEST_CASE(test_log_flight_recorder),
+    TEST_CASE(test_log_categories),
+  };
+
+  return stdx_run_tests(tests, sizeof(tests)/sizeof(tests[0]));
+}
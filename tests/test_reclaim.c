@@ -0,0 +1,257 @@
+#define STDX_IMPLEMENTATION_TEST
+#include <stdx_test.h>
+#define STDX_IMPLEMENTATION_THREAD
+#include <stdx_thread.h>
+#define STDX_IMPLEMENTATION_RECLAIM
+#include <stdx_reclaim.h>
+
+#include <stdlib.h>
+
+#define NODE_ALIVE 0x600DF00Du
+#define NODE_DEAD  0xDEADBEEFu
+
+typedef struct
+{
+  volatile uint32_t magic;
+  int value;
+} Node;
+
+static volatile int32_t s_freed;
+
+static void node_free(void* ptr, void* ctx)
+{
+  (void) ctx;
+  Node* node = (Node*) ptr;
+  // Poison first so a reader racing the free is caught by its magic check
+  x_atomic_store_i32((volatile int32_t*) &node->magic, (int32_t) NODE_DEAD);
+  x_atomic_add_i32(&s_freed, 1);
+  free(node);
+}
+
+static Node* node_new(int value)
+{
+  Node* node = malloc(sizeof(Node));
+  node->magic = NODE_ALIVE;
+  node->value = value;
+  return node;
+}
+
+typedef struct
+{
+  XEbr* ebr;
+  volatile int32_t state;   // 1 = inside, 2 = may leave
+} PinArgs;
+
+static void* ebr_pin_reader(void* arg)
+{
+  PinArgs* args = (PinArgs*) arg;
+  XEbrThread* self = x_ebr_register(args->ebr);
+  x_ebr_enter(self);
+  x_atomic_store_i32(&args->state, 1);
+  while (x_atomic_load_i32(&args->state) != 2)
+    x_thread_yield();
+  x_ebr_leave(self);
+  x_ebr_unregister(self);
+  return NULL;
+}
+
+int test_ebr_reader_blocks_reclaim(void)
+{
+  s_freed = 0;
+  XEbr* ebr = x_ebr_create();
+  XEbrThread* self = x_ebr_register(ebr);
+
+  PinArgs args = { ebr, 0 };
+  XThread* reader;
+  x_thread_create(&reader, ebr_pin_reader, &args);
+  while (x_atomic_load_i32(&args.state) != 1)
+    x_thread_yield();
+
+  for (int i = 0; i < 10; ++i)
+    ASSERT_TRUE(x_ebr_retire(self, node_new(i), node_free, NULL));
+  for (int i = 0; i < 10; ++i)
+    x_ebr_reclaim(self);
+
+  // The pinned reader may still hold any of them
+  ASSERT_TRUE(s_freed == 0);
+  ASSERT_TRUE(x_ebr_pending(self) == 10);
+
+  x_atomic_store_i32(&args.state, 2);
+  x_thread_join(reader);
+  x_thread_destroy(reader);
+
+  size_t freed = 0;
+  for (int i = 0; i < 3; ++i)
+    freed += x_ebr_reclaim(self);
+  ASSERT_TRUE(freed == 10);
+  ASSERT_TRUE(s_freed == 10);
+  ASSERT_TRUE(x_ebr_pending(self) == 0);
+
+  // Whatever is left at destroy time is freed too
+  x_ebr_retire(self, node_new(0), node_free, NULL);
+  x_ebr_unregister(self);
+  x_ebr_destroy(ebr);
+  ASSERT_TRUE(s_freed == 11);
+  return 0;
+}
+
+#define RECLAIM_READERS 4
+#define RECLAIM_UPDATES 20000
+
+typedef struct
+{
+  XEbr* ebr;
+  XHazardDomain* domain;
+  Node* volatile shared;
+  volatile int32_t done;
+  volatile int32_t bad_reads;
+} SharedArgs;
+
+static void* ebr_reader(void* arg)
+{
+  SharedArgs* args = (SharedArgs*) arg;
+  XEbrThread* self = x_ebr_register(args->ebr);
+  while (!x_atomic_load_i32(&args->done))
+  {
+    x_ebr_enter(self);
+    Node* node = (Node*) x_atomic_load_ptr((void* volatile*) &args->shared);
+    if ((uint32_t) x_atomic_load_i32((volatile int32_t*) &node->magic) != NODE_ALIVE)
+      x_atomic_add_i32(&args->bad_reads, 1);
+    x_ebr_leave(self);
+  }
+  x_ebr_unregister(self);
+  return NULL;
+}
+
+int test_ebr_concurrent(void)
+{
+  s_freed = 0;
+  SharedArgs args = { 0 };
+  args.ebr = x_ebr_create();
+  args.shared = node_new(0);
+
+  XThread* readers[RECLAIM_READERS];
+  for (int i = 0; i < RECLAIM_READERS; ++i)
+    x_thread_create(&readers[i], ebr_reader, &args);
+
+  XEbrThread* self = x_ebr_register(args.ebr);
+  for (int i = 1; i <= RECLAIM_UPDATES; ++i)
+  {
+    Node* old = (Node*) x_atomic_exchange_ptr((void* volatile*) &args.shared, node_new(i));
+    ASSERT_TRUE(x_ebr_retire(self, old, node_free, NULL));
+  }
+
+  // Batching keeps the backlog bounded while readers are active
+  ASSERT_TRUE(x_ebr_pending(self) < RECLAIM_UPDATES);
+
+  x_atomic_store_i32(&args.done, 1);
+  for (int i = 0; i < RECLAIM_READERS; ++i)
+  {
+    x_thread_join(readers[i]);
+    x_thread_destroy(readers[i]);
+  }
+
+  for (int i = 0; i < 3; ++i)
+    x_ebr_reclaim(self);
+  ASSERT_TRUE(x_ebr_pending(self) == 0);
+  ASSERT_TRUE(s_freed == RECLAIM_UPDATES);
+  ASSERT_TRUE(args.bad_reads == 0);
+
+  x_ebr_unregister(self);
+  x_ebr_destroy(args.ebr);
+  free(args.shared);
+  return 0;
+}
+
+static void* hazard_reader(void* arg)
+{
+  SharedArgs* args = (SharedArgs*) arg;
+  XHazardThread* self = x_hazard_register(args->domain);
+  while (!x_atomic_load_i32(&args->done))
+  {
+    Node* node = (Node*) x_hazard_protect(self, 0, (void* volatile*) &args->shared);
+    if ((uint32_t) x_atomic_load_i32((volatile int32_t*) &node->magic) != NODE_ALIVE)
+      x_atomic_add_i32(&args->bad_reads, 1);
+    x_hazard_clear(self, 0);
+  }
+  x_hazard_unregister(self);
+  return NULL;
+}
+
+int test_hazard_concurrent(void)
+{
+  s_freed = 0;
+  SharedArgs args = { 0 };
+  args.domain = x_hazard_create();
+  args.shared = node_new(0);
+
+  XThread* readers[RECLAIM_READERS];
+  for (int i = 0; i < RECLAIM_READERS; ++i)
+    x_thread_create(&readers[i], hazard_reader, &args);
+
+  XHazardThread* self = x_hazard_register(args.domain);
+  for (int i = 1; i <= RECLAIM_UPDATES; ++i)
+  {
+    Node* old = (Node*) x_atomic_exchange_ptr((void* volatile*) &args.shared, node_new(i));
+    ASSERT_TRUE(x_hazard_retire(self, old, node_free, NULL));
+  }
+
+  // At most one protected node per reader slot can be held back after a scan
+  x_hazard_scan(self);
+  ASSERT_TRUE(x_hazard_pending(self) <= RECLAIM_READERS * STDX_HAZARD_SLOTS);
+
+  x_atomic_store_i32(&args.done, 1);
+  for (int i = 0; i < RECLAIM_READERS; ++i)
+  {
+    x_thread_join(readers[i]);
+    x_thread_destroy(readers[i]);
+  }
+
+  x_hazard_scan(self);
+  ASSERT_TRUE(x_hazard_pending(self) == 0);
+  ASSERT_TRUE(s_freed == RECLAIM_UPDATES);
+  ASSERT_TRUE(args.bad_reads == 0);
+
+  x_hazard_unregister(self);
+  x_hazard_destroy(args.domain);
+  free(args.shared);
+  return 0;
+}
+
+int test_hazard_protects_slot(void)
+{
+  s_freed = 0;
+  XHazardDomain* domain = x_hazard_create();
+  XHazardThread* reader = x_hazard_register(domain);
+  XHazardThread* writer = x_hazard_register(domain);
+
+  Node* node = node_new(1);
+  x_hazard_set(reader, 1, node);
+  x_hazard_retire(writer, node, node_free, NULL);
+  ASSERT_TRUE(x_hazard_scan(writer) == 0);
+  ASSERT_TRUE(node->magic == NODE_ALIVE);
+
+  x_hazard_clear(reader, 1);
+  ASSERT_TRUE(x_hazard_scan(writer) == 1);
+  ASSERT_TRUE(s_freed == 1);
+
+  // Unregistered records are handed out again
+  x_hazard_unregister(reader);
+  ASSERT_TRUE(x_hazard_register(domain) == reader);
+
+  x_hazard_destroy(domain);
+  return 0;
+}
+
+int main()
+{
+  STDXTestCase tests[] =
+  {
+    TEST_CASE(test_ebr_reader_blocks_reclaim),
+    TEST_CASE(test_ebr_concurrent),
+    TEST_CASE(test_hazard_concurrent),
+    TEST_CASE(test_hazard_protects_slot),
+  };
+
+  return stdx_run_tests(tests, sizeof(tests)/sizeof(tests[0]));
+}
@@ -2,6 +2,10 @@
 #include <stdx_test.h>
 #define STDX_IMPLEMENTATION_THREAD
 #include <stdx_thread.h>
+#include <string.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
 
 // Threading globals
 XMutex* lock_a;
@@ -56,11 +60,432 @@ int test_producer_consumer(void)
   return 0;
 }
 
+int test_mpmc_fifo(void)
+{
+  XMpmcQueue* q = x_mpmc_create(sizeof(int), 6);
+  ASSERT_TRUE(q != NULL);
+  ASSERT_TRUE(x_mpmc_capacity(q) == 8);
+
+  int value;
+  ASSERT_FALSE(x_mpmc_try_pop(q, &value));
+  for (int i = 0; i < 8; ++i)
+    ASSERT_TRUE(x_mpmc_try_push(q, &i));
+
+  value = 100;
+  ASSERT_FALSE(x_mpmc_try_push(q, &value));
+  ASSERT_TRUE(x_mpmc_count(q) == 8);
+
+  for (int i = 0; i < 8; ++i)
+  {
+    ASSERT_TRUE(x_mpmc_try_pop(q, &value));
+    ASSERT_TRUE(value == i);
+  }
+  ASSERT_FALSE(x_mpmc_try_pop(q, &value));
+
+  x_mpmc_destroy(q);
+  return 0;
+}
+
+#define MPMC_PRODUCERS 4
+#define MPMC_ITEMS_PER_PRODUCER 50000
+
+typedef struct
+{
+  XMpmcQueue* q;
+  int64_t sum;
+  int base;
+} MpmcWorker;
+
+static void* mpmc_producer(void* arg)
+{
+  MpmcWorker* w = (MpmcWorker*) arg;
+  for (int i = 1; i <= MPMC_ITEMS_PER_PRODUCER; ++i)
+  {
+    int value = w->base + i;
+    x_mpmc_push(w->q, &value);
+  }
+  return NULL;
+}
+
+static void* mpmc_consumer(void* arg)
+{
+  MpmcWorker* w = (MpmcWorker*) arg;
+  for (int i = 0; i < MPMC_ITEMS_PER_PRODUCER; ++i)
+  {
+    int value;
+    x_mpmc_pop(w->q, &value);
+    w->sum += value;
+  }
+  return NULL;
+}
+
+int test_mpmc_concurrent(void)
+{
+  // A small capacity keeps both producers and consumers parking
+  XMpmcQueue* q = x_mpmc_create(sizeof(int), 16);
+  MpmcWorker producers[MPMC_PRODUCERS];
+  MpmcWorker consumers[MPMC_PRODUCERS];
+  XThread* threads[MPMC_PRODUCERS * 2];
+  int64_t expected = 0;
+
+  for (int i = 0; i < MPMC_PRODUCERS; ++i)
+  {
+    producers[i].q = consumers[i].q = q;
+    producers[i].sum = consumers[i].sum = 0;
+    producers[i].base = i * 1000000;
+    for (int j = 1; j <= MPMC_ITEMS_PER_PRODUCER; ++j)
+      expected += producers[i].base + j;
+    x_thread_create(&threads[i], mpmc_consumer, &consumers[i]);
+    x_thread_create(&threads[MPMC_PRODUCERS + i], mpmc_producer, &producers[i]);
+  }
+
+  int64_t sum = 0;
+  for (int i = 0; i < MPMC_PRODUCERS * 2; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+  for (int i = 0; i < MPMC_PRODUCERS; ++i)
+    sum += consumers[i].sum;
+
+  ASSERT_TRUE(sum == expected);
+  ASSERT_TRUE(x_mpmc_count(q) == 0);
+  x_mpmc_destroy(q);
+  return 0;
+}
+
+int test_spsc_spans(void)
+{
+  XSpscQueue* q = x_spsc_create(sizeof(int), 8, false);
+  ASSERT_TRUE(q != NULL);
+
+  // Advance both indices so the next batch wraps around the end
+  int value = 0;
+  for (int i = 0; i < 6; ++i)
+  {
+    ASSERT_TRUE(x_spsc_try_push(q, &i));
+    ASSERT_TRUE(x_spsc_try_pop(q, &value));
+    ASSERT_TRUE(value == i);
+  }
+
+  void* span;
+  size_t n = x_spsc_write_begin(q, &span);
+  ASSERT_TRUE(n == 2);
+  ((int*) span)[0] = 10;
+  ((int*) span)[1] = 11;
+  x_spsc_write_commit(q, 2);
+
+  n = x_spsc_write_begin(q, &span);
+  ASSERT_TRUE(n == 6);
+  for (int i = 0; i < 6; ++i)
+    ((int*) span)[i] = 12 + i;
+  x_spsc_write_commit(q, 6);
+
+  value = 99;
+  ASSERT_FALSE(x_spsc_try_push(q, &value));
+
+  n = x_spsc_read_begin(q, &span);
+  ASSERT_TRUE(n == 2);
+  ASSERT_TRUE(((int*) span)[0] == 10 && ((int*) span)[1] == 11);
+  x_spsc_read_commit(q, 2);
+
+  n = x_spsc_read_begin(q, &span);
+  ASSERT_TRUE(n == 6);
+  ASSERT_TRUE(((int*) span)[5] == 17);
+  x_spsc_read_commit(q, 6);
+  ASSERT_FALSE(x_spsc_try_pop(q, &value));
+
+  x_spsc_destroy(q);
+
+  // A stale cached index must not shorten the span: fill the ring, let the
+  // producer cache the tail halfway through the next lap, then drain
+  q = x_spsc_create(sizeof(int), 8, false);
+  for (int i = 0; i < 8; ++i)
+    ASSERT_TRUE(x_spsc_try_push(q, &i));
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(x_spsc_try_pop(q, &value));
+  ASSERT_TRUE(x_spsc_try_push(q, &value));
+  for (int i = 0; i < 5; ++i)
+    ASSERT_TRUE(x_spsc_try_pop(q, &value));
+  n = x_spsc_write_begin(q, &span);
+  ASSERT_TRUE(n == 7);
+
+  x_spsc_destroy(q);
+  return 0;
+}
+
+#define SPSC_ITEMS 1000000
+
+static void* spsc_producer(void* arg)
+{
+  XSpscQueue* q = (XSpscQueue*) arg;
+  int next = 0;
+  while (next < SPSC_ITEMS)
+  {
+    void* span;
+    size_t n = x_spsc_write_begin(q, &span);
+    if (n == 0)
+    {
+      x_spsc_wait_writable(q);
+      continue;
+    }
+    size_t written = 0;
+    while (written < n && next < SPSC_ITEMS)
+      ((int*) span)[written++] = next++;
+    x_spsc_write_commit(q, written);
+  }
+  return NULL;
+}
+
+int test_spsc_concurrent(void)
+{
+  XSpscQueue* q = x_spsc_create(sizeof(int), 64, true);
+  XThread* producer_thread;
+  x_thread_create(&producer_thread, spsc_producer, q);
+
+  // Items must come out in order, none lost or duplicated
+  bool in_order = true;
+  for (int expected = 0; expected < SPSC_ITEMS; ++expected)
+  {
+    int value;
+    x_spsc_pop(q, &value);
+    if (value != expected)
+      in_order = false;
+  }
+
+  x_thread_join(producer_thread);
+  x_thread_destroy(producer_thread);
+  x_spsc_destroy(q);
+  ASSERT_TRUE(in_order);
+  return 0;
+}
+
+#define SYNC_THREADS 6
+
+typedef struct
+{
+  XSemaphore* sem;
+  volatile int32_t inside;
+  volatile int32_t max_inside;
+  XBarrier* barrier;
+  volatile int32_t phase_counter[8];
+  volatile int32_t leaders[8];
+  XLatch* latch;
+} SyncShared;
+
+static void* semaphore_worker(void* arg)
+{
+  SyncShared* s = (SyncShared*) arg;
+  for (int i = 0; i < 500; ++i)
+  {
+    x_thread_semaphore_wait(s->sem);
+    int32_t now = x_atomic_add_i32(&s->inside, 1) + 1;
+    int32_t max = x_atomic_load_i32(&s->max_inside);
+    while (now > max && !x_atomic_cas_i32(&s->max_inside, &max, now)) { }
+    x_thread_yield();
+    x_atomic_add_i32(&s->inside, -1);
+    x_thread_semaphore_post(s->sem, 1);
+  }
+  return NULL;
+}
+
+int test_semaphore_limits_concurrency(void)
+{
+  SyncShared s = {0};
+  x_thread_semaphore_init(&s.sem, 2);
+
+  ASSERT_TRUE(x_thread_semaphore_try_wait(s.sem));
+  ASSERT_TRUE(x_thread_semaphore_try_wait(s.sem));
+  ASSERT_FALSE(x_thread_semaphore_try_wait(s.sem));
+  ASSERT_FALSE(x_thread_semaphore_wait_timeout(s.sem, 10));
+  x_thread_semaphore_post(s.sem, 2);
+
+  XThread* threads[SYNC_THREADS];
+  for (int i = 0; i < SYNC_THREADS; ++i)
+    x_thread_create(&threads[i], semaphore_worker, &s);
+  for (int i = 0; i < SYNC_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+
+  ASSERT_TRUE(s.max_inside >= 1 && s.max_inside <= 2);
+  ASSERT_TRUE(x_thread_semaphore_try_wait(s.sem));
+  ASSERT_TRUE(x_thread_semaphore_try_wait(s.sem));
+  ASSERT_FALSE(x_thread_semaphore_try_wait(s.sem));
+  x_thread_semaphore_destroy(s.sem);
+  return 0;
+}
+
+static void* barrier_worker(void* arg)
+{
+  SyncShared* s = (SyncShared*) arg;
+  for (int phase = 0; phase < 8; ++phase)
+  {
+    x_atomic_add_i32(&s->phase_counter[phase], 1);
+    if (x_thread_barrier_wait(s->barrier))
+      x_atomic_add_i32(&s->leaders[phase], 1);
+
+    // Everyone must have arrived at this phase before anyone leaves it
+    if (x_atomic_load_i32(&s->phase_counter[phase]) != SYNC_THREADS)
+      x_atomic_store_i32(&s->leaders[phase], -100);
+  }
+  x_thread_latch_count_down(s->latch, 1);
+  return NULL;
+}
+
+int test_barrier_and_latch(void)
+{
+  SyncShared s = {0};
+  x_thread_barrier_init(&s.barrier, SYNC_THREADS);
+  x_thread_latch_init(&s.latch, SYNC_THREADS);
+  ASSERT_FALSE(x_thread_latch_try_wait(s.latch));
+
+  XThread* threads[SYNC_THREADS];
+  for (int i = 0; i < SYNC_THREADS; ++i)
+    x_thread_create(&threads[i], barrier_worker, &s);
+
+  x_thread_latch_wait(s.latch);
+  ASSERT_TRUE(x_thread_latch_try_wait(s.latch));
+
+  for (int i = 0; i < SYNC_THREADS; ++i)
+  {
+    x_thread_join(threads[i]);
+    x_thread_destroy(threads[i]);
+  }
+
+  for (int phase = 0; phase < 8; ++phase)
+    ASSERT_TRUE(s.leaders[phase] == 1);
+
+  x_thread_barrier_destroy(s.barrier);
+  x_thread_latch_destroy(s.latch);
+  return 0;
+}
+
+typedef struct
+{
+  XEvent* ping;
+  XEvent* pong;
+  volatile int32_t value;
+} PingPong;
+
+static void* event_responder(void* arg)
+{
+  PingPong* p = (PingPong*) arg;
+  for (int i = 0; i < 1000; ++i)
+  {
+    x_thread_event_wait(p->ping);
+    x_atomic_add_i32(&p->value, 1);
+    x_thread_event_set(p->pong);
+  }
+  return NULL;
+}
+
+int test_event_ping_pong(void)
+{
+  PingPong p = {0};
+  x_thread_event_init(&p.ping, false);
+  x_thread_event_init(&p.pong, false);
+  ASSERT_FALSE(x_thread_event_wait_timeout(p.ping, 5));
+
+  XThread* t;
+  x_thread_create(&t, event_responder, &p);
+
+  bool in_step = true;
+  for (int i = 0; i < 1000; ++i)
+  {
+    x_thread_event_set(p.ping);
+    x_thread_event_wait(p.pong);
+    if (x_atomic_load_i32(&p.value) != i + 1)
+      in_step = false;
+  }
+
+  x_thread_join(t);
+  x_thread_destroy(t);
+
+  // Auto-reset: one set satisfies exactly one wait
+  x_thread_event_set(p.ping);
+  ASSERT_TRUE(x_thread_event_wait_timeout(p.ping, 0));
+  ASSERT_FALSE(x_thread_event_wait_timeout(p.ping, 0));
+
+  x_thread_event_destroy(p.ping);
+  x_thread_event_destroy(p.pong);
+  ASSERT_TRUE(in_step);
+  return 0;
+}
+
+typedef struct
+{
+  char name[32];
+  volatile int32_t stack_ok;
+} AttrProbe;
+
+static void* attr_thread(void* arg)
+{
+  AttrProbe* probe = (AttrProbe*) arg;
+#if defined(__linux__)
+  prctl(PR_GET_NAME, probe->name, 0, 0, 0);
+#endif
+  // Would overflow a small default stack
+  volatile char big[512 * 1024];
+  memset((char*) big, 1, sizeof(big));
+  x_atomic_store_i32(&probe->stack_ok, big[sizeof(big) - 1] == 1);
+  return NULL;
+}
+
+int test_thread_attributes(void)
+{
+  ASSERT_TRUE(x_thread_cpu_count() >= 1);
+
+  XCpuSet set;
+  x_cpuset_zero(&set);
+  x_cpuset_add(&set, 0);
+  x_cpuset_add(&set, 65);
+  ASSERT_TRUE(x_cpuset_count(&set) == 2);
+  ASSERT_TRUE(x_cpuset_has(&set, 65));
+  ASSERT_FALSE(x_cpuset_has(&set, 64));
+  ASSERT_TRUE(x_cpuset_nth(&set, 1) == 65);
+  ASSERT_TRUE(x_cpuset_nth(&set, 2) == -1);
+
+  XCpuSet nodes[8];
+  int num_nodes = x_thread_numa_nodes(nodes, 8);
+  ASSERT_TRUE(num_nodes >= 0);
+  for (int i = 0; i < num_nodes; ++i)
+    ASSERT_TRUE(x_cpuset_count(&nodes[i]) > 0);
+
+  XThreadAttr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.stack_size = 2 * 1024 * 1024;
+  attr.name = "stdx-attr-test-long-name";
+  attr.priority = X_THREAD_PRIORITY_LOW;
+  x_cpuset_add(&attr.affinity, 0);
+
+  AttrProbe probe = { 0 };
+  XThread* t;
+  ASSERT_TRUE(x_thread_create_ex(&t, &attr, attr_thread, &probe) == 0);
+  x_thread_join(t);
+  x_thread_destroy(t);
+
+  ASSERT_TRUE(probe.stack_ok == 1);
+#if defined(__linux__)
+  ASSERT_TRUE(strcmp(probe.name, "stdx-attr-test-") == 0);
+#endif
+  return 0;
+}
+
 int main()
 {
   STDXTestCase tests[] =
   {
     TEST_CASE(test_producer_consumer),
+    TEST_CASE(test_mpmc_fifo),
+    TEST_CASE(test_mpmc_concurrent),
+    TEST_CASE(test_spsc_spans),
+    TEST_CASE(test_spsc_concurrent),
+    TEST_CASE(test_semaphore_limits_concurrency),
+    TEST_CASE(test_barrier_and_latch),
+    TEST_CASE(test_event_ping_pong),
+    TEST_CASE(test_thread_attributes),
   };
 
   return stdx_run_tests(tests, sizeof(tests)/sizeof(tests[0]));
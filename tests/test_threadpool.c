@@ -66,6 +66,633 @@ int test_enqueue_after_destroy(void)
   return 0;
 }
 
+typedef struct
+{
+  volatile int32_t* sequence;
+  int32_t order;
+} GraphStep;
+
+void graph_step_task(void* arg)
+{
+  GraphStep* step = (GraphStep*) arg;
+  step->order = x_atomic_add_i32(step->sequence, 1);
+}
+
+int test_taskgraph_dependencies(void)
+{
+  XThreadPool* pool = threadpool_create(4);
+  XTaskGraph* graph = x_taskgraph_create();
+  ASSERT_TRUE(graph != NULL);
+
+  // a -> (b, c) -> d, plus a wide fan-in into e
+  volatile int32_t sequence = 0;
+  GraphStep steps[16];
+  int nodes[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    steps[i].sequence = &sequence;
+    nodes[i] = x_taskgraph_add_node(graph, graph_step_task, &steps[i]);
+    ASSERT_TRUE(nodes[i] == i);
+  }
+
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 0, 1) == 0);
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 0, 2) == 0);
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 1, 3) == 0);
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 2, 3) == 0);
+  for (int i = 5; i < 16; ++i)
+    ASSERT_TRUE(x_taskgraph_add_edge(graph, i, 4) == 0);
+
+  // The same graph runs several times without being rebuilt
+  for (int run = 0; run < 3; ++run)
+  {
+    sequence = 0;
+    ASSERT_TRUE(x_taskgraph_submit(graph, pool) == 0);
+    x_taskgraph_wait(graph);
+
+    ASSERT_TRUE(sequence == 16);
+    ASSERT_TRUE(steps[0].order < steps[1].order);
+    ASSERT_TRUE(steps[0].order < steps[2].order);
+    ASSERT_TRUE(steps[1].order < steps[3].order);
+    ASSERT_TRUE(steps[2].order < steps[3].order);
+    for (int i = 5; i < 16; ++i)
+      ASSERT_TRUE(steps[i].order < steps[4].order);
+  }
+
+  x_taskgraph_destroy(graph);
+  threadpool_destroy(pool);
+  return 0;
+}
+
+int test_taskgraph_rejects_cycle(void)
+{
+  XThreadPool* pool = threadpool_create(2);
+  XTaskGraph* graph = x_taskgraph_create();
+  volatile int32_t sequence = 0;
+  GraphStep steps[3] = { { &sequence, 0 }, { &sequence, 0 }, { &sequence, 0 } };
+
+  for (int i = 0; i < 3; ++i)
+    x_taskgraph_add_node(graph, graph_step_task, &steps[i]);
+
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 0, 1) == 0);
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 1, 2) == 0);
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 2, 1) == 0);
+  ASSERT_TRUE(x_taskgraph_add_edge(graph, 0, 7) != 0);
+  ASSERT_TRUE(x_taskgraph_submit(graph, pool) != 0);
+  ASSERT_TRUE(sequence == 0);
+
+  x_taskgraph_destroy(graph);
+  threadpool_destroy(pool);
+  return 0;
+}
+
+typedef struct
+{
+  volatile int32_t fired;
+  volatile int64_t fired_at_ns;
+} TimerProbe;
+
+void timer_probe_task(void* arg)
+{
+  TimerProbe* probe = (TimerProbe*) arg;
+  if (x_atomic_add_i32(&probe->fired, 1) == 0)
+    x_atomic_store_i64(&probe->fired_at_ns, (int64_t) x_thread_time_ns());
+}
+
+int test_timer_delays(void)
+{
+  XThreadPool* pool = threadpool_create(2);
+  // Delays spread over several wheel levels
+  const uint32_t delays[] = { 1, 10, 63, 64, 65, 130, 300 };
+  TimerProbe probes[7] = { 0 };
+
+  uint64_t start = x_thread_time_ns();
+  for (int i = 0; i < 7; ++i)
+    ASSERT_TRUE(threadpool_schedule_after(pool, delays[i], timer_probe_task, &probes[i]) != 0);
+
+  x_thread_sleep_ms(450);
+  for (int i = 0; i < 7; ++i)
+  {
+    ASSERT_TRUE(x_atomic_load_i32(&probes[i].fired) == 1);
+    ASSERT_TRUE((uint64_t) x_atomic_load_i64(&probes[i].fired_at_ns) - start >= (uint64_t) delays[i] * 1000000ull);
+  }
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+int test_timer_after_idle(void)
+{
+  XThreadPool* pool = threadpool_create(2);
+  TimerProbe first = { 0 };
+  ASSERT_TRUE(threadpool_schedule_after(pool, 1, timer_probe_task, &first) != 0);
+  x_thread_sleep_ms(200);
+  ASSERT_TRUE(x_atomic_load_i32(&first.fired) == 1);
+
+  // The wheel catches up on the idle time at once, and skips empty level 0
+  // laps while only a far timer is pending
+  TimerProbe far = { 0 };
+  TimerProbe near = { 0 };
+  XTimerId far_id = threadpool_schedule_after(pool, 60000, timer_probe_task, &far);
+  x_thread_sleep_ms(150);
+  uint64_t start = x_thread_time_ns();
+  ASSERT_TRUE(threadpool_schedule_after(pool, 5, timer_probe_task, &near) != 0);
+  x_thread_sleep_ms(100);
+  ASSERT_TRUE(x_atomic_load_i32(&near.fired) == 1);
+  ASSERT_TRUE((uint64_t) x_atomic_load_i64(&near.fired_at_ns) - start >= 5000000ull);
+  ASSERT_TRUE(x_atomic_load_i32(&far.fired) == 0);
+  ASSERT_TRUE(threadpool_cancel_timer(pool, far_id));
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+int test_timer_cancel(void)
+{
+  XThreadPool* pool = threadpool_create(2);
+  TimerProbe once = { 0 };
+  TimerProbe periodic = { 0 };
+
+  XTimerId id = threadpool_schedule_after(pool, 50, timer_probe_task, &once);
+  XTimerId every = threadpool_schedule_every(pool, 5, 5, timer_probe_task, &periodic);
+  ASSERT_TRUE(threadpool_cancel_timer(pool, id));
+  ASSERT_FALSE(threadpool_cancel_timer(pool, id));
+
+  x_thread_sleep_ms(100);
+  ASSERT_TRUE(threadpool_cancel_timer(pool, every));
+  int32_t fired = x_atomic_load_i32(&periodic.fired);
+  ASSERT_TRUE(fired >= 5);
+
+  x_thread_sleep_ms(30);
+  ASSERT_TRUE(x_atomic_load_i32(&once.fired) == 0);
+  // At most one firing may already have been handed to the workers
+  ASSERT_TRUE(x_atomic_load_i32(&periodic.fired) <= fired + 1);
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+void stats_busy_task(void* arg)
+{
+  volatile int32_t* done = (volatile int32_t*) arg;
+  uint64_t until = x_thread_time_ns() + 20000;
+  while (x_thread_time_ns() < until)
+    x_cpu_relax();
+  x_atomic_add_i32(done, 1);
+}
+
+int test_threadpool_stats(void)
+{
+  XThreadPool* pool = threadpool_create(3);
+  volatile int32_t done = 0;
+
+  XThreadPoolStats stats;
+  ASSERT_TRUE(threadpool_stats(pool, &stats, NULL, 0) == 3);
+  ASSERT_TRUE(stats.tasks_executed == 0);
+  ASSERT_TRUE(threadpool_stats_latency_percentile(&stats, 50.0) == 0);
+
+  for (int i = 0; i < 300; ++i)
+    threadpool_enqueue(pool, stats_busy_task, (void*) &done);
+
+  // Counters are published right after each task returns
+  XThreadPoolWorkerStats workers[3];
+  uint64_t deadline = x_thread_time_ns() + 5000000000ull;
+  do
+  {
+    x_thread_yield();
+    threadpool_stats(pool, &stats, workers, 3);
+  } while (stats.tasks_executed < 300 && x_thread_time_ns() < deadline);
+
+  ASSERT_TRUE(stats.tasks_executed == 300);
+  ASSERT_TRUE(stats.queue_depth == 0);
+  ASSERT_TRUE(stats.queue_capacity > 0);
+  ASSERT_TRUE(stats.busy_ns >= 300ull * 20000ull);
+
+  uint64_t per_worker = 0;
+  uint64_t histogram = 0;
+  for (int i = 0; i < 3; ++i)
+    per_worker += workers[i].tasks_executed;
+  for (int b = 0; b < X_THREADPOOL_LATENCY_BUCKETS; ++b)
+    histogram += stats.latency_histogram[b];
+  ASSERT_TRUE(per_worker == 300);
+  ASSERT_TRUE(histogram == 300);
+  ASSERT_TRUE(threadpool_stats_latency_percentile(&stats, 50.0) <= threadpool_stats_latency_percentile(&stats, 99.0));
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+void blocking_sleep_task(void* arg)
+{
+  volatile int32_t* done = (volatile int32_t*) arg;
+  threadpool_blocking_begin();
+  x_thread_sleep_ms(100);
+  threadpool_blocking_end();
+  x_atomic_add_i32(done, 1);
+}
+
+int test_threadpool_elastic(void)
+{
+  XThreadPoolConfig config = { 0 };
+  config.min_threads = 1;
+  config.max_threads = 4;
+  config.idle_timeout_ms = 50;
+  XThreadPool* pool = threadpool_create_ex(&config);
+  ASSERT_TRUE(pool != NULL);
+
+  volatile int32_t done = 0;
+  uint64_t start = x_thread_time_ns();
+  for (int i = 0; i < 4; ++i)
+    threadpool_enqueue(pool, blocking_sleep_task, (void*) &done);
+
+  while (x_atomic_load_i32(&done) < 4)
+    x_thread_sleep_ms(1);
+
+  // The blocking tasks overlapped instead of running one after the other
+  ASSERT_TRUE(x_thread_time_ns() - start < 300000000ull);
+
+  XThreadPoolStats stats;
+  ASSERT_TRUE(threadpool_stats(pool, &stats, NULL, 0) == 4);
+  ASSERT_TRUE(stats.workers_spawned >= 3);
+
+  // Extra workers retire once idle, the minimum stays
+  uint64_t deadline = x_thread_time_ns() + 2000000000ull;
+  do
+  {
+    x_thread_sleep_ms(10);
+    threadpool_stats(pool, &stats, NULL, 0);
+  } while (stats.num_workers > 1 && x_thread_time_ns() < deadline);
+  ASSERT_TRUE(stats.num_workers == 1);
+  ASSERT_TRUE(stats.workers_retired == stats.workers_spawned);
+  ASSERT_TRUE(stats.blocked_workers == 0);
+
+  // Retired slots are reused
+  done = 0;
+  for (int i = 0; i < 2; ++i)
+    threadpool_enqueue(pool, blocking_sleep_task, (void*) &done);
+  while (x_atomic_load_i32(&done) < 2)
+    x_thread_sleep_ms(1);
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+typedef struct
+{
+  volatile int32_t ran;
+  volatile int32_t ran_on_node[2];
+} NodeProbe;
+
+void node_probe_task(void* arg)
+{
+  NodeProbe* probe = (NodeProbe*) arg;
+  int node = threadpool_current_node();
+  if (node >= 0 && node < 2)
+    x_atomic_add_i32(&probe->ran_on_node[node], 1);
+  x_atomic_add_i32(&probe->ran, 1);
+}
+
+int test_threadpool_numa_groups(void)
+{
+  XThreadPoolConfig config = { 0 };
+  config.min_threads = 4;
+  config.numa_aware = true;
+  config.numa_nodes = 2;
+  config.pin_workers = true;
+  config.name = "numa";
+  XThreadPool* pool = threadpool_create_ex(&config);
+  ASSERT_TRUE(pool != NULL);
+  ASSERT_TRUE(threadpool_num_nodes(pool) == 2);
+  ASSERT_TRUE(threadpool_current_node() == -1);
+
+  NodeProbe probe = { 0 };
+  for (int i = 0; i < 400; ++i)
+    ASSERT_TRUE(threadpool_enqueue_on_node(pool, 0, node_probe_task, &probe) == 0);
+
+  XThreadPoolStats stats;
+  XThreadPoolWorkerStats workers[4];
+  uint64_t deadline = x_thread_time_ns() + 5000000000ull;
+  do
+  {
+    x_thread_yield();
+    threadpool_stats(pool, &stats, workers, 4);
+  } while (stats.tasks_executed < 400 && x_thread_time_ns() < deadline);
+
+  ASSERT_TRUE(x_atomic_load_i32(&probe.ran) == 400);
+  ASSERT_TRUE(probe.ran_on_node[0] + probe.ran_on_node[1] == 400);
+  ASSERT_TRUE(stats.num_nodes == 2);
+  // Everything was queued on node 0, so node 1 only ran what it stole
+  ASSERT_TRUE(stats.steals == (uint64_t) probe.ran_on_node[1]);
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(workers[i].node == i % 2);
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+int test_threadpool_pins_within_affinity(void)
+{
+  XCpuSet saved;
+  if (x_thread_get_affinity(&saved) != 0)
+    return 0; // Platform cannot report the mask
+
+  // Restrict the process to its last allowed CPU; pinned workers must follow
+  int cpu = x_cpuset_nth(&saved, x_cpuset_count(&saved) - 1);
+  XCpuSet one;
+  x_cpuset_zero(&one);
+  x_cpuset_add(&one, cpu);
+  ASSERT_TRUE(x_thread_set_affinity(&one) == 0);
+
+  XThreadPoolConfig config = { 0 };
+  config.min_threads = 2;
+  config.pin_workers = true;
+  XThreadPool* pool = threadpool_create_ex(&config);
+  x_thread_set_affinity(&saved);
+  ASSERT_TRUE(pool != NULL);
+
+  XThreadPoolStats stats;
+  XThreadPoolWorkerStats workers[2];
+  threadpool_stats(pool, &stats, workers, 2);
+  for (int i = 0; i < 2; ++i)
+    ASSERT_TRUE(workers[i].cpu == cpu);
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+typedef struct
+{
+  XThreadPool* pool;
+  int depth;
+  volatile int32_t* leaves;
+} ForkArgs;
+
+// Binary fork/join: every level waits on its children from inside the pool
+void fork_task(void* arg)
+{
+  ForkArgs* args = (ForkArgs*) arg;
+  if (args->depth == 0)
+  {
+    x_atomic_add_i32(args->leaves, 1);
+    return;
+  }
+
+  ForkArgs children[2];
+  XTaskGroup* group = x_taskgroup_create(args->pool);
+  for (int i = 0; i < 2; ++i)
+  {
+    children[i].pool = args->pool;
+    children[i].depth = args->depth - 1;
+    children[i].leaves = args->leaves;
+    x_taskgroup_run(group, fork_task, &children[i]);
+  }
+  x_taskgroup_wait(group);
+  x_taskgroup_destroy(group);
+}
+
+int test_taskgroup_nested(void)
+{
+  // Two workers and ten levels of nesting would deadlock if waiting blocked
+  XThreadPool* pool = threadpool_create(2);
+  volatile int32_t leaves = 0;
+  ForkArgs root = { pool, 10, &leaves };
+
+  XTaskGroup* group = x_taskgroup_create(pool);
+  ASSERT_TRUE(x_taskgroup_run(group, fork_task, &root) == 0);
+  x_taskgroup_wait(group);
+  ASSERT_TRUE(x_taskgroup_pending(group) == 0);
+  ASSERT_TRUE(x_atomic_load_i32(&leaves) == 1024);
+
+  // Reusable after wait
+  leaves = 0;
+  root.depth = 4;
+  x_taskgroup_run(group, fork_task, &root);
+  x_taskgroup_wait(group);
+  ASSERT_TRUE(x_atomic_load_i32(&leaves) == 16);
+
+  x_taskgroup_destroy(group);
+  threadpool_destroy(pool);
+  return 0;
+}
+
+typedef struct
+{
+  XThread* caller;
+  volatile int32_t on_caller;
+  volatile int32_t ran;
+} HelpProbe;
+
+static X_THREAD_LOCAL int help_probe_is_caller = 0;
+
+void help_probe_task(void* arg)
+{
+  HelpProbe* probe = (HelpProbe*) arg;
+  if (help_probe_is_caller)
+    x_atomic_add_i32(&probe->on_caller, 1);
+  x_atomic_add_i32(&probe->ran, 1);
+}
+
+void occupy_task(void* arg)
+{
+  volatile int32_t* state = (volatile int32_t*) arg;
+  x_atomic_store_i32(state, 1);
+  while (x_atomic_load_i32(state) != 2)
+    x_thread_sleep_ms(1);
+}
+
+int test_taskgroup_caller_helps(void)
+{
+  XThreadPool* pool = threadpool_create(1);
+  volatile int32_t occupied = 0;
+  threadpool_enqueue(pool, occupy_task, (void*) &occupied);
+  while (x_atomic_load_i32(&occupied) != 1)
+    x_thread_yield();
+
+  // The only worker is busy, so the waiting thread has to run the batch
+  HelpProbe probe = { 0 };
+  help_probe_is_caller = 1;
+  XTaskGroup* group = x_taskgroup_create(pool);
+  for (int i = 0; i < 100; ++i)
+    x_taskgroup_run(group, help_probe_task, &probe);
+  x_taskgroup_wait(group);
+  help_probe_is_caller = 0;
+
+  ASSERT_TRUE(x_atomic_load_i32(&probe.ran) == 100);
+  ASSERT_TRUE(x_atomic_load_i32(&probe.on_caller) == 100);
+
+  x_atomic_store_i32(&occupied, 2);
+  x_taskgroup_destroy(group);
+  threadpool_destroy(pool);
+  return 0;
+}
+
+typedef struct
+{
+  volatile int32_t ran;
+  volatile int32_t dropped;
+} DropProbe;
+
+void drop_probe_task(void* arg)
+{
+  x_atomic_add_i32(&((DropProbe*) arg)->ran, 1);
+}
+
+void drop_probe_cancel(void* arg)
+{
+  x_atomic_add_i32(&((DropProbe*) arg)->dropped, 1);
+}
+
+void sleep_task(void* arg)
+{
+  x_thread_sleep_ms((int)(intptr_t) arg);
+}
+
+void poll_token_task(void* arg)
+{
+  volatile int32_t* state = (volatile int32_t*) arg;
+  x_atomic_store_i32(state, 1);
+  while (!x_cancel_token_is_cancelled(threadpool_current_token()))
+    x_thread_sleep_ms(1);
+  x_atomic_store_i32(state, 2);
+}
+
+int test_threadpool_cancel_token(void)
+{
+  XThreadPool* pool = threadpool_create(1);
+  XCancelToken* token = x_cancel_token_create();
+  ASSERT_FALSE(x_cancel_token_is_cancelled(token));
+  ASSERT_TRUE(threadpool_current_token() == NULL);
+
+  XTaskOptions options = { 0 };
+  options.token = token;
+  options.cancel_fn = drop_probe_cancel;
+
+  // A running task polls the token; the queued ones behind it never start
+  volatile int32_t state = 0;
+  threadpool_enqueue_ex(pool, poll_token_task, (void*) &state, &options);
+  while (x_atomic_load_i32(&state) != 1)
+    x_thread_yield();
+
+  DropProbe probe = { 0 };
+  for (int i = 0; i < 10; ++i)
+    threadpool_enqueue_ex(pool, drop_probe_task, &probe, &options);
+
+  x_cancel_token_cancel(token);
+  x_cancel_token_destroy(token); // Queued tasks still hold a reference
+
+  while (x_atomic_load_i32(&probe.dropped) < 10)
+    x_thread_yield();
+  ASSERT_TRUE(x_atomic_load_i32(&state) == 2);
+  ASSERT_TRUE(x_atomic_load_i32(&probe.ran) == 0);
+
+  XThreadPoolStats stats;
+  threadpool_stats(pool, &stats, NULL, 0);
+  ASSERT_TRUE(stats.tasks_cancelled == 10);
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+int test_threadpool_deadline(void)
+{
+  XThreadPool* pool = threadpool_create(1);
+  threadpool_enqueue(pool, sleep_task, (void*)(intptr_t) 30);
+
+  DropProbe probe = { 0 };
+  XTaskOptions options = { 0 };
+  options.cancel_fn = drop_probe_cancel;
+  options.deadline_ns = x_thread_time_ns() + 5000000ull;
+  for (int i = 0; i < 5; ++i)
+    threadpool_enqueue_ex(pool, drop_probe_task, &probe, &options);
+
+  options.deadline_ns = x_thread_time_ns() + 5000000000ull;
+  threadpool_enqueue_ex(pool, drop_probe_task, &probe, &options);
+
+  while (x_atomic_load_i32(&probe.dropped) + x_atomic_load_i32(&probe.ran) < 6)
+    x_thread_sleep_ms(1);
+  ASSERT_TRUE(probe.dropped == 5);
+  ASSERT_TRUE(probe.ran == 1);
+
+  threadpool_destroy(pool);
+  return 0;
+}
+
+static void* release_later(void* arg)
+{
+  x_thread_sleep_ms(20);
+  x_atomic_store_i32((volatile int32_t*) arg, 2);
+  return NULL;
+}
+
+int test_threadpool_shutdown_modes(void)
+{
+  // Drop everything still queued. The running task finishes regardless.
+  XThreadPool* pool = threadpool_create(1);
+  volatile int32_t occupied = 0;
+  threadpool_enqueue(pool, occupy_task, (void*) &occupied);
+  while (x_atomic_load_i32(&occupied) != 1)
+    x_thread_yield();
+
+  DropProbe probe = { 0 };
+  XTaskOptions options = { 0 };
+  options.cancel_fn = drop_probe_cancel;
+  for (int i = 0; i < 50; ++i)
+    threadpool_enqueue_ex(pool, drop_probe_task, &probe, &options);
+
+  XThread* releaser;
+  x_thread_create(&releaser, release_later, (void*) &occupied);
+  ASSERT_TRUE(threadpool_destroy_ex(pool, 0) == 50);
+  x_thread_join(releaser);
+  x_thread_destroy(releaser);
+  ASSERT_TRUE(probe.ran == 0);
+  ASSERT_TRUE(probe.dropped == 50);
+
+  // Drain for a while, then drop the rest
+  pool = threadpool_create(1);
+  DropProbe slow = { 0 };
+  for (int i = 0; i < 10; ++i)
+  {
+    threadpool_enqueue_ex(pool, sleep_task, (void*)(intptr_t) 20, NULL);
+    threadpool_enqueue_ex(pool, drop_probe_task, &slow, &options);
+  }
+  int dropped = threadpool_destroy_ex(pool, 50);
+  ASSERT_TRUE(dropped > 0);
+  ASSERT_TRUE(slow.dropped > 0);
+  ASSERT_TRUE(slow.ran > 0);
+  ASSERT_TRUE(slow.ran + slow.dropped == 10);
+  return 0;
+}
+
+void full_queue_task(void* arg)
+{
+  x_atomic_add_i32((volatile int32_t*) arg, 1);
+}
+
+int test_threadpool_full_queue(void)
+{
+  // Fill the queue behind a busy worker; the next enqueue has to wait
+  XThreadPool* pool = threadpool_create(1);
+  volatile int32_t occupied = 0;
+  threadpool_enqueue(pool, occupy_task, (void*) &occupied);
+  while (x_atomic_load_i32(&occupied) != 1)
+    x_thread_yield();
+
+  volatile int32_t ran = 0;
+  for (int i = 0; i < STDX_THREADPOOL_QUEUE_CAPACITY; ++i)
+    ASSERT_TRUE(threadpool_enqueue(pool, full_queue_task, (void*) &ran) == 0);
+
+  XThread* releaser;
+  x_thread_create(&releaser, release_later, (void*) &occupied);
+  ASSERT_TRUE(threadpool_enqueue(pool, full_queue_task, (void*) &ran) == 0);
+  // Only returns once the worker was released and made room
+  ASSERT_TRUE(x_atomic_load_i32(&occupied) == 2);
+  x_thread_join(releaser);
+  x_thread_destroy(releaser);
+
+  threadpool_destroy(pool);
+  ASSERT_TRUE(ran == STDX_THREADPOOL_QUEUE_CAPACITY + 1);
+  return 0;
+}
+
 int main()
 {
   x_thread_mutex_init(&count_lock);
@@ -75,6 +702,21 @@ int main()
   {
     TEST_CASE(test_threadpool_execution),
     TEST_CASE(test_enqueue_after_destroy),
+    TEST_CASE(test_taskgraph_dependencies),
+    TEST_CASE(test_taskgraph_rejects_cycle),
+    TEST_CASE(test_timer_delays),
+    TEST_CASE(test_timer_cancel),
+    TEST_CASE(test_timer_after_idle),
+    TEST_CASE(test_threadpool_stats),
+    TEST_CASE(test_threadpool_elastic),
+    TEST_CASE(test_threadpool_numa_groups),
+    TEST_CASE(test_threadpool_pins_within_affinity),
+    TEST_CASE(test_taskgroup_nested),
+    TEST_CASE(test_taskgroup_caller_helps),
+    TEST_CASE(test_threadpool_cancel_token),
+    TEST_CASE(test_threadpool_deadline),
+    TEST_CASE(test_threadpool_shutdown_modes),
+    TEST_CASE(test_threadpool_full_queue),
   };
 
   int result = stdx_run_tests(tests, sizeof(tests) / sizeof(tests[0]));